@@ -30,22 +30,120 @@ public class MainActivity extends AppCompatActivity {
     RadioButton[] actionRB;                     // Array of RadioButtons for the different processing algorithms
     int nActionRB = 6;                          // Number of RadioButtons
     CheckBox[] optionCB;                        // Array of CheckBoxes for different options
-    int nOptionCB = 4;                          // Number of Checkboxes
+    int nOptionCB = 7;                          // Number of Checkboxes
     private static final int CBPARALLEL = 0;
     private static final int CBNATIVE = 1;
     private static final int CBOMP = 2;
     private static final int CBNEON = 3;
+    private static final int CBPOOL = 4;
+    private static final int CBFUSED = 5;
+    private static final int CBPIPELINE = 6;
+    private static final boolean BILINEAR = true;   // filter of the fused native convert + downscale + rotate
+    private static final int RING_DEPTH = 3;        // frames in flight in the native pipeline (camera, converter, display)
+    private static final boolean PIN_BIG_CORES = false; // run the native worker pool on the big cores only (big.LITTLE)
+    private static final boolean INCREMENTAL = false;   // native SIMD RGB: convert only the tiles that changed (static scenes)
+    private static final int INCREMENTAL_THRESHOLD = 0; // SAD of a tile over which it is converted again (0: any change)
+
+    // Scheduling of the rows on the native worker pool (setNativeSchedule, same values as jni/workerpool.h)
+    public static final int SCHED_STATIC = 0;       // one equal range per thread
+    public static final int SCHED_CHUNKS = 1;       // fixed chunks claimed by the threads that are free
+    public static final int SCHED_ADAPTIVE = 2;     // chunks sized by the measured speed of each core (default)
+
+    // Backends of the zero-copy native functions (YUVtoRGBNativeCritical, YUVtoRGBNativeDirect)
+    public static final int BACKEND_SCALAR = 0;
+    public static final int BACKEND_PTHREAD = 1;
+    public static final int BACKEND_OMP = 2;
+    public static final int BACKEND_POOL = 3;
+    public static final int BACKEND_SIMD = 4;
+    public static final int BACKEND_SIMD_POOL = 5;
+    public static final int BACKEND_LUT = 6;        // table-driven scalar kernel (the fallback of SIMD on CPUs without it)
+    public static final int BACKEND_LUT_POOL = 7;
+
+    // Tiles of YUVtoRGBNativeIncremental (same values as jni/yuvroi.h): tile i is at column i%cols, row i/cols,
+    // with cols = (width+DIRTY_TILE_WIDTH-1)/DIRTY_TILE_WIDTH
+    public static final int DIRTY_TILE_WIDTH = 64;
+    public static final int DIRTY_TILE_HEIGHT = 32;
+
+    // Packed YUV420 formats of YUVtoRGBNativeFormat (same values as jni/yuvplanes.h)
+    public static final int YUV_FORMAT_NV21 = 0;   // Y, then interleaved V U (camera preview default)
+    public static final int YUV_FORMAT_NV12 = 1;   // Y, then interleaved U V
+    public static final int YUV_FORMAT_I420 = 2;   // Y, U, V planes
+    public static final int YUV_FORMAT_YV12 = 3;   // Y, V, U planes (chroma rows aligned to 16 bytes)
+
+    // Output pixel formats of YUVtoRGBNativeOutput (same values as jni/yuvplanes.h)
+    public static final int OUT_RGBA8888 = 0;      // 4 bytes R G B A (Bitmap.Config.ARGB_8888)
+    public static final int OUT_BGRA8888 = 1;      // 4 bytes B G R A (the ints 0xAARRGGBB)
+    public static final int OUT_RGB565 = 2;        // 2 bytes (Bitmap.Config.RGB_565)
+    public static final int OUT_RGB888 = 3;        // 3 bytes R G B
+    public static final int OUT_GREY8 = 4;         // 1 byte, grey level of Y (YUVtoRGBNativeBatch only)
+
+    // Buffers of the native frame arena (arenaBuffer, same values as jni/framearena.h)
+    public static final int ARENA_INPUT = 0;       // YUV frame
+    public static final int ARENA_IMAGE = 1;       // full-size image
+    public static final int ARENA_OUTPUT = 2;      // image shown (scaled and rotated)
+
+    // Filters of the native luma convolution engine (FilterLumaNative, same values as jni/yuvfilter.h)
+    public static final int FILTER_CONV3 = 0;
+    public static final int FILTER_CONV5 = 1;
+    public static final int FILTER_GAUSS3 = 2;
+    public static final int FILTER_GAUSS5 = 3;
+    public static final int FILTER_SOBEL = 4;
+    public static final int FILTER_NO_THRESHOLD = -1;
+    private static final int EDGE_THRESHOLD = FILTER_NO_THRESHOLD;  // Sobel action: gradient magnitude, or white/black edges if in [0,255]
+
+    // Layout of the statistics of YUVtoRGBNativeStats (jni/yuvstats.h): count, sum and sum of squares of Y, min and
+    // max Y, then the 256 bins of the histograms of Y, R, G and B
+    public static final int STATS_COUNT = 0;
+    public static final int STATS_SUM_Y = 1;
+    public static final int STATS_SUM_SQ_Y = 2;
+    public static final int STATS_MIN_Y = 3;
+    public static final int STATS_MAX_Y = 4;
+    public static final int STATS_HIST_Y = 5;
+    public static final int STATS_HIST_R = STATS_HIST_Y + 256;
+    public static final int STATS_HIST_G = STATS_HIST_R + 256;
+    public static final int STATS_HIST_B = STATS_HIST_G + 256;
+    public static final int STATS_SIZE = STATS_HIST_B + 256;
+    private static final boolean STATS = false;     // native RGB: histograms and luma stats counted by the conversion (exposure)
+
+    // Stages of the native profiler (same values as jni/yuvprofile.h): the first three are timed by the JNI functions,
+    // the others here (profileRecord)
+    public static final int STAGE_JNI_IN = 0;       // arrays copied in or pinned
+    public static final int STAGE_CONVERT = 1;
+    public static final int STAGE_JNI_OUT = 2;      // arrays copied back or unpinned
+    public static final int STAGE_DOWNSCALE = 3;
+    public static final int STAGE_DRAW = 4;
+    public static final int STAGE_FRAME = 5;        // camera callback to frame drawn
+    public static final int STAGE_COUNT = 6;
+    // Layout of getProfileSnapshot(): PROFILE_STAGE_FIELDS values per stage, then PROFILE_WORKER_FIELDS per worker
+    // of each runtime (PROFILE_POOL, PROFILE_PTHREAD, PROFILE_OMP), all times in ns
+    public static final int PROFILE_STAGE_FIELDS = 5;   // count, mean, p50, p99, max
+    public static final int PROFILE_WORKER_FIELDS = 3;  // busy, idle, tasks
+    public static final int PROFILE_WORKERS = 16;
+    public static final int PROFILE_POOL = 0;
+    public static final int PROFILE_PTHREAD = 1;
+    public static final int PROFILE_OMP = 2;
+    public static final int PROFILE_RUNTIMES = 3;
+    private static final boolean PROFILE = false;    // profile the stages of every frame while the preview runs
 
     int[] procImage;                            // Buffer for processed image
     int[] procImage2;                           // Buffer for processed image after scaled and rotated
+    int canvW, canvH;                           // Size of the canvas of the processed image (0 until the first frame is shown)
     Bitmap resultBitmap;                        // Bitmap to show on screen
+    java.nio.ByteBuffer arenaOutput;            // Image shown, in the native frame arena (fused native path; null if not configured)
+    final Paint paint = new Paint();            // Paint of the second surface (reused for every frame)
     long fpsT0, fpsT1;                          // Variables to calculate the real FPS of the sequence of processed images
+    long jniCopied0;                            // Bytes copied by the VM in the JNI calls when the preview started
+    long[] frameStats = new long[STATS_SIZE];   // Statistics of the last frame converted with STATS
+    boolean incrementalValid;                   // procImage holds the last incremental frame (nothing else wrote it)
+    Thread displayThread;                       // Shows the frames converted by the native pipeline (null if not running)
+    volatile boolean pipelineRunning;
     public int lastformat;
     public int lastwidth;
     public int lastheight;
 
     // YUBtoRGB parallel stuff
     YUVtoRGBParallel YUV2RGBpar;                // Object for parallel image processing (it holds the pool of worked threads (executor))
+    YUVtoGREYParallel YUV2GREYpar;              // Same for the grey conversion
     int nThreads;                               // number of parallel working threads
 
     boolean NEON;
@@ -67,7 +165,11 @@ public class MainActivity extends AppCompatActivity {
         surf2.addCallback(myshc2);                                     // Add callback to know if surface holder is ready
         myPreviewCallback = new MyPreviewCallback(surf2, myshc2);      // Create the object that carries out the frame processing
 
-        NEON = isNEONSupported();                                      // Checks if Neon is supported (native function)
+        NEON = isNEONSupported();                                      // Checks if there is a SIMD kernel (NEON, AVX2, SSE4.1) for this CPU (native function)
+        if (NEON)
+            optionCB[CBNEON].setText(getSIMDName());                   // show the instruction set selected at load time
+        YUVtoRGB.setColorSpace(YUVtoRGB.BT601, false);                 // Camera preview frames are BT.601 limited range
+        setColorSpace(YUVtoRGB.BT601, false);                          // (same coefficients for the Java and native backends)
     }
 
     @Override
@@ -75,6 +177,12 @@ public class MainActivity extends AppCompatActivity {
         super.onResume();
         nThreads = Runtime.getRuntime().availableProcessors();
         YUV2RGBpar = new YUVtoRGBParallel(nThreads);  // Initialize parallel implementation
+        YUV2GREYpar = new YUVtoGREYParallel(nThreads);
+        initNativePool(nThreads);                     // Start the pool of native worker threads
+        if (PIN_BIG_CORES && getNativeBigCores() > 0) {
+            initNativePool(getNativeBigCores());      // one thread per big core, and no thread on the LITTLE ones
+            pinNativePool(true);
+        }
     }
 
     @Override
@@ -82,6 +190,15 @@ public class MainActivity extends AppCompatActivity {
         super.onPause();
         stopPreview(null);          // When the activity is paused we stop the camera preview and image processing
         YUV2RGBpar.shutdown();      // Shutdown the pool of worked threads
+        YUV2GREYpar.shutdown();
+        shutdownNativePool();       // Shutdown the pool of native worker threads
+    }
+
+    @Override
+    protected void onDestroy() {
+        super.onDestroy();
+        arenaOutput = null;
+        arenaRelease();             // Free the native frame arena
     }
 
     /* Method called when "STARTPREVIEW" button is pressed */
@@ -113,10 +230,18 @@ public class MainActivity extends AppCompatActivity {
             lastheight = parameters.getPreviewSize().height;
             Camera.Size s = parameters.getPreviewSize();
             cam.addCallbackBuffer(new byte[3 * s.width * s.height / 2]);  // create a reusable buffer for the data passed to onPreviewFrame call (in order to avoid GC)
+            allocFrameBuffers();                                    // buffers of the processed images for this size (none allocated per frame)
+            if (isCheck(CBPIPELINE) && getCheckedActionRB() == 1 && !startPipeline())
+                Log.d("HOOK", "Can't start the native pipeline");
+            if (pipelineRunning)
+                cam.addCallbackBuffer(new byte[3 * s.width * s.height / 2]);  // a second buffer: the camera fills one while the other is copied
             cam.setPreviewCallbackWithBuffer(myPreviewCallback);    // assign the callback called when a frame is shown by the camera preview (for frame processing)
             myPreviewCallback.reset();                              // reset statistics of the frame processing
             cam.startPreview();                                     // start camera preview
             fpsT0 = System.nanoTime();                              // store start time
+            jniCopied0 = getJNICopiedBytes();
+            profileReset();
+            profileEnable(PROFILE);
         }
     }
 
@@ -125,9 +250,22 @@ public class MainActivity extends AppCompatActivity {
         if (preview && cam != null) {
             fpsT1 = System.nanoTime();                              // store stop time and write on log the resulting FPS
             Log.d("HOOK", "FPS: "+(1000000000.0f/(double)(fpsT1-fpsT0))*(double)myPreviewCallback.count);
+            if (myPreviewCallback.count > 0)                        // array copies done by the VM around the native calls
+                Log.d("HOOK", "JNI copied MB/frame: "+(getJNICopiedBytes()-jniCopied0)/1000000.0/myPreviewCallback.count);
             cam.stopPreview();                                      // stop camera preview
             cam.setPreviewCallback(null);                           // delete preview callback
             cam.release();                                          // release the camera
+            stopPipeline();                                         // no more frames are pushed: stop the display thread and the native ring
+            if (STATS && frameStats[STATS_COUNT] > 0) {
+                double mean = (double)frameStats[STATS_SUM_Y]/frameStats[STATS_COUNT];
+                double var = (double)frameStats[STATS_SUM_SQ_Y]/frameStats[STATS_COUNT] - mean*mean;
+                Log.d("HOOK", "Luma of the last frame: mean "+mean+", stddev "+Math.sqrt(Math.max(var, 0.0))+
+                      ", min "+frameStats[STATS_MIN_Y]+", max "+frameStats[STATS_MAX_Y]);
+            }
+            if (PROFILE) {
+                profileEnable(false);
+                logProfile();                                       // p50/p99 of every stage and the busy time of the workers
+            }
             TextView tv = (TextView) findViewById(R.id.textView);   // show frame processing mean execution time
             tv.setText(getResources().getString(R.string.mean) + " " + myPreviewCallback.getMean() + " " + getResources().getString(R.string.timeunit));
             myPreviewCallback.reset();                              // reset statistics of the frame processing
@@ -171,8 +309,11 @@ public class MainActivity extends AppCompatActivity {
         public void onPreviewFrame (byte[] data, Camera camera) {
             if (lastformat == android.graphics.ImageFormat.NV21) // should be true: YCrCb format;
             {
-                if (procImage == null)
-                    procImage = new int[lastwidth * lastheight];  // global array to store the processed image
+                if (pipelineRunning) {                          // copy the frame into the native ring and give the buffer back at once:
+                    frameRingPush(data);                        // the converter and the display threads take it from there
+                    camera.addCallbackBuffer(data);
+                    return;
+                }
                 myProccesImageOnBackground = (proccesImageOnBackground)new proccesImageOnBackground(data, procImage, this).execute();
             }
         }
@@ -184,8 +325,13 @@ public class MainActivity extends AppCompatActivity {
         private byte[] data;
         public int[] procImage;
         MyPreviewCallback cb;
+        boolean fused;                              // procImage2 already holds the scaled and rotated image
+        boolean arena;                              // the scaled and rotated image is in arenaOutput instead
+        boolean unchanged;                          // incremental frame with no tile converted: nothing to redraw
+        long frameT0;                               // arrival of the frame (STAGE_FRAME)
 
         proccesImageOnBackground (byte[] _data, int[] _procImage, MyPreviewCallback _cb) {
+            frameT0 = System.nanoTime();
             data = _data;
             procImage = _procImage;
             cb = _cb;
@@ -195,9 +341,30 @@ public class MainActivity extends AppCompatActivity {
         protected Void doInBackground (Void... voids) {
             //Log.d("HOOK", "doInBackground ...");
             long t0=0,t1=0;
+            boolean incremental = false;
             switch (getCheckedActionRB()) {                 // select the image processing algorithm
                 case 1:                                     // Convert to RGB
-                    if (!isCheck(CBPARALLEL)) {             // not parallel
+                    if (INCREMENTAL && isCheck(CBNEON) && !isCheck(CBFUSED)) {  // native SIMD, changed tiles only
+                        if (!incrementalValid)
+                            resetIncremental();
+                        // the whole image is redrawn scaled: only the number of tiles converted is needed, not the list
+                        t0 = System.nanoTime();
+                        int converted = YUVtoRGBNativeIncremental(data, procImage, lastwidth, lastheight, INCREMENTAL_THRESHOLD, null, isCheck(CBPARALLEL));
+                        t1 = System.nanoTime();
+                        incremental = converted >= 0;
+                        unchanged = converted == 0;
+                    } else if (STATS && isCheck(CBNATIVE) && !isCheck(CBFUSED)) {   // native, frame statistics in the same pass
+                        t0 = System.nanoTime();
+                        YUVtoRGBNativeStats(data, procImage, lastwidth, lastheight, getNativeBackend(), nThreads, frameStats);
+                        t1 = System.nanoTime();
+                    } else if (isCheck(CBFUSED) && canvW > 0) {    // native convert + downscale + rotate, straight into the arena (or procImage2)
+                        t0 = System.nanoTime();
+                        if (arenaOutput != null)
+                            fused = arena = YUVtoRGBNativeScaledArena(data, rotation, BILINEAR, isCheck(CBPARALLEL));
+                        else
+                            fused = YUVtoRGBNativeScaled(data, procImage2, lastwidth, lastheight, canvW, canvH, rotation, BILINEAR, isCheck(CBPARALLEL));
+                        t1 = System.nanoTime();
+                    } else if (!isCheck(CBPARALLEL)) {      // not parallel
                         if (!isCheck(CBNATIVE)) {           // not native (not parallel)
                             t0 = System.nanoTime();
                             YUVtoRGB.convertYUV420_NV21toRGB8888(data, procImage, lastwidth, lastheight);
@@ -219,7 +386,15 @@ public class MainActivity extends AppCompatActivity {
                             YUV2RGBpar.convertYUV420_NV21toRGB8888_parallel(data, procImage, lastwidth, lastheight);
                             t1 = System.nanoTime();
                         } else {                            // native parallel
-                            if (!isCheck(CBOMP)) {          // native parallel pthread
+                            if (isCheck(CBNEON)) {          // native parallel NEON (SIMD bands on the worker pool)
+                                t0 = System.nanoTime();
+                                YUVtoRGBNativeNEONParallel(data, procImage, lastwidth, lastheight);
+                                t1 = System.nanoTime();
+                            } else if (isCheck(CBPOOL)) {   // native parallel worker pool
+                                t0 = System.nanoTime();
+                                YUVtoRGBNativePool(data, procImage, lastwidth, lastheight);
+                                t1 = System.nanoTime();
+                            } else if (!isCheck(CBOMP)) {   // native parallel pthread
                                 t0 = System.nanoTime();
                                 YUVtoRGBNativeParallel(data, procImage, lastwidth, lastheight, nThreads);
                                 t1 = System.nanoTime();
@@ -235,12 +410,12 @@ public class MainActivity extends AppCompatActivity {
                     if (!isCheck(CBPARALLEL)) {             // not parallel
                         if (!isCheck(CBNATIVE)) {           // not native (not parallel)
                             t0 = System.nanoTime();
-                            //YUVtoGREY.convertYUV420_NV21toGREY8888(data, procImage, lastwidth, lastheight);
+                            YUVtoGREY.convertYUV420_NV21toGREY8888(data, procImage, lastwidth, lastheight);
                             t1 = System.nanoTime();
                         } else {                            // native (not parallel)
                             if (!isCheck(CBNEON)) {         // native
                                 t0 = System.nanoTime();
-                                //YUVtoGREYNative(data, procImage, lastwidth, lastheight);
+                                YUVtoGREYNative(data, procImage, lastwidth, lastheight);
                                 t1 = System.nanoTime();
                             } else {                        // native NEON
                                 t0 = System.nanoTime();
@@ -251,22 +426,36 @@ public class MainActivity extends AppCompatActivity {
                     } else {                                // parallel version
                         if (!isCheck(CBNATIVE)) {           // not native (parallel)
                             t0 = System.nanoTime();
-                            //YUV2GREYpar.convertYUV420_NV21toGREY8888_parallel(data, procImage, lastwidth, lastheight);
+                            YUV2GREYpar.convertYUV420_NV21toGREY8888_parallel(data, procImage, lastwidth, lastheight);
                             t1 = System.nanoTime();
                         } else {                            // native parallel
-                            if (!isCheck(CBOMP)) {          // native parallel pthread
+                            if (isCheck(CBNEON)) {          // native parallel NEON (SIMD bands on the worker pool)
                                 t0 = System.nanoTime();
-                                //YUVtoGREYNativeParallel(data, procImage, lastwidth, lastheight, nThreads);
+                                YUVtoGREYNativeNEONParallel(data, procImage, lastwidth, lastheight);
+                                t1 = System.nanoTime();
+                            } else if (isCheck(CBPOOL)) {   // native parallel worker pool
+                                t0 = System.nanoTime();
+                                YUVtoGREYNativePool(data, procImage, lastwidth, lastheight);
+                                t1 = System.nanoTime();
+                            } else if (!isCheck(CBOMP)) {   // native parallel pthread
+                                t0 = System.nanoTime();
+                                YUVtoGREYNativeParallel(data, procImage, lastwidth, lastheight, nThreads);
                                 t1 = System.nanoTime();
                             } else {                        // native parallel OMP
                                 t0 = System.nanoTime();
-                                //YUVtoGREYNativeParallelOMP(data, procImage, lastwidth, lastheight, nThreads);
+                                YUVtoGREYNativeParallelOMP(data, procImage, lastwidth, lastheight, nThreads);
                                 t1 = System.nanoTime();
                             }
                         }
                     }
                     break;
+                case 3:                                     // Sobel edges of the luma plane (native only, parallel on the worker pool)
+                    t0 = System.nanoTime();
+                    FilterLumaNative(data, procImage, lastwidth, lastheight, FILTER_SOBEL, null, 0, EDGE_THRESHOLD, isCheck(CBPARALLEL));
+                    t1 = System.nanoTime();
+                    break;
             }
+            incrementalValid = incremental;             // any other conversion overwrote procImage
             cb.count ++;                   // increment number of processed images
             cb.time += t1-t0;              // accumulate elapsed time
             return null;
@@ -275,44 +464,164 @@ public class MainActivity extends AppCompatActivity {
         @Override
         protected void onPostExecute(Void voids) {
             //Log.d("HOOK", "onPostExecute ...");
-            if ((cb.surf2!=null)&&(cb.myshc2.surfaceready))
-            {
-                Canvas canv = cb.surf2.lockCanvas(); // we have access to surf because we are an inner class of MainActivity, which has a member called surf (pp. 246 of thinking in java 4th)
-                if (canv != null) {
-                    Paint p = new Paint();
-                    canv.drawColor(android.graphics.Color.WHITE);
-                    // all coordinates in the canvas are float but have pixel units (the size of the canvas is as specified in the layout of the activity)
-                    // Y-axis goes from top to bottom; X-axis goes from left to right.
-                    int canvW = canv.getWidth();    // get the size of the canvas for the new RGB image
-                    int canvH = canv.getHeight();
-                    if (procImage2 == null)
-                        procImage2 = new int[canvH*canvW];  // create global array to store transformed RGB image
-                    // downscale and rotate RGB image (procImage --> procImage2)
+            if (!unchanged)
+                drawProcessedImage(cb, procImage, fused, arena);
+            cam.addCallbackBuffer(data);    // return the data buffer for then next onPreviewFrame call (no GC)
+            if (PROFILE)
+                profileRecord(STAGE_FRAME, System.nanoTime() - frameT0);
+        }
+
+        @Override
+        protected void onCancelled(Void voids) {
+
+        }
+    }
+
+    /* Show a processed image on the second surface: downscale and rotate it (procImage --> procImage2)
+     * unless it's already scaled (fused), and draw it with the number of processed images.
+     * With arena, the scaled image is in the native frame arena (arenaOutput) and copied to the Bitmap from there */
+    private void drawProcessedImage(MyPreviewCallback cb, int[] procImage, boolean fused, boolean arena) {
+        if ((cb.surf2!=null)&&(cb.myshc2.surfaceready))
+        {
+            Canvas canv = cb.surf2.lockCanvas(); // we have access to surf because we are an inner class of MainActivity, which has a member called surf (pp. 246 of thinking in java 4th)
+            if (canv != null) {
+                Paint p = paint;
+                canv.drawColor(android.graphics.Color.WHITE);
+                // all coordinates in the canvas are float but have pixel units (the size of the canvas is as specified in the layout of the activity)
+                // Y-axis goes from top to bottom; X-axis goes from left to right.
+                if (procImage2 == null) {
+                    canvW = canv.getWidth();    // get the size of the canvas for the new RGB image
+                    canvH = canv.getHeight();
+                    procImage2 = new int[canvH*canvW];  // create global array to store transformed RGB image
+                }
+                // downscale and rotate RGB image (procImage --> procImage2), unless the fused native kernel did it
+                long t0 = System.nanoTime();
+                if (!fused) {
                     Support.downscaleAndRotateImage(procImage, procImage2, lastwidth, lastheight, canvW, canvH, rotation);
-                    if (resultBitmap == null)
-                        // create global Bitmap (to show on surf2) from procImage2
-                        resultBitmap = Bitmap.createBitmap(canvW, canvH, android.graphics.Bitmap.Config.ARGB_8888);
-                    // copy transformed RGB image (procImage2) on bitmap
+                    if (PROFILE)
+                        profileRecord(STAGE_DOWNSCALE, System.nanoTime() - t0);
+                    t0 = System.nanoTime();
+                }
+                if (resultBitmap == null)
+                    // create global Bitmap (to show on surf2) from procImage2
+                    resultBitmap = Bitmap.createBitmap(canvW, canvH, android.graphics.Bitmap.Config.ARGB_8888);
+                // copy transformed RGB image (procImage2, or the arena) on bitmap
+                if (arena) {
+                    arenaOutput.rewind();
+                    resultBitmap.copyPixelsFromBuffer(arenaOutput);     // R G B A bytes: the memory layout of ARGB_8888
+                } else
                     resultBitmap.setPixels(procImage2, 0, canvW, 0, 0, canvW, canvH);
-                    // draw the bitmap
-                    canv.drawBitmap(resultBitmap,0,0,p);
-                    p.setColor(android.graphics.Color.YELLOW);
-                    p.setTextSize((float) 48.0); // these are points, as in html size in points
-                    p.setStyle(android.graphics.Paint.Style.FILL_AND_STROKE);
-                    // draw the number of processed images
-                    canv.drawText(String.valueOf(cb.count), 10, 50, p);
-                    cb.surf2.unlockCanvasAndPost(canv); // This queue the drawing for the next refresh event of surf2 to take it;
-                    // Actually, it allows a thread different from the one that refresh the canvas on screen to draw on surf2
-                    // The actual drawing is not done here at this moment; the refreshing is done whenever the activity wants
+                // draw the bitmap
+                canv.drawBitmap(resultBitmap,0,0,p);
+                p.setColor(android.graphics.Color.YELLOW);
+                p.setTextSize((float) 48.0); // these are points, as in html size in points
+                p.setStyle(android.graphics.Paint.Style.FILL_AND_STROKE);
+                // draw the number of processed images
+                canv.drawText(String.valueOf(cb.count), 10, 50, p);
+                cb.surf2.unlockCanvasAndPost(canv); // This queue the drawing for the next refresh event of surf2 to take it;
+                if (PROFILE)
+                    profileRecord(STAGE_DRAW, System.nanoTime() - t0);
+                // Actually, it allows a thread different from the one that refresh the canvas on screen to draw on surf2
+                // The actual drawing is not done here at this moment; the refreshing is done whenever the activity wants
+            }
+        }
+    }
+
+    /* Allocate the buffers of the processed images for the preview size and the size of the second surface when
+     * the preview starts, instead of on the first frame: they are allocated again only if a size changed, and the
+     * native frame arena only grows (switching sizes back and forth does not allocate) */
+    private void allocFrameBuffers() {
+        SurfaceView sv2 = (SurfaceView) findViewById(R.id.surfaceView2);
+
+        if (procImage == null || procImage.length != lastwidth * lastheight)
+            procImage = new int[lastwidth * lastheight];    // global array to store the processed image
+        if (sv2.getWidth() > 0 && (procImage2 == null || canvW != sv2.getWidth() || canvH != sv2.getHeight())) {
+            canvW = sv2.getWidth();                         // size of the canvas of the second surface
+            canvH = sv2.getHeight();
+            procImage2 = new int[canvH*canvW];
+            resultBitmap = Bitmap.createBitmap(canvW, canvH, android.graphics.Bitmap.Config.ARGB_8888);
+        }
+        arenaOutput = null;
+        if (canvW > 0 && arenaConfigure(YUV_FORMAT_NV21, lastwidth, lastheight, OUT_RGBA8888, canvW, canvH))
+            arenaOutput = arenaBuffer(ARENA_OUTPUT);        // direct ByteBuffer over the native output of the fused path
+    }
+
+    /* Start the native pipeline (camera thread --> converter thread --> display thread) for the RGB action.
+     * The converter uses the backend selected by the CheckBoxes, or the fused convert + downscale + rotate
+     * straight into the size of the second surface */
+    private boolean startPipeline() {
+        SurfaceView sv2 = (SurfaceView) findViewById(R.id.surfaceView2);
+        final boolean fused = isCheck(CBFUSED) && sv2.getWidth() > 0;
+        final int outW = fused ? sv2.getWidth() : 0;
+        final int outH = fused ? sv2.getHeight() : 0;
+
+        if (!frameRingStart(RING_DEPTH, lastwidth, lastheight, outW, outH, rotation, getNativeBackend()))
+            return false;
+        // the converter writes the image to show (procImage2, allocated for the surface by allocFrameBuffers) directly
+        final int[] image = fused ? procImage2 : procImage;
+        pipelineRunning = true;
+        displayThread = new Thread(new Runnable() {
+            @Override
+            public void run() {
+                while (pipelineRunning) {
+                    if (frameRingTake(image, 100) < 0)      // wait for the newest converted frame (older ones are dropped)
+                        continue;
+                    long t0 = System.nanoTime();
+                    drawProcessedImage(myPreviewCallback, image, fused, false);
+                    myPreviewCallback.count ++;
+                    myPreviewCallback.time += System.nanoTime() - t0;
                 }
             }
-            cam.addCallbackBuffer(data);    // return the data buffer for then next onPreviewFrame call (no GC)
+        });
+        displayThread.start();
+        return true;
+    }
+
+    /* Stop the display thread and the native pipeline (the camera must be stopped) and log its counters */
+    private void stopPipeline() {
+        if (!pipelineRunning)
+            return;
+        pipelineRunning = false;
+        try {
+            displayThread.join();
+        } catch (InterruptedException e) {
+            e.printStackTrace();
         }
+        displayThread = null;
+        frameRingStop();
+        long[] stats = getFrameRingStats();
+        Log.d("HOOK", "Pipeline: queued "+stats[0]+", overruns "+stats[1]+", dropped "+stats[2]+", converted "+stats[3]+", displayed "+stats[4]);
+    }
 
-        @Override
-        protected void onCancelled(Void voids) {
+    /* Log the native profiler: p50/p99 of every stage and the busy/idle time of the native workers that ran */
+    private void logProfile() {
+        final String[] stages = {"jni-in", "convert", "jni-out", "downscale", "draw", "frame"};
+        final String[] runtimes = {"pool", "pthread", "omp"};
+        long[] prof = getProfileSnapshot();
 
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            int k = i*PROFILE_STAGE_FIELDS;
+            if (prof[k] > 0)
+                Log.d("HOOK", "Stage "+stages[i]+": "+prof[k]+" samples, p50 "+prof[k+2]/1000+" us, p99 "+prof[k+3]/1000+" us, max "+prof[k+4]/1000+" us");
         }
+        for (int r = 0; r < PROFILE_RUNTIMES; r++) {
+            for (int w = 0; w < PROFILE_WORKERS; w++) {
+                int k = STAGE_COUNT*PROFILE_STAGE_FIELDS + (r*PROFILE_WORKERS + w)*PROFILE_WORKER_FIELDS;
+                if (prof[k+2] > 0)
+                    Log.d("HOOK", "Worker "+runtimes[r]+" "+w+": busy "+prof[k]/1000000+" ms, idle "+prof[k+1]/1000000+" ms, "+prof[k+2]+" tasks");
+            }
+        }
+    }
+
+    /* Backend of the native functions selected by the CheckBoxes */
+    private int getNativeBackend() {
+        if (!isCheck(CBPARALLEL))
+            return isCheck(CBNEON) ? BACKEND_SIMD : BACKEND_SCALAR;
+        if (isCheck(CBNEON))
+            return BACKEND_SIMD_POOL;
+        if (isCheck(CBPOOL))
+            return BACKEND_POOL;
+        return isCheck(CBOMP) ? BACKEND_OMP : BACKEND_PTHREAD;
     }
 
 
@@ -322,9 +631,53 @@ public class MainActivity extends AppCompatActivity {
     public native void YUVtoRGBNative(byte[] data, int[] result, int width, int height);
     public native void YUVtoRGBNativeParallel(byte[] data, int[] result, int width, int height, int nthr);
     public native void YUVtoRGBNativeParallelOMP(byte[] data, int[] result, int width, int height, int nthr);
+    public native void YUVtoRGBNativePool(byte[] data, int[] result, int width, int height);
+    public native void setColorSpace(int matrix, boolean fullRange);
+    public native void initNativePool(int nthr);
+    public native void shutdownNativePool();
+    public native void setNativeSchedule(int sched);
+    public native int getNativeBigCores();
+    public native int pinNativePool(boolean bigOnly);
     public native void YUVtoRGBNativeNEON(byte[] data, int[] result, int width, int height);
     public native void YUVtoGREYNativeNEON(byte[] data, int[] result, int width, int height);
+    public native void YUVtoGREYNative(byte[] data, int[] result, int width, int height);
+    public native void YUVtoGREYNativeParallel(byte[] data, int[] result, int width, int height, int nthr);
+    public native void YUVtoGREYNativeParallelOMP(byte[] data, int[] result, int width, int height, int nthr);
+    public native void YUVtoGREYNativePool(byte[] data, int[] result, int width, int height);
+    public native void YUVtoGREY8Native(byte[] data, byte[] grey, int width, int height);
+    public native void YUVtoRGBNativeNEONParallel(byte[] data, int[] result, int width, int height);
+    public native void YUVtoGREYNativeNEONParallel(byte[] data, int[] result, int width, int height);
+    public native boolean YUVtoRGBNativeCritical(byte[] data, int[] result, int width, int height, int backend, int nthr);
+    public native boolean YUVtoRGBNativeDirect(java.nio.ByteBuffer data, java.nio.ByteBuffer result, int width, int height, int backend, int nthr);
+    public native long getJNICopiedBytes();
+    public native boolean FilterLumaNative(byte[] data, int[] result, int width, int height, int filter, short[] kernel, int shift, int threshold, boolean parallel);
+    public native boolean YUVtoRGBNativeStats(byte[] data, int[] result, int width, int height, int backend, int nthr, long[] stats);
+    public native boolean YUVtoRGBNativeROI(byte[] data, int[] result, int width, int height, int x, int y, int roiWidth, int roiHeight, boolean parallel);
+    public native int YUVtoRGBNativeIncremental(byte[] data, int[] result, int width, int height, int threshold, int[] dirty, boolean parallel);
+    public native void resetIncremental();
+    public native boolean YUVtoRGBNativeFormat(byte[] data, int format, int stride, int[] result, int width, int height, boolean parallel);
+    public native boolean YUVtoRGBNativeOutput(byte[] data, int format, int stride, java.nio.ByteBuffer result, int outFormat,
+                                               int width, int height, boolean parallel);
+    public native boolean YUVtoRGBNativePlanes(java.nio.ByteBuffer y, int yRowStride, java.nio.ByteBuffer u, java.nio.ByteBuffer v,
+                                               int uvRowStride, int uvPixelStride, int[] result, int width, int height, boolean parallel);
+    public native int YUVtoRGBNativeBatch(java.nio.ByteBuffer frames, int count, int format, int stride,
+                                          java.nio.ByteBuffer result, int outFormat, int width, int height);
+    public native boolean YUVtoRGBNativeScaled(byte[] data, int[] result, int width, int height, int outWidth, int outHeight, int angle, boolean bilinear, boolean parallel);
+    public native boolean arenaConfigure(int format, int width, int height, int outFormat, int outWidth, int outHeight);
+    public native java.nio.ByteBuffer arenaBuffer(int buffer);
+    public native void arenaRelease();
+    public native boolean YUVtoRGBNativeScaledArena(byte[] data, int angle, boolean bilinear, boolean parallel);
+    public native boolean frameRingStart(int depth, int width, int height, int outWidth, int outHeight, int angle, int backend);
+    public native boolean frameRingPush(byte[] data);
+    public native long frameRingTake(int[] result, int timeoutMs);
+    public native void frameRingStop();
+    public native long[] getFrameRingStats();
+    public native void profileEnable(boolean on);
+    public native void profileReset();
+    public native void profileRecord(int stage, long ns);
+    public native long[] getProfileSnapshot();
     private native boolean isNEONSupported();
+    private native String getSIMDName();
 
     // Load native library when this class is loaded by the loader class
     static {
@@ -362,8 +715,8 @@ public class MainActivity extends AppCompatActivity {
         rb.setOnClickListener(actionRBlistener);
         actionRB[i++] = rb;
         rb = (RadioButton) findViewById(R.id.radioButton3);
-        rb.setText(getResources().getString(R.string.notused));
-        rb.setEnabled(false);
+        rb.setText(getResources().getString(R.string.sobel));
+        rb.setEnabled(true);
         rb.setOnClickListener(actionRBlistener);
         actionRB[i++] = rb;
         rb = (RadioButton) findViewById(R.id.radioButton4);
@@ -391,12 +744,28 @@ public class MainActivity extends AppCompatActivity {
             public void onClick(View v) {
                 if (optionCB[CBPARALLEL].isChecked() && optionCB[CBNATIVE].isChecked()) {
                     optionCB[CBOMP].setEnabled(true);
+                    optionCB[CBPOOL].setEnabled(true);
                 } else {
                     optionCB[CBOMP].setEnabled(false);
                     optionCB[CBOMP].setChecked(false);
+                    optionCB[CBPOOL].setEnabled(false);
+                    optionCB[CBPOOL].setChecked(false);
+                }
+                if (v.getId() == optionCB[CBOMP].getId() && optionCB[CBOMP].isChecked())
+                    optionCB[CBPOOL].setChecked(false);     // OMP and pool are alternative parallel runtimes
+                if (v.getId() == optionCB[CBPOOL].getId() && optionCB[CBPOOL].isChecked())
+                    optionCB[CBOMP].setChecked(false);
+                if (optionCB[CBNATIVE].isChecked()) {
+                    optionCB[CBFUSED].setEnabled(true);
+                    optionCB[CBPIPELINE].setEnabled(true);
+                } else {
+                    optionCB[CBFUSED].setEnabled(false);
+                    optionCB[CBFUSED].setChecked(false);
+                    optionCB[CBPIPELINE].setEnabled(false);
+                    optionCB[CBPIPELINE].setChecked(false);
                 }
                 if (NEON) {
-                    if (!optionCB[CBPARALLEL].isChecked() && optionCB[CBNATIVE].isChecked()) {
+                    if (optionCB[CBNATIVE].isChecked()) {      // NEON alone or NEON + N threads
                         optionCB[CBNEON].setEnabled(true);
                     } else {
                         optionCB[CBNEON].setEnabled(false);
@@ -420,11 +789,25 @@ public class MainActivity extends AppCompatActivity {
         cb = (CheckBox) findViewById(R.id.checkBox3);
         cb.setText(getResources().getString(R.string.omp));
         cb.setEnabled(false);
+        cb.setOnClickListener(actionCBlistener);
         optionCB[CBOMP] = cb;
         cb = (CheckBox) findViewById(R.id.checkBox4);
         cb.setText(getResources().getString(R.string.neon));
         cb.setEnabled(false);
         optionCB[CBNEON] = cb;
+        cb = (CheckBox) findViewById(R.id.checkBox5);
+        cb.setText(getResources().getString(R.string.pool));
+        cb.setEnabled(false);
+        cb.setOnClickListener(actionCBlistener);
+        optionCB[CBPOOL] = cb;
+        cb = (CheckBox) findViewById(R.id.checkBox6);
+        cb.setText(getResources().getString(R.string.fused));
+        cb.setEnabled(false);
+        optionCB[CBFUSED] = cb;
+        cb = (CheckBox) findViewById(R.id.checkBox7);
+        cb.setText(getResources().getString(R.string.pipeline));
+        cb.setEnabled(false);
+        optionCB[CBPIPELINE] = cb;
     }
 
     /* Method to get the index of the RadioButton checked. 0 if none is checked */
@@ -58,8 +58,7 @@ public class Support {
 
     /* Method that rotates and scales a RGB image (in[hIn x wIn] --> out[hOut x wOut] rotated "angle" degrees) */
     public static void downscaleAndRotateImage(int[] in, int[] out, int wIn, int hIn, int wOut, int hOut, int angle) {
-        if (((angle == 0 || angle == 180) && (wIn < wOut || hIn < hOut)) ||
-                (wIn < hOut || hIn < wOut))
+        if ((angle == 0 || angle == 180) ? (wIn < wOut || hIn < hOut) : (wIn < hOut || hIn < wOut))
             throw new RuntimeException();
         float strideW = (angle == 0 || angle == 180) ? (float)wIn / (float)wOut : (float)wIn / (float)hOut;
         float strideH = (angle == 0 || angle == 180) ? (float)hIn / (float)hOut : (float)hIn / (float)wOut;
@@ -101,7 +100,7 @@ public class Support {
                 break;
             case 270:
                 for (float i=wIn-1; i>=0; i-=strideW) {
-                    for (float j=0; j<=hIn; j+=strideH) {
+                    for (float j=0; j<hIn; j+=strideH) {
                         out[cont++] = in[(int)j*wIn + (int)i];
                         if (cont!= 0 && cont%wOut == 0)
                             break;
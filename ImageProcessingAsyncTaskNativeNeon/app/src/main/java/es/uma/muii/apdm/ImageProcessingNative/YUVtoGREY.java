@@ -0,0 +1,38 @@
+package es.uma.muii.apdm.ImageProcessingNative;
+
+/**
+ * Grey conversion of NV21 frames: only the Y plane is read and every pixel gets R = G = B = grey level of Y,
+ * the value YUVtoRGB gives with U = V = 0 (same as the native grey kernels).
+ */
+public class YUVtoGREY {
+
+    // grey level of every Y value for the coefficients it was built with
+    private static int[] lut = new int[256];
+    private static int lutYcoef = -1, lutYoff = -1;
+
+    // Lookup table of the colour space currently selected in YUVtoRGB (rebuilt when it changes)
+    static synchronized int[] getLUT() {
+        if (lutYcoef != YUVtoRGB.ycoef || lutYoff != YUVtoRGB.yoff) {
+            int[] t = new int[256];
+            for (int y=0; y < 256; y++)
+                t[y] = YUVtoRGB.convertYUVtoRGB(y, 128, 128, 128);     // 0xff000000 | grey*0x010101
+            lut = t;
+            lutYcoef = YUVtoRGB.ycoef;
+            lutYoff = YUVtoRGB.yoff;
+        }
+        return lut;
+    }
+
+    // Rows [row0, row1) of the image
+    static void convertRows(byte [] data, int [] pixels, int width, int row0, int row1, int [] lut)
+    {
+        for (int i=row0*width; i < row1*width; i++)
+            pixels[i] = lut[data[i]&0xff];
+    }
+
+    public static void convertYUV420_NV21toGREY8888(byte [] data, int [] pixels, int width, int height)
+    // pixels must have room for width*height ints, one per pixel
+    {
+        convertRows(data, pixels, width, 0, height, getLUT());
+    }
+}
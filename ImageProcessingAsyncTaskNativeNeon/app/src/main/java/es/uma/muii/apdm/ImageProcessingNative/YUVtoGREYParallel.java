@@ -0,0 +1,83 @@
+package es.uma.muii.apdm.ImageProcessingNative;
+
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.ThreadPoolExecutor;
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Parallel version of YUVtoGREY: the rows of the image are split among nThreads workers of an executor.
+ * The workers are created once and started again for every frame (see YUVtoRGBParallel): no allocation per frame.
+ */
+public class YUVtoGREYParallel {
+
+    private ThreadPoolExecutor exSrv;
+    private int nThreads;
+    private myJavaWorker[] workers;
+    private final Object done = new Object();
+    private int pending;                                // workers still converting the frame (guarded by done)
+
+    // Frame being converted: set before the workers are started (the executor publishes it to them)
+    private byte [] data;
+    private int [] pixels;
+    private int [] lut;
+    private int width;
+    private int height;
+
+    YUVtoGREYParallel(int _nthreads) {
+        nThreads = _nthreads;
+        exSrv = new ThreadPoolExecutor(nThreads, nThreads, 0L, TimeUnit.MILLISECONDS, new ArrayBlockingQueue<Runnable>(nThreads));
+        exSrv.prestartAllCoreThreads();
+        workers = new myJavaWorker[nThreads];
+        for (int i=0; i < nThreads; i++)
+            workers[i] = new myJavaWorker(i);
+    }
+
+    public void shutdown() {
+        exSrv.shutdown();
+    }
+
+    private final class myJavaWorker implements Runnable {
+        private int id;
+
+        public myJavaWorker(int _id) {
+            id = _id;
+        }
+
+        public void run() {
+            YUVtoGREY.convertRows(data, pixels, width, height*id/nThreads, height*(id+1)/nThreads, lut);
+            synchronized (done) {
+                if (--pending == 0)
+                    done.notifyAll();
+            }
+        }
+
+    }
+
+    public void convertYUV420_NV21toGREY8888_parallel(byte [] data, int [] pixels, int width, int height) {
+        this.data = data;
+        this.pixels = pixels;
+        this.lut = YUVtoGREY.getLUT();
+        this.width = width;
+        this.height = height;
+        synchronized (done) {
+            pending = nThreads;
+        }
+        for (int i=0; i < nThreads; i++)
+            exSrv.execute(workers[i]);
+        boolean interrupted = false;
+        synchronized (done) {
+            while (pending > 0) {
+                try {
+                    done.wait();
+                } catch (InterruptedException e) {
+                    interrupted = true;     // the workers still write pixels: wait for them anyway
+                }
+            }
+        }
+        if (interrupted)
+            Thread.currentThread().interrupt();
+        this.data = null;
+        this.pixels = null;
+    }
+
+}
@@ -5,17 +5,81 @@ package es.uma.muii.apdm.ImageProcessingNative;
  */
 public class YUVtoRGB {
 
-    private static int convertYUVtoRGB(int y, int u, int v)
+    // Colour matrices (same values as in jni/yuv2rgb.h)
+    public static final int BT601 = 0;
+    public static final int BT709 = 1;
+
+    // Fixed-point coefficients scaled by 256: {ycoef, yoff, rv, gu, gv, bu} for [matrix][limited, full range].
+    // Same table as jni/yuv2rgb.c, so the Java and native backends produce identical images
+    private static final int[][][] COEFS = {
+            { { 298, 16, 409, -100, -208, 516 }, { 256, 0, 359, -88, -183, 454 } },     // BT.601
+            { { 298, 16, 459,  -55, -136, 541 }, { 256, 0, 403, -48, -120, 475 } }      // BT.709
+    };
+
+    // Coefficients currently selected (BT.601 limited range by default)
+    static int ycoef = 298, yoff = 16, rv = 409, gu = -100, gv = -208, bu = 516;
+
+    // Lookup tables of the conversion for the coefficients currently selected (same as yuvGetLUT in jni/yuv2rgb.c):
+    // per 2x2 block the chroma is three loads and two additions, per pixel one load for Y and three clamp lookups
+    static final int CLAMP_MIN = -384;                  // CLAMP covers [CLAMP_MIN, CLAMP_MIN+1024), wider than any (yy+chroma)>>8
+    static final int[] YTAB = new int[256];             // max(Y - yoff, 0)*ycoef
+    static final int[] RVTAB = new int[256];            // 128 + rv*(V-128)
+    static final int[] GUTAB = new int[256];            // gu*(U-128)
+    static final int[] GVTAB = new int[256];            // 128 + gv*(V-128)
+    static final int[] BUTAB = new int[256];            // 128 + bu*(U-128)
+    static final int[] CLAMP = new int[1024];           // CLAMP[x - CLAMP_MIN] = x saturated to [0,255]
+
+    static {
+        for (int i=0; i < CLAMP.length; i++)
+            CLAMP[i] = clamp255(i + CLAMP_MIN);
+        buildTables();
+    }
+
+    public static void setColorSpace(int matrix, boolean fullRange) {
+        int[] c = COEFS[matrix == BT709 ? BT709 : BT601][fullRange ? 1 : 0];
+        ycoef = c[0];
+        yoff = c[1];
+        rv = c[2];
+        gu = c[3];
+        gv = c[4];
+        bu = c[5];
+        buildTables();
+    }
+
+    private static void buildTables() {
+        for (int i=0; i < 256; i++) {
+            YTAB[i] = Math.max(i - yoff, 0)*ycoef;
+            RVTAB[i] = 128 + rv*(i-128);
+            GUTAB[i] = gu*(i-128);
+            GVTAB[i] = 128 + gv*(i-128);
+            BUTAB[i] = 128 + bu*(i-128);
+        }
+    }
+
+    // Saturate x to [0,255] without branches
+    private static int clamp255(int x) {
+        x &= ~(x >> 31);
+        x |= (255 - x) >> 31;
+        return x & 0xff;
+    }
+
+    // return RGB value from Y and the chroma contributions cr = 128+rv*V, cg = 128+gu*U+gv*V, cb = 128+bu*U
+    // (computed once for the four pixels that share U and V)
+    static int convertYUVtoRGB(int y, int cr, int cg, int cb)
     {
-        int r,g,b;
-
-        r = y + (int)1.14f*v;
-        g = y - (int)(0.395f*u +0.581f*v);
-        b = y + (int)2.033f*u;
-        r = r>255? 255 : r<0 ? 0 : r;
-        g = g>255? 255 : g<0 ? 0 : g;
-        b = b>255? 255 : b<0 ? 0 : b;
-        return 0xff000000 | (b<<16) | (g<<8) | r; // one byte for alpha, one for blue, one for green, one for red
+        int yy = y - yoff;
+
+        yy &= ~(yy >> 31);
+        yy *= ycoef;
+        return 0xff000000 | (clamp255((yy+cr)>>8)<<16) | (clamp255((yy+cg)>>8)<<8) | clamp255((yy+cb)>>8); // 0xAARRGGBB, as android.graphics.Color
+    }
+
+    // Same with the lookup tables: y is the stored byte, cr = RVTAB[V], cg = GUTAB[U]+GVTAB[V], cb = BUTAB[U]
+    static int convertYUVtoRGBLUT(int y, int cr, int cg, int cb)
+    {
+        int yy = YTAB[y] - (CLAMP_MIN << 8);             // CLAMP index = ((yy+c)>>8) - CLAMP_MIN
+
+        return 0xff000000 | (CLAMP[(yy+cr)>>8]<<16) | (CLAMP[(yy+cg)>>8]<<8) | CLAMP[(yy+cb)>>8];
     }
 
     public static void convertYUV420_NV21toRGB8888(byte [] data, int [] pixels, int width, int height)
@@ -23,6 +87,7 @@ public class YUVtoRGB {
     {
         int size = width*height;
         int u, v, y1, y2, y3, y4;
+        int cr, cg, cb;
 
         // i traverses Y
         // k traverses U and V
@@ -32,15 +97,16 @@ public class YUVtoRGB {
             y3 = data[width+i  ]&0xff;
             y4 = data[width+i+1]&0xff;
 
-            u = data[size+k  ]&0xff;
-            v = data[size+k+1]&0xff;
-            u = u-128;
-            v = v-128;
+            v = data[size+k  ]&0xff;        // NV21: V (Cr) first, then U (Cb)
+            u = data[size+k+1]&0xff;
 
-            pixels[i  ] = convertYUVtoRGB(y1, u, v);
-            pixels[i+1] = convertYUVtoRGB(y2, u, v);
-            pixels[width+i  ] = convertYUVtoRGB(y3, u, v);
-            pixels[width+i+1] = convertYUVtoRGB(y4, u, v);
+            cr = RVTAB[v];                  // chroma once per 2x2 block, from the tables
+            cg = GUTAB[u] + GVTAB[v];
+            cb = BUTAB[u];
+            pixels[i  ] = convertYUVtoRGBLUT(y1, cr, cg, cb);
+            pixels[i+1] = convertYUVtoRGBLUT(y2, cr, cg, cb);
+            pixels[width+i  ] = convertYUVtoRGBLUT(y3, cr, cg, cb);
+            pixels[width+i+1] = convertYUVtoRGBLUT(y4, cr, cg, cb);
 
             if (i!=0 && (i+2)%width==0)
                 i+=width;
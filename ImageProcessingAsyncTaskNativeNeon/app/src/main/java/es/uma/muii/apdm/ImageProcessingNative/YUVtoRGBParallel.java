@@ -1,46 +1,52 @@
 package es.uma.muii.apdm.ImageProcessingNative;
 
-import java.util.ArrayList;
-import java.util.List;
-import java.util.concurrent.Callable;
-import java.util.concurrent.ExecutorService;
-import java.util.concurrent.Executors;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.ThreadPoolExecutor;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicInteger;
 
 /**
  * Created by corbera on 23/10/15.
  */
 public class YUVtoRGBParallel {
 
-    private ExecutorService exSrv;
+    private static final int CHUNKS_PER_THREAD = 8;    // the rows are split in nThreads*CHUNKS_PER_THREAD chunks
+
+    private ThreadPoolExecutor exSrv;
     private int nThreads;
+    private myJavaWorker[] workers;                     // created once and started again for every frame
+    private final AtomicInteger nextChunk = new AtomicInteger(0);
+    private final Object done = new Object();
+    private int pending;                                // workers still converting the frame (guarded by done)
+
+    // Frame being converted: set before the workers are started (the executor publishes it to them)
+    private byte [] data;
+    private int [] pixels;
+    private int width;
+    private int height;
+    private int nChunks;
 
     YUVtoRGBParallel(int _nthreads) {
         nThreads = _nthreads;
-        exSrv = Executors.newFixedThreadPool(nThreads);
+        // bounded queue of one slot per worker: queuing a worker allocates nothing, unlike the linked queue of
+        // Executors.newFixedThreadPool, so a frame does no allocation at all (no GC pauses in the preview)
+        exSrv = new ThreadPoolExecutor(nThreads, nThreads, 0L, TimeUnit.MILLISECONDS, new ArrayBlockingQueue<Runnable>(nThreads));
+        exSrv.prestartAllCoreThreads();
+        workers = new myJavaWorker[nThreads];
+        for (int i=0; i < nThreads; i++)
+            workers[i] = new myJavaWorker();
     }
 
     public void shutdown() {
         exSrv.shutdown();
     }
 
-    private static int convertYUVtoRGB(int y, int u, int v)
-    {
-        int r,g,b;
-
-        r = y + (int)1.14f*v;
-        g = y - (int)(0.395f*u +0.581f*v);
-        b = y + (int)2.033f*u;
-        r = r>255? 255 : r<0 ? 0 : r;
-        g = g>255? 255 : g<0 ? 0 : g;
-        b = b>255? 255 : b<0 ? 0 : b;
-        return 0xff000000 | (b<<16) | (g<<8) | r; // one byte for alpha, one for blue, one for green, one for red
-    }
-
     private static void convertYUV420_NV21toRGB8888(byte [] data, int [] pixels, int width, int height, int my_id, int nThreads)
     // pixels must have room for width*height ints, one per pixel. See https://en.wikipedia.org/wiki/YUV
     {
         int size = width*height;
         int u=0, v=0, y1, y2, y3, y4;
+        int cr, cg, cb;
         int myEnd, myOff;
 
         int myInitRow = (int)(((float)my_id/(float)nThreads)*((float)height/2.0f));
@@ -54,57 +60,69 @@ public class YUVtoRGBParallel {
             y3 = data[width+i  ]&0xff;
             y4 = data[width+i+1]&0xff;
 
-            u = data[k  ]&0xff;
-            v = data[k+1]&0xff;
-            u = u-128;
-            v = v-128;
+            v = data[k  ]&0xff;             // NV21: V first
+            u = data[k+1]&0xff;
 
-            pixels[i  ] = convertYUVtoRGB(y1, u, v);
-            pixels[i+1] = convertYUVtoRGB(y2, u, v);
-            pixels[width+i  ] = convertYUVtoRGB(y3, u, v);
-            pixels[width+i+1] = convertYUVtoRGB(y4, u, v);
+            cr = YUVtoRGB.RVTAB[v];         // same lookup tables as the sequential version
+            cg = YUVtoRGB.GUTAB[u] + YUVtoRGB.GVTAB[v];
+            cb = YUVtoRGB.BUTAB[u];
+            pixels[i  ] = YUVtoRGB.convertYUVtoRGBLUT(y1, cr, cg, cb);
+            pixels[i+1] = YUVtoRGB.convertYUVtoRGBLUT(y2, cr, cg, cb);
+            pixels[width+i  ] = YUVtoRGB.convertYUVtoRGBLUT(y3, cr, cg, cb);
+            pixels[width+i+1] = YUVtoRGB.convertYUVtoRGBLUT(y4, cr, cg, cb);
 
             if (i!=0 && (i+2)%width==0)
                 i+=width;
         }
     }
 
-    private final class myJavaWorker implements Callable<Void> {
-        private byte [] data;
-        private int [] pixels;
-        private int width;
-        private int height;
-        private int id;
-        private int nth;
-
-        public myJavaWorker(byte [] _data, int [] _pixels, int _width, int _height, int _th_id, int _nth) {
-            data = _data;
-            pixels = _pixels;
-            width = _width;
-            height = _height;
-            id = _th_id;
-            nth = _nth;
-        }
-
-        public Void call(){
-            convertYUV420_NV21toRGB8888(data, pixels, width, height, id, nth);
-            return null;
+    private final class myJavaWorker implements Runnable {
+        // claim chunks until none is left: a worker on a big core converts more chunks than one on a LITTLE core
+        public void run() {
+            int chunk;
+            while ((chunk = nextChunk.getAndIncrement()) < nChunks)
+                convertYUV420_NV21toRGB8888(data, pixels, width, height, chunk, nChunks);
+            synchronized (done) {
+                if (--pending == 0)
+                    done.notifyAll();
+            }
         }
 
     }
 
     public void convertYUV420_NV21toRGB8888_parallel(byte [] data, int [] pixels, int width, int height) {
-        List<Callable<Void>> todoTasks;
-        todoTasks = new ArrayList<Callable<Void>>(nThreads);
-
-        for (int i=0; i < nThreads; i++) {
-            todoTasks.add(i, new myJavaWorker(data, pixels, width, height, i, nThreads));
+        this.data = data;
+        this.pixels = pixels;
+        this.width = width;
+        this.height = height;
+        nChunks = Math.min(nThreads*CHUNKS_PER_THREAD, height/2);
+        nextChunk.set(0);
+        synchronized (done) {
+            pending = nThreads;
         }
-        try {
-            exSrv.invokeAll(todoTasks);
-        } catch (InterruptedException e) {
-            e.printStackTrace();
+        for (int i=0; i < nThreads; i++)
+            exSrv.execute(workers[i]);
+        waitWorkers();
+        this.data = null;                               // the frame is not kept alive by the converter
+        this.pixels = null;
+    }
+
+    // Wait until every worker is done with the frame. An interrupt (AsyncTask cancelled) does not stop the wait:
+    // the workers still write pixels. It is kept for the caller
+    private void waitWorkers() {
+        boolean interrupted = false;
+
+        synchronized (done) {
+            while (pending > 0) {
+                try {
+                    done.wait();
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
         }
+        if (interrupted)
+            Thread.currentThread().interrupt();
     }
 
 }
@@ -0,0 +1,48 @@
+# Native library of the app, built by ndk-build from app/build.gradle (task ndkBuild).
+# On armeabi-v7a only the NEON kernels are compiled with -mfpu=neon (the .neon suffix): the rest of the library
+# keeps the base FPU of the ABI, so no NEON instruction runs before yuvdispatch.c has checked that the CPU has it.
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := processimg
+
+NEON_SRC_FILES := \
+    yuvconvert_neon.c \
+    yuvfilter_neon.c
+
+LOCAL_SRC_FILES := \
+    framearena.c \
+    framering.c \
+    processimg.c \
+    processimg_neon.c \
+    workerpool.c \
+    yuv2rgb.c \
+    yuvbatch.c \
+    yuvconvert.c \
+    yuvconvert_neon64.c \
+    yuvconvert_x86.c \
+    yuvdispatch.c \
+    yuvfilter.c \
+    yuvfilter_x86.c \
+    yuvgrey.c \
+    yuvlut.c \
+    yuvplanes.c \
+    yuvprofile.c \
+    yuvroi.c \
+    yuvscale.c \
+    yuvstats.c
+
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += $(addsuffix .neon,$(NEON_SRC_FILES))
+LOCAL_CFLAGS := -mfloat-abi=softfp
+else
+LOCAL_SRC_FILES += $(NEON_SRC_FILES)
+endif
+
+LOCAL_CFLAGS += -fopenmp -flax-vector-conversions
+LOCAL_LDFLAGS := -fopenmp
+LOCAL_LDLIBS := -llog
+
+include $(BUILD_SHARED_LIBRARY)
@@ -0,0 +1,3 @@
+# One library per ABI: the SIMD kernel is selected at runtime (yuvdispatch.c)
+APP_ABI := armeabi-v7a arm64-v8a x86
+APP_PLATFORM := android-19
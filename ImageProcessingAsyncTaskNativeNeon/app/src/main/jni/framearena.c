@@ -0,0 +1,185 @@
+//
+// Frame buffers and kernel scratch reused from frame to frame (see framearena.h).
+//
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "yuvplanes.h"
+#include "framearena.h"
+
+#define SCRATCH_GRANULE 4096    // scratch sizes are rounded up to pages: a slightly larger frame does not grow it again
+
+typedef struct frameArena {
+    unsigned char * block;      // FRAME_ARENA_ALIGN aligned
+    size_t capacity;
+    size_t offset[FRAME_ARENA_BUFFERS];
+    size_t size[FRAME_ARENA_BUFFERS];
+    int format, width, height;
+    int outFormat, outWidth, outHeight;
+    int configured;
+    int generation;
+} frameArena;
+
+static frameArena arena;
+static pthread_mutex_t arenaLock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t alignUp(size_t n)
+{
+    return (n + FRAME_ARENA_ALIGN-1) & ~(size_t)(FRAME_ARENA_ALIGN-1);
+}
+
+int frameArenaConfigure(int format, int width, int height, int outFormat, int outWidth, int outHeight)
+{
+    size_t sizes[FRAME_ARENA_BUFFERS], total = 0;
+    void *block = NULL;
+    int const inBytes = yuvBufferSize(format, width, height, width);
+    int i;
+
+    if (inBytes <= 0 || !YUV_OUT_VALID(outFormat) || outWidth < 0 || outHeight < 0)
+        return 0;
+    sizes[FRAME_ARENA_INPUT] = inBytes;
+    sizes[FRAME_ARENA_IMAGE] = (size_t)width*height*YUV_OUT_BYTES(outFormat);
+    sizes[FRAME_ARENA_OUTPUT] = (size_t)outWidth*outHeight*YUV_OUT_BYTES(outFormat);
+    for (i=0; i < FRAME_ARENA_BUFFERS; i++)
+        total += alignUp(sizes[i]);
+
+    pthread_mutex_lock(&arenaLock);
+    if (total > arena.capacity) {
+        free(arena.block);
+        arena.block = NULL;
+        arena.capacity = 0;
+        arena.configured = 0;
+        arena.generation++;
+        if (posix_memalign(&block, FRAME_ARENA_ALIGN, total)) {
+            pthread_mutex_unlock(&arenaLock);
+            return 0;
+        }
+        arena.block = block;
+        arena.capacity = total;
+    }
+    total = 0;
+    for (i=0; i < FRAME_ARENA_BUFFERS; i++) {
+        arena.offset[i] = total;
+        arena.size[i] = sizes[i];
+        total += alignUp(sizes[i]);
+    }
+    arena.format = format;
+    arena.width = width;
+    arena.height = height;
+    arena.outFormat = outFormat;
+    arena.outWidth = outWidth;
+    arena.outHeight = outHeight;
+    arena.configured = 1;
+    pthread_mutex_unlock(&arenaLock);
+    return 1;
+}
+
+void *frameArenaBuffer(int buffer, size_t *size)
+{
+    void *p = NULL;
+
+    if (size)
+        *size = 0;
+    if (buffer < 0 || buffer >= FRAME_ARENA_BUFFERS)
+        return NULL;
+    pthread_mutex_lock(&arenaLock);
+    if (arena.configured && arena.size[buffer] > 0) {
+        p = arena.block + arena.offset[buffer];
+        if (size)
+            *size = arena.size[buffer];
+    }
+    pthread_mutex_unlock(&arenaLock);
+    return p;
+}
+
+int frameArenaGetConfig(int *format, int *width, int *height, int *outFormat, int *outWidth, int *outHeight)
+{
+    int configured;
+
+    pthread_mutex_lock(&arenaLock);
+    configured = arena.configured;
+    *format = arena.format;
+    *width = arena.width;
+    *height = arena.height;
+    *outFormat = arena.outFormat;
+    *outWidth = arena.outWidth;
+    *outHeight = arena.outHeight;
+    pthread_mutex_unlock(&arenaLock);
+    return configured;
+}
+
+int frameArenaGeneration(void)
+{
+    int generation;
+
+    pthread_mutex_lock(&arenaLock);
+    generation = arena.generation;
+    pthread_mutex_unlock(&arenaLock);
+    return generation;
+}
+
+void frameArenaRelease(void)
+{
+    pthread_mutex_lock(&arenaLock);
+    free(arena.block);
+    arena.block = NULL;
+    arena.capacity = 0;
+    arena.configured = 0;
+    arena.generation++;
+    pthread_mutex_unlock(&arenaLock);
+}
+
+// Scratch of a thread: one block per slot
+typedef struct scratchBlock {
+    void * p;
+    size_t size;
+} scratchBlock;
+
+static pthread_key_t scratchKey;
+static pthread_once_t scratchOnce = PTHREAD_ONCE_INIT;
+
+static void freeScratch(void *blocks)
+{
+    scratchBlock *b = (scratchBlock *)blocks;
+    int i;
+
+    for (i=0; i < YUV_SCRATCH_SLOTS; i++)
+        free(b[i].p);
+    free(b);
+}
+
+static void createScratchKey(void)
+{
+    pthread_key_create(&scratchKey, freeScratch);
+}
+
+void *yuvScratch(int slot, size_t bytes)
+{
+    scratchBlock *b;
+    void *p = NULL;
+
+    if (slot < 0 || slot >= YUV_SCRATCH_SLOTS)
+        return NULL;
+    if (bytes == 0)
+        bytes = 1;
+    pthread_once(&scratchOnce, createScratchKey);
+    b = pthread_getspecific(scratchKey);
+    if (!b) {
+        b = calloc(YUV_SCRATCH_SLOTS, sizeof(scratchBlock));
+        if (!b)
+            return NULL;
+        if (pthread_setspecific(scratchKey, b)) {
+            free(b);
+            return NULL;
+        }
+    }
+    if (b[slot].size < bytes) {
+        bytes = (bytes + SCRATCH_GRANULE-1) & ~(size_t)(SCRATCH_GRANULE-1);
+        if (posix_memalign(&p, FRAME_ARENA_ALIGN, bytes))
+            return NULL;
+        free(b[slot].p);
+        b[slot].p = p;
+        b[slot].size = bytes;
+    }
+    return b[slot].p;
+}
@@ -0,0 +1,56 @@
+//
+// Memory of the frame loop, allocated once and reused for every frame, so that the steady state allocates nothing:
+//
+// - Frame buffers: the input frame, the full-size image and the output that is shown (scaled and rotated), each
+//   one starting on a 64-byte cache line. frameArenaConfigure sizes them for a resolution and the formats, in one
+//   block that only grows: a frame of the same or a smaller size reuses it, so switching resolutions back and
+//   forth does not allocate either. The JNI glue exposes them to Java as direct ByteBuffers.
+// - Scratch of the kernels: the per-frame job data of a conversion (tap tables, filter windows, per-thread
+//   histograms) comes from yuvScratch, a block of the calling thread kept from frame to frame that only grows,
+//   instead of a malloc/free per frame. Being per thread, it needs no lock.
+//
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <stddef.h>
+
+#define FRAME_ARENA_ALIGN 64
+
+// Buffers of the arena (same values as MainActivity.ARENA_*)
+#define FRAME_ARENA_INPUT   0   // YUV420 frame of the format (yuvBufferSize)
+#define FRAME_ARENA_IMAGE   1   // width x height pixels of the output format (intermediate image)
+#define FRAME_ARENA_OUTPUT  2   // outWidth x outHeight pixels of the output format (image shown)
+#define FRAME_ARENA_BUFFERS 3
+
+// Size the buffers for width x height frames of format (YUV_FORMAT_*) and outWidth x outHeight images of
+// outFormat (YUV_OUT_*; outWidth or outHeight 0: no output buffer). The buffers move when the block has to
+// grow: the pointers of a previous configuration are not valid anymore (frameArenaGeneration changes).
+// Must not be called while a frame is being converted in the buffers. Returns 0 if the sizes are not valid or
+// out of memory (the arena is then empty)
+int frameArenaConfigure(int format, int width, int height, int outFormat, int outWidth, int outHeight);
+
+// Start of a buffer (NULL if the arena is not configured) and its size in bytes (size may be NULL)
+void *frameArenaBuffer(int buffer, size_t *size);
+
+// Configuration: frame size, formats and output size. Returns 0 if the arena is not configured
+int frameArenaGetConfig(int *format, int *width, int *height, int *outFormat, int *outWidth, int *outHeight);
+
+// Number of times the block has been (re)allocated
+int frameArenaGeneration(void);
+
+// Free the block
+void frameArenaRelease(void);
+
+// Scratch slots of the kernels: a function uses its own slot, so the scratch of a caller is not reused by a callee
+#define YUV_SCRATCH_STATS  0    // yuvstats.c: per-thread statistics
+#define YUV_SCRATCH_SCALE  1    // yuvscale.c: tap tables
+#define YUV_SCRATCH_FILTER 2    // yuvfilter.c: window rows of the bands
+#define YUV_SCRATCH_SLOTS  3
+
+// At least bytes of scratch of the calling thread for slot, aligned to FRAME_ARENA_ALIGN. The contents are not
+// kept when it grows (and not cleared). Valid until the next call for the same slot from the same thread; freed
+// when the thread exits. NULL if out of memory
+void *yuvScratch(int slot, size_t bytes);
+
+#endif
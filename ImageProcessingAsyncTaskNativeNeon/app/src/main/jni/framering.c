@@ -0,0 +1,252 @@
+//
+// Pipeline of camera frames (see framering.h): slots, lock-free SPSC queues and the converter thread.
+//
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "framering.h"
+
+#define QUEUE_SIZE 16           // power of two > FRAME_RING_MAX_DEPTH: a queue is never full
+#define CACHE_LINE 64
+
+// Single-producer/single-consumer queue of slot indices. head is only written by the consumer
+// and tail by the producer, each in its own cache line (no false sharing between the two threads)
+typedef struct slotQueue {
+    unsigned head __attribute__((aligned(CACHE_LINE)));
+    unsigned tail __attribute__((aligned(CACHE_LINE)));
+    int slot[QUEUE_SIZE];
+} slotQueue;
+
+typedef struct frameSlot {
+    unsigned char * nv21;
+    int * out;
+    long long seq;
+    int dropped;                // skipped by the converter: not converted
+} frameSlot;
+
+typedef struct frameRing {
+    slotQueue freeQ;            // display --> camera
+    slotQueue inQ;              // camera --> converter
+    slotQueue outQ;             // converter --> display
+    sem_t inReady;              // posted for every push to inQ / outQ (waiting only, the queues are lock-free)
+    sem_t outReady;
+    frameSlot slots[FRAME_RING_MAX_DEPTH];
+    int depth;
+    int width;
+    int height;
+    frameRingConvert convert;
+    void * arg;
+    pthread_t converter;
+    int stop;
+    int producing;              // slot returned by frameRingProduce (producer only), -1 if none
+    int acquired;               // slot returned by frameRingAcquire (consumer only), -1 if none
+    // statistics, each one written by a single thread
+    long long queued;
+    long long overruns;
+    long long droppedConverter;
+    long long converted;
+    long long droppedDisplay;
+    long long acquiredFrames;
+} frameRing;
+
+static frameRing ring;
+static int running;
+
+static void queuePush(slotQueue *q, int s)
+{
+    unsigned const t = q->tail;
+
+    q->slot[t & (QUEUE_SIZE-1)] = s;
+    __atomic_store_n(&q->tail, t+1, __ATOMIC_RELEASE);     // publishes the slot (and what was written in it)
+}
+
+static int queuePop(slotQueue *q, int *s)
+{
+    unsigned const h = q->head;
+
+    if (h == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+        return 0;
+    *s = q->slot[h & (QUEUE_SIZE-1)];
+    __atomic_store_n(&q->head, h+1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static void *converterThread(void *unused)
+{
+    int s, next;
+
+    for (;;) {
+        sem_wait(&ring.inReady);
+        if (__atomic_load_n(&ring.stop, __ATOMIC_ACQUIRE))
+            break;
+        if (!queuePop(&ring.inQ, &s))
+            continue;               // already taken with a previous post
+        // drop-oldest: only the newest queued frame is converted, the older ones go straight to the display queue
+        while (queuePop(&ring.inQ, &next)) {
+            ring.slots[s].dropped = 1;
+            __atomic_fetch_add(&ring.droppedConverter, 1, __ATOMIC_RELAXED);
+            queuePush(&ring.outQ, s);
+            sem_post(&ring.outReady);
+            s = next;
+        }
+        ring.convert(ring.arg, ring.slots[s].nv21, ring.width, ring.height, ring.slots[s].out);
+        ring.slots[s].dropped = 0;
+        __atomic_fetch_add(&ring.converted, 1, __ATOMIC_RELAXED);
+        queuePush(&ring.outQ, s);
+        sem_post(&ring.outReady);
+    }
+    return NULL;
+}
+
+static void freeSlots(void)
+{
+    int i;
+
+    for (i=0; i < FRAME_RING_MAX_DEPTH; i++) {
+        free(ring.slots[i].nv21);
+        free(ring.slots[i].out);
+        ring.slots[i].nv21 = NULL;
+        ring.slots[i].out = NULL;
+    }
+}
+
+int frameRingStart(int depth, int width, int height, int outSize, frameRingConvert convert, void *arg)
+{
+    size_t const frameBytes = (size_t)width*height*3/2;
+    int i;
+
+    if (__atomic_load_n(&running, __ATOMIC_ACQUIRE) ||
+        depth < 2 || depth > FRAME_RING_MAX_DEPTH || width < 2 || height < 2 || outSize < 1 || !convert)
+        return 0;
+    memset(&ring, 0, sizeof(ring));
+    for (i=0; i < depth; i++) {
+        void *in = NULL, *out = NULL;
+        // cache-line aligned: the SIMD kernels and the copies never split a line between two slots
+        if (posix_memalign(&in, CACHE_LINE, frameBytes) || posix_memalign(&out, CACHE_LINE, (size_t)outSize*sizeof(int))) {
+            free(in);
+            freeSlots();
+            return 0;
+        }
+        ring.slots[i].nv21 = in;
+        ring.slots[i].out = out;
+        queuePush(&ring.freeQ, i);
+    }
+    ring.depth = depth;
+    ring.width = width;
+    ring.height = height;
+    ring.convert = convert;
+    ring.arg = arg;
+    ring.producing = ring.acquired = -1;
+    sem_init(&ring.inReady, 0, 0);
+    sem_init(&ring.outReady, 0, 0);
+    if (pthread_create(&ring.converter, NULL, converterThread, NULL) != 0) {
+        sem_destroy(&ring.inReady);
+        sem_destroy(&ring.outReady);
+        freeSlots();
+        return 0;
+    }
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);      // publishes the ring to the other threads
+    return 1;
+}
+
+void frameRingStop(void)
+{
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+        return;
+    __atomic_store_n(&ring.stop, 1, __ATOMIC_RELEASE);
+    sem_post(&ring.inReady);
+    pthread_join(ring.converter, NULL);
+    sem_destroy(&ring.inReady);
+    sem_destroy(&ring.outReady);
+    freeSlots();
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+}
+
+int frameRingRunning(void)
+{
+    return __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+}
+
+unsigned char * frameRingProduce(void)
+{
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+        return NULL;
+    if (ring.producing < 0 && !queuePop(&ring.freeQ, &ring.producing)) {
+        __atomic_fetch_add(&ring.overruns, 1, __ATOMIC_RELAXED);            // every slot is in flight: this frame is dropped
+        return NULL;
+    }
+    return ring.slots[ring.producing].nv21;
+}
+
+void frameRingQueue(void)
+{
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE) || ring.producing < 0)
+        return;
+    ring.slots[ring.producing].seq = __atomic_fetch_add(&ring.queued, 1, __ATOMIC_RELAXED);
+    queuePush(&ring.inQ, ring.producing);
+    ring.producing = -1;
+    sem_post(&ring.inReady);
+}
+
+const int * frameRingAcquire(int timeoutMs, long long *seq)
+{
+    struct timespec deadline;
+    int s, best = -1;
+
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+        return NULL;
+    if (ring.acquired >= 0)
+        frameRingRelease();
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs/1000;
+    deadline.tv_nsec += (long)(timeoutMs%1000)*1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    for (;;) {
+        // drop-oldest: keep the newest converted frame, give the others back
+        while (queuePop(&ring.outQ, &s)) {
+            if (ring.slots[s].dropped) {
+                queuePush(&ring.freeQ, s);
+                continue;
+            }
+            if (best >= 0) {
+                __atomic_fetch_add(&ring.droppedDisplay, 1, __ATOMIC_RELAXED);
+                queuePush(&ring.freeQ, best);
+            }
+            best = s;
+        }
+        if (best >= 0)
+            break;
+        if (sem_timedwait(&ring.outReady, &deadline) != 0 && errno == ETIMEDOUT)
+            return NULL;
+    }
+    ring.acquired = best;
+    __atomic_fetch_add(&ring.acquiredFrames, 1, __ATOMIC_RELAXED);
+    if (seq)
+        *seq = ring.slots[best].seq;
+    return ring.slots[best].out;
+}
+
+void frameRingRelease(void)
+{
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE) || ring.acquired < 0)
+        return;
+    queuePush(&ring.freeQ, ring.acquired);
+    ring.acquired = -1;
+}
+
+void frameRingGetStats(frameRingStats *stats)
+{
+    stats->queued = __atomic_load_n(&ring.queued, __ATOMIC_RELAXED);
+    stats->overruns = __atomic_load_n(&ring.overruns, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&ring.droppedConverter, __ATOMIC_RELAXED) +
+                     __atomic_load_n(&ring.droppedDisplay, __ATOMIC_RELAXED);
+    stats->converted = __atomic_load_n(&ring.converted, __ATOMIC_RELAXED);
+    stats->acquired = __atomic_load_n(&ring.acquiredFrames, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,53 @@
+//
+// Pipeline of camera frames: a ring of pre-allocated slots (NV21 input + RGBA output) that move
+// between three lock-free single-producer/single-consumer queues:
+//
+//   camera thread --(queued)--> converter thread --(converted)--> display thread --(free)--> camera thread
+//
+// The camera thread copies each frame into a free slot and gives the camera buffer back at once,
+// the converter thread converts it while the display thread shows the previous one, so capture,
+// conversion and display of consecutive frames overlap.
+// Drop-oldest policy: the converter only converts the newest queued frame and the display only takes
+// the newest converted one; the older ones go back to the free queue. A frame that arrives when every
+// slot is in flight is dropped too (overrun).
+//
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#define FRAME_RING_MAX_DEPTH 8
+
+// Conversion run by the converter thread for every frame: nv21 (width x height) --> out (outSize ints)
+typedef void (*frameRingConvert)(void *arg, const unsigned char * nv21, int width, int height, int * out);
+
+typedef struct frameRingStats {
+    long long queued;           // frames queued by the producer
+    long long overruns;         // frames dropped by the producer: no free slot
+    long long dropped;          // frames skipped by the converter or the display (a newer one was waiting)
+    long long converted;
+    long long acquired;         // frames returned by frameRingAcquire
+} frameRingStats;
+
+// Allocate depth (2 .. FRAME_RING_MAX_DEPTH) slots for width x height frames and outSize ints of output,
+// and start the converter thread. Returns 0 if the ring is already running or on failure.
+int frameRingStart(int depth, int width, int height, int outSize, frameRingConvert convert, void *arg);
+
+// Stop the converter thread and free the slots. The producer and the consumer must have stopped
+void frameRingStop(void);
+
+int frameRingRunning(void);
+
+// Producer (one thread): a free slot to copy the next NV21 frame into (width*height*3/2 bytes), then
+// frameRingQueue() hands it to the converter. Returns NULL (frame dropped) if every slot is in flight.
+unsigned char * frameRingProduce(void);
+void frameRingQueue(void);
+
+// Consumer (one thread): wait up to timeoutMs for a converted frame and return its output (outSize ints),
+// which stays valid until frameRingRelease(). seq (may be NULL) gets its number, counted from 0 by
+// frameRingQueue. Returns NULL on timeout.
+const int * frameRingAcquire(int timeoutMs, long long *seq);
+void frameRingRelease(void);
+
+void frameRingGetStats(frameRingStats *stats);
+
+#endif
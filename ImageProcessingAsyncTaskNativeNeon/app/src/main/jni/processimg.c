@@ -1,169 +1,113 @@
 #include <string.h>
 #include <jni.h>
-#include <pthread.h>
 #include <omp.h>
 #include <android/log.h>
+#include "workerpool.h"
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+#include "yuvbatch.h"
+#include "yuvscale.h"
+#include "yuvfilter.h"
+#include "yuvroi.h"
+#include "yuvstats.h"
+#include "framearena.h"
+#include "framering.h"
+#include "yuvprofile.h"
+#include "processimg.h"
 
-#define MAX_NUM_THREADS 16
-
-    typedef struct paramST {  // data structure holding all operands needed by a worker thread
-        unsigned char * data;
-        int * pixels;
-        int width;
-        int height;
-        int my_id;
-        int nthr;
-    } paramST;
-
-    // return RGB value from YUV
-    static int convertYUVtoRGB(int y, int u, int v)
-    {
-        int r,g,b;
-
-        r = y + (int)1.14f*v;
-        g = y - (int)(0.395f*u +0.581f*v);
-        b = y + (int)2.033f*u;
-        r = r>255? 255 : r<0 ? 0 : r;
-        g = g>255? 255 : g<0 ? 0 : g;
-        b = b>255? 255 : b<0 ? 0 : b;
-        return 0xff000000 | (b<<16) | (g<<8) | r; // one byte for alpha, one for blue, one for green, one for red
-    }
-
-    // process the whole image
-    static void convertYUV420_NV21toRGB8888(const unsigned char * data, int * pixels, int width, int height)
-    // pixels must have room for width*height ints, one per pixel
-    {
-         int size = width*height;
-         int u, v, y1, y2, y3, y4;
-         int i, k;
-
-         // i traverses Y
-         // k traverses U and V
-         for(i=0, k=0; i < size; i+=2, k+=2) { // each 4x4 region of the bitmap has the same (u,v) but different y1,y2,y3,y4
-             y1 = data[i  ]&0xff;
-             y2 = data[i+1]&0xff;
-             y3 = data[width+i  ]&0xff;
-             y4 = data[width+i+1]&0xff;
-
-             u = data[size+k  ]&0xff;
-             v = data[size+k+1]&0xff;
-             u = u-128;
-             v = v-128;
-
-             pixels[i  ] = convertYUVtoRGB(y1, u, v);
-             pixels[i+1] = convertYUVtoRGB(y2, u, v);
-             pixels[width+i  ] = convertYUVtoRGB(y3, u, v);
-             pixels[width+i+1] = convertYUVtoRGB(y4, u, v);
-
-             if (i!=0 && (i+2)%width==0)
-                 i+=width;
-         }
-    }
-
-    // Process a chunk of the image
-     void *convertYUV420_NV21toRGB8888Chunk(void *args)
-    // pixels must have room for width*height ints, one per pixel. See https://en.wikipedia.org/wiki/YUV
-    {
-        paramST *param = (paramST *)args;
-
-        unsigned char * data = param->data;
-        int * pixels = param->pixels;
-        int width = param->width;
-        int height = param->height;
-        int my_id = param->my_id;
-        int nThreads = param->nthr;
-
-        int size = width*height;
-        int u=0, v=0, y1, y2, y3, y4;
-        int myEnd, myOff;
-        int i, k;
-
-        int myInitRow = (int)(((float)my_id/(float)nThreads)*((float)height/2.0f));
-        int nextThreadRow = (int)(((float)(my_id+1)/(float)nThreads)*((float)height/2.0f));
-        myOff = 2*width*myInitRow;
-        myEnd = 2*width*nextThreadRow;
-        int myUVOff = size+myInitRow*width;
-        for(i=myOff, k=myUVOff; i < myEnd; i+=2, k+=2) { // each 4x4 region of the bitmap has the same (u,v) but different y1,y2,y3,y4
-            y1 = data[i  ]&0xff;
-            y2 = data[i+1]&0xff;
-            y3 = data[width+i  ]&0xff;
-            y4 = data[width+i+1]&0xff;
-
-            u = data[k  ]&0xff;
-            v = data[k+1]&0xff;
-            u = u-128;
-            v = v-128;
-
-            pixels[i  ] = convertYUVtoRGB(y1, u, v);
-            pixels[i+1] = convertYUVtoRGB(y2, u, v);
-            pixels[width+i  ] = convertYUVtoRGB(y3, u, v);
-            pixels[width+i+1] = convertYUVtoRGB(y4, u, v);
-
-            if (i!=0 && (i+2)%width==0)
-                i+=width;
-        }
-        pthread_exit(NULL);
-    }
-
-    // process the whole image
-    static void convertYUV420_NV21toRGB8888_OMP(const unsigned char * data, int * pixels, int width, int height)
-    // pixels must have room for width*height ints, one per pixel
-    {
-        int size = width*height;
-        int u, v, y1, y2, y3, y4;
-        int i, k, y, yrow, ycol;
-
-        // "y" traverses the set of four "Y"-pixels that share components U and V.
-#pragma omp parallel for schedule(guided) private(yrow, ycol, i, k, u, v, y1, y2, y3, y4)
-        for (y=0; y<size/4; y++) {
-            //__android_log_print(ANDROID_LOG_INFO, "HOOKnative", "num threads %d", omp_get_num_threads());
-            yrow = (int)(y/(width/2));              // row of the first "y" set
-            ycol = y % (width/2);                   // col of the first "y" set
-            i = 2*(yrow*width + ycol);              // offset in array "data" of first "Y" of "y" set
-            k = size + yrow*width + 2*ycol;         // offset in array "data" of the "U" component of "y" set
-
-            y1 = data[i  ]&0xff;
-            y2 = data[i+1]&0xff;
-            y3 = data[width+i  ]&0xff;
-            y4 = data[width+i+1]&0xff;
-
-            u = data[k  ]&0xff;
-            v = data[k+1]&0xff;
-            u = u-128;
-            v = v-128;
-
-            pixels[i  ] = convertYUVtoRGB(y1, u, v);
-            pixels[i+1] = convertYUVtoRGB(y2, u, v);
-            pixels[width+i  ] = convertYUVtoRGB(y3, u, v);
-            pixels[width+i+1] = convertYUVtoRGB(y4, u, v);
-        }
-    }
-
-    // Process the whole image in parallel using nthr pthreads
-    static void convertYUV420_NV21toRGB8888Parallel(const unsigned char * data, int * pixels, int width, int height, int nthr)
-    {
-        pthread_t th[MAX_NUM_THREADS];
-        paramST params[MAX_NUM_THREADS];
-        int status;
-        int my_nthr = nthr;
-        int i;
-
-        if (my_nthr > MAX_NUM_THREADS)
-            my_nthr = MAX_NUM_THREADS;
-        for (i=0; i < my_nthr; i++) {
-            params[i].data = data;
-            params[i].pixels = pixels;
-            params[i].width = width;
-            params[i].height = height;
-            params[i].my_id = i;
-            params[i].nthr = my_nthr;
-            pthread_create(&(th[i]), NULL, convertYUV420_NV21toRGB8888Chunk, (void *)&(params[i]));
-        }
-        for (i=0; i < my_nthr; i++) {
-            pthread_join(th[i], (void*)&status);
+    static volatile jlong jniCopiedBytes;   // bytes copied by the VM in the Get/Release*ArrayElements calls
+
+    void jniCountCopy(jboolean isCopy, jlong bytes)
+    {
+        if (isCopy)
+            __sync_fetch_and_add(&jniCopiedBytes, bytes);
+    }
+
+    // Native function called from Java to read the bytes copied by the VM since the library was loaded
+    jlong Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_getJNICopiedBytes( JNIEnv* env, jobject thiz)
+    {
+        return __sync_fetch_and_add(&jniCopiedBytes, 0);
+    }
+
+    // Backends of the zero-copy entry points (same values as MainActivity.BACKEND_*)
+    #define BACKEND_SCALAR    0
+    #define BACKEND_PTHREAD   1
+    #define BACKEND_OMP       2
+    #define BACKEND_POOL      3
+    #define BACKEND_SIMD      4
+    #define BACKEND_SIMD_POOL 5
+    #define BACKEND_LUT       6
+    #define BACKEND_LUT_POOL  7
+
+    // Convert with the selected backend. No JNI call is allowed here: it may run inside a critical region
+    static void convertWithBackend(int backend, const unsigned char * data, int * pixels, int width, int height, int nthreads)
+    {
+        switch (backend) {
+            case BACKEND_PTHREAD:   convertYUV420_NV21toRGB8888Parallel(data, pixels, width, height, nthreads); break;
+            case BACKEND_OMP:       omp_set_num_threads(nthreads);
+                                    convertYUV420_NV21toRGB8888_OMP(data, pixels, width, height); break;
+            case BACKEND_POOL:      convertYUV420_NV21toRGB8888Pool(data, pixels, width, height); break;
+            case BACKEND_SIMD:      convertYUV420_NV21toRGB8888_SIMD(data, pixels, width, height); break;
+            case BACKEND_SIMD_POOL: convertYUV420_NV21toRGB8888_SIMDParallel(data, pixels, width, height); break;
+            case BACKEND_LUT:       convertYUV420_NV21toRGB8888_LUT(data, pixels, width, height); break;
+            case BACKEND_LUT_POOL:  convertYUV420_NV21toRGB8888LUTPool(data, pixels, width, height); break;
+            default:                convertYUV420_NV21toRGB8888(data, pixels, width, height); break;
         }
     }
 
+    // 1 if width x height is a frame the NV21 backends can convert: at least 2x2, with an even width and
+    // height (the same rule as yuvImageCheck). With an odd width they write one int past width*height
+    static int frameValid(int width, int height)
+    {
+        return width >= 2 && height >= 2 && !(width&1) && !(height&1);
+    }
+
+    // Called when the library is loaded: select the SIMD kernels for this CPU and start the worker pool with one thread per core
+    jint JNI_OnLoad(JavaVM* vm, void* reserved)
+    {
+        yuvDispatchInit();
+        workerPoolInit(0);
+        return JNI_VERSION_1_6;
+    }
+
+    // Native function called from Java to select the colour matrix (0: BT.601, 1: BT.709) and range used by all the native backends
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_setColorSpace( JNIEnv* env, jobject thiz, jint matrix, jboolean fullRange)
+    {
+        yuvSetColorSpace(matrix, fullRange ? YUV_FULL_RANGE : YUV_LIMITED_RANGE);
+    }
+
+    // Native function called from Java to (re)start the worker pool with nthreads threads
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_initNativePool( JNIEnv* env, jobject thiz, jint nthreads)
+    {
+        workerPoolInit(nthreads);
+    }
+
+    // Native function called from Java to select how the rows are scheduled on the worker pool (MainActivity.SCHED_*)
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_setNativeSchedule( JNIEnv* env, jobject thiz, jint sched)
+    {
+        workerPoolSetSchedule(sched);
+    }
+
+    // Native function called from Java to read the number of big cores (0 if all the cores are the same)
+    jint Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_getNativeBigCores( JNIEnv* env, jobject thiz)
+    {
+        return workerPoolBigCores();
+    }
+
+    // Native function called from Java to pin the worker pool threads to the big cores (or let them run anywhere).
+    // Returns the number of cores they can run on (0 if not supported)
+    jint Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_pinNativePool( JNIEnv* env, jobject thiz, jboolean bigOnly)
+    {
+        return workerPoolSetAffinity(bigOnly);
+    }
+
+    // Native function called from Java to stop the worker pool
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_shutdownNativePool( JNIEnv* env, jobject thiz)
+    {
+        workerPoolShutdown();
+    }
+
     // Native function called from Java to process a image
     void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNative( JNIEnv* env, jobject thiz,
                                                                         jbyteArray data,
@@ -171,22 +115,29 @@
                                                                          jint width, jint height)
     {
         unsigned char *cData;
-        int *cResult;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
 
-        cData = (*env)->GetByteArrayElements(env,data,NULL); // While arrays of objects must be accessed one entry at a time, arrays of primitives can be read and written directly as if they were declared in C.   http://developer.android.com/training/articles/perf-jni.html
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy); // While arrays of objects must be accessed one entry at a time, arrays of primitives can be read and written directly as if they were declared in C.   http://developer.android.com/training/articles/perf-jni.html
         if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't not get data array reference");
         else
         {
-            cResult= (*env)->GetIntArrayElements(env,result,NULL);
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
             if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't not get result array reference");
             else
             {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
                 // operates on data
                 convertYUV420_NV21toRGB8888(cData,cResult,width,height);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
             }
         }
         if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0); // care: errors in the type of the pointers are detected in runtime
-        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, 0); // release must be done even when the original array is not copied into cDATA
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
 
         // Log from native (need 'ndk {ldLibs "log"}' in app/build.gradle
         //__android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Log from native function: %s", buf);
@@ -200,22 +151,61 @@
                                                        jint width, jint height, jint nthreads)
     {
         unsigned char *cData;
-        int *cResult;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
 
-        cData = (*env)->GetByteArrayElements(env,data,NULL); // While arrays of objects must be accessed one entry at a time, arrays of primitives can be read and written directly as if they were declared in C.   http://developer.android.com/training/articles/perf-jni.html
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy); // While arrays of objects must be accessed one entry at a time, arrays of primitives can be read and written directly as if they were declared in C.   http://developer.android.com/training/articles/perf-jni.html
         if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
         else
         {
-            cResult= (*env)->GetIntArrayElements(env,result,NULL);
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
             if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
             else
             {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
                 // operates on data
                 convertYUV420_NV21toRGB8888Parallel(cData,cResult,width,height,nthreads);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0); // care: errors in the type of the pointers are detected at runtime
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+    }
+
+    // Native function called from Java to process a image in parallel on the worker pool
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativePool( JNIEnv* env, jobject thiz,
+                                                       jbyteArray data,
+                                                       jintArray result,
+                                                       jint width, jint height)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
+
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy); // While arrays of objects must be accessed one entry at a time, arrays of primitives can be read and written directly as if they were declared in C.   http://developer.android.com/training/articles/perf-jni.html
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
+            if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
+            else
+            {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                // operates on data
+                convertYUV420_NV21toRGB8888Pool(cData,cResult,width,height);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
             }
         }
         if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0); // care: errors in the type of the pointers are detected at runtime
-        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, 0); // release must be done even when the original array is not copied into cDATA
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
     }
 
     // Native function called from Java to process an image in parallel using nthreads threads
@@ -225,24 +215,877 @@
                                                                                      jint width, jint height, jint nthreads)
     {
         unsigned char *cData;
-        int *cResult;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
 
-        cData = (*env)->GetByteArrayElements(env,data,NULL); // While arrays of objects must be accessed one entry at a time, arrays of primitives can be read and written directly as if they were declared in C.   http://developer.android.com/training/articles/perf-jni.html
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy); // While arrays of objects must be accessed one entry at a time, arrays of primitives can be read and written directly as if they were declared in C.   http://developer.android.com/training/articles/perf-jni.html
         if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
         else
         {
-            cResult= (*env)->GetIntArrayElements(env,result,NULL);
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
             if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
             else
             {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
                 omp_set_num_threads(nthreads);
                 // operates on data
                 convertYUV420_NV21toRGB8888_OMP(cData,cResult,width,height);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
             }
         }
         if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0); // care: errors in the type of the pointers are detected at runtime
-        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, 0); // release must be done even when the original array is not copied into cDATA
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+    }
+
+    // Native function called from Java to process an image in grey (only the Y plane is read)
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoGREYNative( JNIEnv* env, jobject thiz,
+                                                                                     jbyteArray data,
+                                                                                     jintArray result,
+                                                                                     jint width, jint height)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
+
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
+            if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
+            else
+            {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                convertYUV420_NV21toGREY8888(cData,cResult,width,height);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+    }
+
+    // Native function called from Java to process an image in grey in parallel using nthreads threads
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoGREYNativeParallel( JNIEnv* env, jobject thiz,
+                                                                                     jbyteArray data,
+                                                                                     jintArray result,
+                                                                                     jint width, jint height, jint nthreads)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
+
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
+            if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
+            else
+            {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                convertYUV420_NV21toGREY8888Parallel(cData,cResult,width,height,nthreads);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+    }
+
+    // Native function called from Java to process an image in grey in parallel on the worker pool
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoGREYNativePool( JNIEnv* env, jobject thiz,
+                                                                                     jbyteArray data,
+                                                                                     jintArray result,
+                                                                                     jint width, jint height)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
+
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
+            if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
+            else
+            {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                convertYUV420_NV21toGREY8888Pool(cData,cResult,width,height);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+    }
+
+    // Native function called from Java to process an image in grey in parallel using nthreads OpenMP threads
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoGREYNativeParallelOMP( JNIEnv* env, jobject thiz,
+                                                                                     jbyteArray data,
+                                                                                     jintArray result,
+                                                                                     jint width, jint height, jint nthreads)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
+
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cResult= (*env)->GetIntArrayElements(env,result,&resultCopy);
+            if (cResult==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
+            else
+            {
+                jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)(*env)->GetArrayLength(env,result));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                omp_set_num_threads(nthreads);
+                convertYUV420_NV21toGREY8888_OMP(cData,cResult,width,height);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleaseIntArrayElements(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
     }
 
+    // Native function called from Java to get the single channel grey image (one byte per pixel) of a frame,
+    // e.g. for the image processing filters; grey must have room for width*height bytes
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoGREY8Native( JNIEnv* env, jobject thiz,
+                                                                                     jbyteArray data,
+                                                                                     jbyteArray grey,
+                                                                                     jint width, jint height)
+    {
+        unsigned char *cData;
+        unsigned char *cGrey = NULL;
+        jboolean dataCopy, greyCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
+
+        cData = (*env)->GetByteArrayElements(env,data,&dataCopy);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            jniCountCopy(dataCopy, (*env)->GetArrayLength(env,data));
+            cGrey= (*env)->GetByteArrayElements(env,grey,&greyCopy);
+            if (cGrey==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get grey array reference");
+            else if ((*env)->GetArrayLength(env,grey) < width*height)
+                __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Grey array too small");
+            else
+            {
+                jniCountCopy(greyCopy, 2*(jlong)(*env)->GetArrayLength(env,grey));    // copied in and back out
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                convertYUV420_NV21toGREY8_SIMD(cData,cGrey,width,height);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cGrey!=NULL) (*env)->ReleaseByteArrayElements(env,grey,cGrey,0);
+        if (cData!=NULL) (*env)->ReleaseByteArrayElements(env, data, cData, JNI_ABORT); // the input is never written: nothing to copy back
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+    }
 
+    // Native function called from Java to process an image without copying the arrays: the VM pins them
+    // (GetPrimitiveArrayCritical) and the input is released with JNI_ABORT. Returns false if they can't be pinned
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeCritical( JNIEnv* env, jobject thiz,
+                                                                                     jbyteArray data,
+                                                                                     jintArray result,
+                                                                                     jint width, jint height,
+                                                                                     jint backend, jint nthreads)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        jboolean dataCopy, resultCopy;
+        long long t = yuvProfStart();           // stage timestamps (0 if the profiler is off)
 
+        // the lengths are read before entering the critical region (no JNI calls are allowed inside)
+        if (!frameValid(width, height) ||
+            (*env)->GetArrayLength(env,data) < width*height*3/2 || (*env)->GetArrayLength(env,result) < width*height) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Arrays not valid for %dx%d", width, height);
+            return JNI_FALSE;
+        }
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,&dataCopy);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            cResult = (*env)->GetPrimitiveArrayCritical(env,result,&resultCopy);
+            if (cResult!=NULL) {
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                convertWithBackend(backend,cData,cResult,width,height,nthreads);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        if (cData==NULL || cResult==NULL)
+            return JNI_FALSE;
+        // a VM may still copy (e.g. with a moving GC that can't pin): account it as GetArrayElements
+        jniCountCopy(dataCopy, (jlong)width*height*3/2);
+        jniCountCopy(resultCopy, 2*sizeof(jint)*(jlong)width*height);
+        return JNI_TRUE;
+    }
+
+    // Native function called from Java to process an image held in direct ByteBuffers (ByteBuffer.allocateDirect):
+    // data holds the NV21 frame and result receives width*height ints (0xAARRGGBB), with no copies at all
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeDirect( JNIEnv* env, jobject thiz,
+                                                                                   jobject data,
+                                                                                   jobject result,
+                                                                                   jint width, jint height,
+                                                                                   jint backend, jint nthreads)
+    {
+        unsigned char *cData = (*env)->GetDirectBufferAddress(env,data);
+        int *cResult = (*env)->GetDirectBufferAddress(env,result);
+        long long t = yuvProfStart();
+
+        if (cData==NULL || cResult==NULL) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Not a direct buffer");
+            return JNI_FALSE;
+        }
+        if (!frameValid(width, height) || (*env)->GetDirectBufferCapacity(env,data) < (jlong)width*height*3/2 ||
+            (*env)->GetDirectBufferCapacity(env,result) < (jlong)sizeof(jint)*width*height) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Buffers not valid for %dx%d", width, height);
+            return JNI_FALSE;
+        }
+        yuvProfLap(&t, YUV_STAGE_JNI_IN);
+        convertWithBackend(backend,cData,cResult,width,height,nthreads);
+        yuvProfLap(&t, YUV_STAGE_CONVERT);
+        return JNI_TRUE;
+    }
+
+    // 1 if a direct buffer of a plane holds rows x cols samples with those strides
+    static int planeFits(JNIEnv* env, jobject buffer, int rows, int cols, int rowStride, int pixelStride)
+    {
+        return (*env)->GetDirectBufferCapacity(env,buffer) >= (jlong)(rows-1)*rowStride + (jlong)(cols-1)*pixelStride + 1;
+    }
+
+    // Native function called from Java to convert the planes of a YUV_420_888 image (android.media.Image.getPlanes())
+    // in place: y, u and v are the direct buffers of the planes, with their row and pixel strides. Any layout
+    // (NV21, NV12, I420, YV12, padded rows) is read without repacking. Returns false if it can't be converted
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativePlanes( JNIEnv* env, jobject thiz,
+                                                                                   jobject y, jint yRowStride,
+                                                                                   jobject u, jobject v,
+                                                                                   jint uvRowStride, jint uvPixelStride,
+                                                                                   jintArray result,
+                                                                                   jint width, jint height,
+                                                                                   jboolean parallel)
+    {
+        yuvImage img;
+        int *cResult;
+        int done;
+        long long t = yuvProfStart();
+
+        img.width = width;
+        img.height = height;
+        img.y.data = (*env)->GetDirectBufferAddress(env,y);
+        img.y.rowStride = yRowStride;
+        img.y.pixelStride = 1;
+        img.u.data = (*env)->GetDirectBufferAddress(env,u);
+        img.v.data = (*env)->GetDirectBufferAddress(env,v);
+        img.u.rowStride = img.v.rowStride = uvRowStride;
+        img.u.pixelStride = img.v.pixelStride = uvPixelStride;
+        if (img.y.data==NULL || img.u.data==NULL || img.v.data==NULL) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Not a direct buffer");
+            return JNI_FALSE;
+        }
+        if (!yuvImageCheck(&img, 0, height/2) || !planeFits(env, y, height, width, yRowStride, 1) ||
+            !planeFits(env, u, height/2, width/2, uvRowStride, uvPixelStride) || !planeFits(env, v, height/2, width/2, uvRowStride, uvPixelStride) ||
+            (*env)->GetArrayLength(env,result) < width*height) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Planes not valid for %dx%d", width, height);
+            return JNI_FALSE;
+        }
+        cResult = (*env)->GetPrimitiveArrayCritical(env,result,NULL);
+        if (cResult==NULL) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get result array reference");
+            return JNI_FALSE;
+        }
+        yuvProfLap(&t, YUV_STAGE_JNI_IN);
+        done = parallel ? convertYUV420toRGB8888_SIMDParallel(&img,cResult) : convertYUV420toRGB8888_SIMD(&img,cResult);
+        yuvProfLap(&t, YUV_STAGE_CONVERT);
+        (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Size of the statistics returned to Java (MainActivity.STATS_*): count, sum and sum of squares of Y,
+    // min and max Y, then the histograms of Y, R, G and B
+    #define STATS_FIELDS (5 + 4*256)
+
+    // Native function called from Java to convert an NV21 frame with the given backend (the pthread, OpenMP, pool or
+    // sequential kernel family, all with SIMD row pairs) and return the statistics of the frame, counted in the same pass
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeStats( JNIEnv* env, jobject thiz,
+                                                                                  jbyteArray data,
+                                                                                  jintArray result,
+                                                                                  jint width, jint height,
+                                                                                  jint backend, jint nthreads,
+                                                                                  jlongArray stats)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        yuvStats s;
+        jlong values[STATS_FIELDS];
+        int done = 0, i;
+        long long t = yuvProfStart();
+
+        if ((*env)->GetArrayLength(env,data) < width*height*3/2 || (*env)->GetArrayLength(env,result) < width*height ||
+            (*env)->GetArrayLength(env,stats) < STATS_FIELDS)
+            return JNI_FALSE;
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            cResult = (*env)->GetPrimitiveArrayCritical(env,result,NULL);
+            if (cResult!=NULL) {
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                switch (backend) {
+                    case BACKEND_PTHREAD:   convertYUV420_NV21toRGB8888StatsParallel(cData,cResult,width,height,nthreads,&s); break;
+                    case BACKEND_OMP:       omp_set_num_threads(nthreads);
+                                            convertYUV420_NV21toRGB8888Stats_OMP(cData,cResult,width,height,&s); break;
+                    case BACKEND_POOL:
+                    case BACKEND_SIMD_POOL:
+                    case BACKEND_LUT_POOL:  convertYUV420_NV21toRGB8888StatsPool(cData,cResult,width,height,&s); break;
+                    default:                convertYUV420_NV21toRGB8888Stats(cData,cResult,width,height,&s); break;
+                }
+                done = 1;
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        if (done) {
+            values[0] = s.count;
+            values[1] = s.sumY;
+            values[2] = s.sumSqY;
+            values[3] = s.minY;
+            values[4] = s.maxY;
+            for (i=0; i < 256; i++) {
+                values[5+i] = s.histY[i];
+                values[5+256+i] = s.histR[i];
+                values[5+512+i] = s.histG[i];
+                values[5+768+i] = s.histB[i];
+            }
+            (*env)->SetLongArrayRegion(env,stats,0,STATS_FIELDS,values);
+        }
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Native function called from Java to convert only the rectangle (x, y, roiWidth, roiHeight) of an NV21 frame
+    // into result, which keeps the rest of the previous image. Returns false if nothing was converted
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeROI( JNIEnv* env, jobject thiz,
+                                                                                jbyteArray data,
+                                                                                jintArray result,
+                                                                                jint width, jint height,
+                                                                                jint x, jint y, jint roiWidth, jint roiHeight,
+                                                                                jboolean parallel)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        yuvRect roi = { x, y, roiWidth, roiHeight };
+        int done = 0;
+        long long t = yuvProfStart();
+
+        if ((*env)->GetArrayLength(env,data) < width*height*3/2 || (*env)->GetArrayLength(env,result) < width*height)
+            return JNI_FALSE;
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            cResult = (*env)->GetPrimitiveArrayCritical(env,result,NULL);
+            if (cResult!=NULL) {
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                done = convertYUV420_NV21toRGB8888ROI(cData,cResult,width,height,&roi,parallel);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Tracker of the incremental conversion, for the size of the last frame (one caller thread at a time)
+    static yuvDirtyTracker *dirtyTracker;
+    static int dirtyWidth, dirtyHeight;
+
+    // Native function called from Java to convert only the tiles (MainActivity.DIRTY_TILE_*) of an NV21 frame that
+    // changed by more than threshold (SAD) since they were last converted into result. dirty (may be null, room for
+    // every tile) gets the indices of the tiles converted (row major). Returns how many, -1 on error
+    jint Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeIncremental( JNIEnv* env, jobject thiz,
+                                                                                    jbyteArray data,
+                                                                                    jintArray result,
+                                                                                    jint width, jint height,
+                                                                                    jint threshold,
+                                                                                    jintArray dirty,
+                                                                                    jboolean parallel)
+    {
+        unsigned char *cData;
+        int *cResult = NULL, *cDirty = NULL;
+        yuvImage img;
+        int n = -1;
+        long long t = yuvProfStart();
+
+        if ((*env)->GetArrayLength(env,data) < width*height*3/2 || (*env)->GetArrayLength(env,result) < width*height)
+            return -1;
+        if (!dirtyTracker || dirtyWidth != width || dirtyHeight != height) {
+            yuvDirtyDestroy(dirtyTracker);
+            dirtyTracker = yuvDirtyCreate(width, height, 0, 0);
+            dirtyWidth = width;
+            dirtyHeight = height;
+            if (!dirtyTracker) {
+                __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't create the tile tracker for %dx%d", width, height);
+                return -1;
+            }
+        }
+        if (dirty!=NULL && (*env)->GetArrayLength(env,dirty) < yuvDirtyTileCount(dirtyTracker,NULL,NULL))
+            dirty = NULL;
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            cResult = (*env)->GetPrimitiveArrayCritical(env,result,NULL);
+            if (dirty!=NULL) cDirty = (*env)->GetPrimitiveArrayCritical(env,dirty,NULL);
+            if (cResult!=NULL && (dirty==NULL || cDirty!=NULL) &&
+                yuvImageFromBuffer(&img,cData,YUV_FORMAT_NV21,width,height,width)) {
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                n = convertYUV420toFormatIncremental(dirtyTracker,&img,cResult,YUV_OUT_INT8888,threshold,cDirty,parallel);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cDirty!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,dirty,cDirty,0);
+        if (cResult!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        return n;
+    }
+
+    // Native function called from Java to convert every tile on the next incremental frame (the result array
+    // was written by something else)
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_resetIncremental( JNIEnv* env, jobject thiz)
+    {
+        if (dirtyTracker)
+            yuvDirtyReset(dirtyTracker);
+    }
+
+    // Native function called from Java to convert a packed frame of any YUV_FORMAT_* (MainActivity) with a
+    // Y row stride of stride bytes (width if 0). Returns false if it can't be converted
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeFormat( JNIEnv* env, jobject thiz,
+                                                                                   jbyteArray data, jint format, jint stride,
+                                                                                   jintArray result,
+                                                                                   jint width, jint height,
+                                                                                   jboolean parallel)
+    {
+        int const size = yuvBufferSize(format, width, height, stride);
+        unsigned char *cData;
+        int *cResult = NULL;
+        yuvImage img;
+        int done = 0;
+        long long t = yuvProfStart();
+
+        if (size==0 || (*env)->GetArrayLength(env,data) < size || (*env)->GetArrayLength(env,result) < width*height) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Format %d not valid for %dx%d (stride %d)", format, width, height, stride);
+            return JNI_FALSE;
+        }
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            cResult = (*env)->GetPrimitiveArrayCritical(env,result,NULL);
+            if (cResult!=NULL && yuvImageFromBuffer(&img,cData,format,width,height,stride)) {
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                done = parallel ? convertYUV420toRGB8888_SIMDParallel(&img,cResult) : convertYUV420toRGB8888_SIMD(&img,cResult);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Native function called from Java to convert a packed frame of any YUV_FORMAT_* straight into one of the
+    // output formats (MainActivity.OUT_*: RGBA8888, BGRA8888, RGB565, RGB888) in a direct ByteBuffer of
+    // width*height pixels, e.g. for Bitmap.copyPixelsFromBuffer on an RGB_565 bitmap. Returns false if it can't be converted
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeOutput( JNIEnv* env, jobject thiz,
+                                                                                   jbyteArray data, jint format, jint stride,
+                                                                                   jobject result, jint outFormat,
+                                                                                   jint width, jint height,
+                                                                                   jboolean parallel)
+    {
+        int const size = yuvBufferSize(format, width, height, stride);
+        void *cResult = (*env)->GetDirectBufferAddress(env,result);
+        unsigned char *cData;
+        yuvImage img;
+        int done = 0;
+        long long t = yuvProfStart();
+
+        if (cResult==NULL) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Not a direct buffer");
+            return JNI_FALSE;
+        }
+        if (size==0 || !YUV_OUT_VALID(outFormat) || (*env)->GetArrayLength(env,data) < size ||
+            (*env)->GetDirectBufferCapacity(env,result) < (jlong)YUV_OUT_BYTES(outFormat)*width*height) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Format %d -> %d not valid for %dx%d (stride %d)", format, outFormat, width, height, stride);
+            return JNI_FALSE;
+        }
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            if (yuvImageFromBuffer(&img,cData,format,width,height,stride)) {
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                done = parallel ? convertYUV420toFormat_SIMDParallel(&img,cResult,outFormat) : convertYUV420toFormat_SIMD(&img,cResult,outFormat);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+            (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+            yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        }
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Native function called from Java to convert count frames of any YUV_FORMAT_* stored one after the other in the
+    // direct ByteBuffer frames into result (direct too), one after the other in outFormat (MainActivity.OUT_*, or
+    // OUT_GREY8). The worker pool converts whole frames in parallel. Returns the number of frames converted (0 on error)
+    jint Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeBatch( JNIEnv* env, jobject thiz,
+                                                                               jobject frames, jint count, jint format, jint stride,
+                                                                               jobject result, jint outFormat,
+                                                                               jint width, jint height)
+    {
+        jlong const frameBytes = yuvBufferSize(format, width, height, stride);
+        unsigned char *cFrames = (*env)->GetDirectBufferAddress(env,frames);
+        void *cResult = (*env)->GetDirectBufferAddress(env,result);
+
+        if (cFrames==NULL || cResult==NULL) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Not a direct buffer");
+            return 0;
+        }
+        if (frameBytes==0 || count <= 0 || !YUV_BATCH_VALID(outFormat) ||
+            (*env)->GetDirectBufferCapacity(env,frames) < frameBytes*count ||
+            (*env)->GetDirectBufferCapacity(env,result) < (jlong)YUV_BATCH_BYTES(outFormat)*width*height*count) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Batch of %d frames %d -> %d not valid for %dx%d (stride %d)", count, format, outFormat, width, height, stride);
+            return 0;
+        }
+        return convertYUV420BatchPacked(cFrames,cResult,count,format,width,height,stride,outFormat);
+    }
+
+    // Native function called from Java to convert, downscale and rotate a frame in one pass, straight into the
+    // outWidth x outHeight result shown on screen (replaces Support.downscaleAndRotateImage on the UI thread)
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeScaled( JNIEnv* env, jobject thiz,
+                                                                                   jbyteArray data,
+                                                                                   jintArray result,
+                                                                                   jint width, jint height,
+                                                                                   jint outWidth, jint outHeight, jint angle,
+                                                                                   jboolean bilinear, jboolean parallel)
+    {
+        unsigned char *cData;
+        int *cResult = NULL;
+        int done = 0;
+        int const filter = bilinear ? YUV_SCALE_BILINEAR : YUV_SCALE_NEAREST;
+        long long t = yuvProfStart();
+
+        if ((*env)->GetArrayLength(env,data) < width*height*3/2 || (*env)->GetArrayLength(env,result) < outWidth*outHeight) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Arrays too small for %dx%d -> %dx%d", width, height, outWidth, outHeight);
+            return JNI_FALSE;
+        }
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            cResult = (*env)->GetPrimitiveArrayCritical(env,result,NULL);
+            if (cResult!=NULL) {
+                yuvProfLap(&t, YUV_STAGE_JNI_IN);
+                done = parallel ? convertYUV420_NV21toRGB8888ScaledPool(cData,width,height,cResult,outWidth,outHeight,angle,filter)
+                                : convertYUV420_NV21toRGB8888Scaled(cData,width,height,cResult,outWidth,outHeight,angle,filter);
+                yuvProfLap(&t, YUV_STAGE_CONVERT);
+            }
+        }
+        if (cResult!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Native function called from Java to size the frame arena (framearena.h) for width x height frames of format
+    // (MainActivity.YUV_FORMAT_*) and outWidth x outHeight images of outFormat (MainActivity.OUT_*). Called when the
+    // preview starts, not per frame: the buffers returned by arenaBuffer before are not valid anymore
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_arenaConfigure( JNIEnv* env, jobject thiz,
+                                                                             jint format, jint width, jint height,
+                                                                             jint outFormat, jint outWidth, jint outHeight)
+    {
+        if (!frameArenaConfigure(format,width,height,outFormat,outWidth,outHeight)) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't configure the arena for %dx%d -> %dx%d", width, height, outWidth, outHeight);
+            return JNI_FALSE;
+        }
+        return JNI_TRUE;
+    }
+
+    // Native function called from Java to get a buffer of the arena (MainActivity.ARENA_*) as a direct ByteBuffer
+    // over the native memory (no copy), or null if the arena is not configured
+    jobject Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_arenaBuffer( JNIEnv* env, jobject thiz, jint buffer)
+    {
+        size_t size;
+        void *p = frameArenaBuffer(buffer, &size);
+
+        if (p==NULL) return NULL;
+        return (*env)->NewDirectByteBuffer(env,p,(jlong)size);
+    }
+
+    // Native function called from Java to free the arena (the ByteBuffers of arenaBuffer must not be used anymore)
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_arenaRelease( JNIEnv* env, jobject thiz)
+    {
+        frameArenaRelease();
+    }
+
+    // Native function called from Java to convert, downscale and rotate a frame in one pass (as YUVtoRGBNativeScaled)
+    // into the output buffer of the arena, sized by arenaConfigure: NV21 frames, any output format (stored by the
+    // conversion itself). Nothing is allocated per frame; the result is copied to the Bitmap with copyPixelsFromBuffer
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_YUVtoRGBNativeScaledArena( JNIEnv* env, jobject thiz,
+                                                                                        jbyteArray data, jint angle,
+                                                                                        jboolean bilinear, jboolean parallel)
+    {
+        unsigned char *cData;
+        void *cResult;
+        int format, width, height, outFormat, outWidth, outHeight;
+        int done = 0;
+        int const filter = bilinear ? YUV_SCALE_BILINEAR : YUV_SCALE_NEAREST;
+        long long t = yuvProfStart();
+
+        if (!frameArenaGetConfig(&format,&width,&height,&outFormat,&outWidth,&outHeight) || format != YUV_FORMAT_NV21 ||
+            (cResult = frameArenaBuffer(FRAME_ARENA_OUTPUT, NULL)) == NULL) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "The arena is not configured for NV21 frames");
+            return JNI_FALSE;
+        }
+        if ((*env)->GetArrayLength(env,data) < width*height*3/2) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Array too small for %dx%d", width, height);
+            return JNI_FALSE;
+        }
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            yuvProfLap(&t, YUV_STAGE_JNI_IN);
+            done = parallel ? convertYUV420_NV21toFormatScaledPool(cData,width,height,cResult,outFormat,outWidth,outHeight,angle,filter)
+                            : convertYUV420_NV21toFormatScaled(cData,width,height,cResult,outFormat,outWidth,outHeight,angle,filter);
+            yuvProfLap(&t, YUV_STAGE_CONVERT);
+            (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        }
+        yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Native function called from Java to filter the luma plane of a frame (yuvfilter.h) into a GREY8888 image:
+    // filter is one of MainActivity.FILTER_* (= YUV_FILTER_*), kernel (ksize*ksize coefficients) and shift are
+    // only used by the generic 3x3 / 5x5 filters, threshold < 0 disables the thresholding.
+    // The arrays are pinned (no copies). Returns false if the arguments are not valid
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_FilterLumaNative( JNIEnv* env, jobject thiz,
+                                                                               jbyteArray data,
+                                                                               jintArray result,
+                                                                               jint width, jint height, jint filter,
+                                                                               jshortArray kernel, jint shift, jint threshold,
+                                                                               jboolean parallel)
+    {
+        unsigned char *cData = NULL;
+        int *cResult = NULL;
+        jshort *cKernel = NULL;
+        int done = 0;
+        int const ksize = filter == YUV_FILTER_CONV5 ? 5 : 3;
+
+        if ((*env)->GetArrayLength(env,data) < width*height || (*env)->GetArrayLength(env,result) < width*height) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Arrays too small for %dx%d", width, height);
+            return JNI_FALSE;
+        }
+        if (filter == YUV_FILTER_CONV3 || filter == YUV_FILTER_CONV5) {
+            if (kernel == NULL || (*env)->GetArrayLength(env,kernel) < ksize*ksize) {
+                __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "The kernel needs %d coefficients", ksize*ksize);
+                return JNI_FALSE;
+            }
+            cKernel = (*env)->GetShortArrayElements(env,kernel,NULL);     // no JNI calls inside the critical region
+            if (cKernel==NULL) return JNI_FALSE;
+        }
+        cData = (*env)->GetPrimitiveArrayCritical(env,data,NULL);
+        if (cData==NULL) __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't get data array reference");
+        else
+        {
+            cResult = (*env)->GetPrimitiveArrayCritical(env,result,NULL);
+            if (cResult!=NULL)
+                done = parallel ? filterLumaPool(cData,width,height,filter,cKernel,shift,threshold,cResult,YUV_FILTER_GREY8888)
+                                : filterLuma(cData,width,height,filter,cKernel,shift,threshold,cResult,YUV_FILTER_GREY8888);
+        }
+        if (cResult!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,result,cResult,0);
+        if (cData!=NULL) (*env)->ReleasePrimitiveArrayCritical(env,data,cData,JNI_ABORT);
+        if (cKernel!=NULL) (*env)->ReleaseShortArrayElements(env,kernel,cKernel,JNI_ABORT);
+        return done ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // Conversion run by the converter thread of the frame pipeline: full-size RGBA with a backend,
+    // or fused convert + downscale + rotate into the canvas size when outWidth > 0
+    typedef struct ringConfig {
+        int backend;
+        int width, height;
+        int outWidth, outHeight, angle;
+    } ringConfig;
+
+    static ringConfig ringCfg;
+
+    static void ringConvert(void *arg, const unsigned char * nv21, int width, int height, int * out)
+    {
+        ringConfig const *cfg = arg;
+        long long t = yuvProfStart();
+
+        if (cfg->outWidth > 0)
+            convertYUV420_NV21toRGB8888ScaledPool(nv21,width,height,out,cfg->outWidth,cfg->outHeight,cfg->angle,YUV_SCALE_BILINEAR);
+        else
+            convertWithBackend(cfg->backend,nv21,out,width,height,workerPoolSize());
+        yuvProfLap(&t, YUV_STAGE_CONVERT);
+    }
+
+    // Native function called from Java to start the frame pipeline (framering.h) with depth slots for width x height
+    // NV21 frames. Each frame is converted with backend, or straight into outWidth x outHeight (rotated by angle) if outWidth > 0
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_frameRingStart( JNIEnv* env, jobject thiz,
+                                                                             jint depth, jint width, jint height,
+                                                                             jint outWidth, jint outHeight, jint angle,
+                                                                             jint backend)
+    {
+        int const outSize = outWidth > 0 ? outWidth*outHeight : width*height;
+
+        if (frameRingRunning())
+            return JNI_FALSE;
+        ringCfg.backend = backend;
+        ringCfg.width = width;
+        ringCfg.height = height;
+        ringCfg.outWidth = outWidth > 0 ? outWidth : 0;
+        ringCfg.outHeight = outHeight;
+        ringCfg.angle = angle;
+        if (!frameRingStart(depth,width,height,outSize,ringConvert,&ringCfg)) {
+            __android_log_print(ANDROID_LOG_INFO, "HOOKnative", "Can't start the frame ring (depth %d, %dx%d)", depth, width, height);
+            return JNI_FALSE;
+        }
+        return JNI_TRUE;
+    }
+
+    // Native function called from Java (camera thread) to copy a frame into the pipeline; the caller can give the
+    // buffer back to the camera at once. Returns false if the frame was dropped (every slot in flight)
+    jboolean Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_frameRingPush( JNIEnv* env, jobject thiz, jbyteArray data)
+    {
+        int const frameBytes = ringCfg.width*ringCfg.height*3/2;
+        unsigned char *slot;
+
+        if ((*env)->GetArrayLength(env,data) < frameBytes)
+            return JNI_FALSE;
+        slot = frameRingProduce();
+        if (slot==NULL)
+            return JNI_FALSE;
+        (*env)->GetByteArrayRegion(env,data,0,frameBytes,(jbyte *)slot);   // one copy, straight into the slot
+        frameRingQueue();
+        return JNI_TRUE;
+    }
+
+    // Native function called from Java (display thread) to wait up to timeoutMs for the newest converted frame and
+    // copy it into result. Returns its sequence number, or -1 on timeout
+    jlong Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_frameRingTake( JNIEnv* env, jobject thiz,
+                                                                         jintArray result, jint timeoutMs)
+    {
+        int const outSize = ringCfg.outWidth > 0 ? ringCfg.outWidth*ringCfg.outHeight : ringCfg.width*ringCfg.height;
+        const int *out;
+        long long seq;
+
+        if ((*env)->GetArrayLength(env,result) < outSize)
+            return -1;
+        out = frameRingAcquire(timeoutMs,&seq);
+        if (out==NULL)
+            return -1;
+        (*env)->SetIntArrayRegion(env,result,0,outSize,(const jint *)out);
+        frameRingRelease();     // the slot goes back to the camera thread
+        return seq;
+    }
+
+    // Native function called from Java to stop the frame pipeline, once the camera and the display thread have stopped
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_frameRingStop( JNIEnv* env, jobject thiz)
+    {
+        frameRingStop();
+    }
+
+    // Native function called from Java to read the counters of the last pipeline run:
+    // {queued, overruns, dropped, converted, displayed}
+    jlongArray Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_getFrameRingStats( JNIEnv* env, jobject thiz)
+    {
+        frameRingStats stats;
+        jlong values[5];
+        jlongArray result = (*env)->NewLongArray(env,5);
+
+        if (result==NULL)
+            return NULL;
+        frameRingGetStats(&stats);
+        values[0] = stats.queued;
+        values[1] = stats.overruns;
+        values[2] = stats.dropped;
+        values[3] = stats.converted;
+        values[4] = stats.acquired;
+        (*env)->SetLongArrayRegion(env,result,0,5,values);
+        return result;
+    }
+
+    // Native function called from Java to switch the stage profiler (yuvprofile.h) on or off
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_profileEnable( JNIEnv* env, jobject thiz, jboolean on)
+    {
+        yuvProfEnable(on);
+    }
+
+    // Native function called from Java to clear the stage histograms and the worker counters
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_profileReset( JNIEnv* env, jobject thiz)
+    {
+        yuvProfReset();
+    }
+
+    // Native function called from Java to record ns nanoseconds of a stage timed in Java (MainActivity.STAGE_*)
+    void Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_profileRecord( JNIEnv* env, jobject thiz, jint stage, jlong ns)
+    {
+        yuvProfRecord(stage, ns);
+    }
+
+    // Native function called from Java to read the profiler, in ns: {count, mean, p50, p99, max} of each stage,
+    // then {busy, idle, tasks} of each worker of each runtime (pool, pthread, OpenMP): see MainActivity.PROFILE_*
+    jlongArray Java_es_uma_muii_apdm_ImageProcessingNative_MainActivity_getProfileSnapshot( JNIEnv* env, jobject thiz)
+    {
+        int const size = YUV_STAGE_COUNT*5 + YUV_PROF_RUNTIMES*YUV_PROF_WORKERS*3;
+        jlong values[YUV_STAGE_COUNT*5 + YUV_PROF_RUNTIMES*YUV_PROF_WORKERS*3];
+        yuvStageStats stage;
+        yuvWorkerStats workers[YUV_PROF_WORKERS];
+        jlongArray result = (*env)->NewLongArray(env,size);
+        int i, k = 0;
+
+        if (result==NULL)
+            return NULL;
+        for (i=0; i < YUV_STAGE_COUNT; i++) {
+            yuvProfStage(i, &stage);
+            values[k++] = stage.count;
+            values[k++] = stage.mean;
+            values[k++] = stage.p50;
+            values[k++] = stage.p99;
+            values[k++] = stage.max;
+        }
+        for (i=0; i < YUV_PROF_RUNTIMES*YUV_PROF_WORKERS; i++) {
+            if (i%YUV_PROF_WORKERS == 0)
+                yuvProfWorkers(i/YUV_PROF_WORKERS, workers, YUV_PROF_WORKERS);
+            values[k++] = workers[i%YUV_PROF_WORKERS].busy;
+            values[k++] = workers[i%YUV_PROF_WORKERS].idle;
+            values[k++] = workers[i%YUV_PROF_WORKERS].tasks;
+        }
+        (*env)->SetLongArrayRegion(env,result,0,size,values);
+        return result;
+    }
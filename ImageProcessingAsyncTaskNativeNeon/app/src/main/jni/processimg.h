@@ -0,0 +1,14 @@
+//
+// Helpers shared by the JNI glue (processimg.c, processimg_neon.c)
+//
+
+#ifndef PROCESSIMG_H
+#define PROCESSIMG_H
+
+#include <jni.h>
+
+// Accounts the bytes the VM copied for Get<Type>ArrayElements / Release<Type>ArrayElements
+// (only when isCopy is true). Java reads the total with getJNICopiedBytes().
+void jniCountCopy(jboolean isCopy, jlong bytes);
+
+#endif
@@ -0,0 +1,429 @@
+//
+// Persistent pool of native worker threads (see workerpool.h)
+//
+
+#define _GNU_SOURCE             // sched_setaffinity, cpu_set_t
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "workerpool.h"
+#include "yuvprofile.h"
+
+typedef struct workerPool {
+    pthread_t th[MAX_POOL_THREADS];
+    int nworkers;                // number of worker threads created (the caller is not included)
+    int running;                 // 1 while the worker threads are alive
+    int quit;                    // set to ask the workers to finish
+    unsigned int generation;     // incremented every time a job is posted
+    workerPoolTask task;         // current job
+    void *arg;
+    int nbands;
+    int nextBand;                // next band of the current job to be claimed
+    int pendingBands;            // bands of the current job not finished yet
+    unsigned int affinityGen;    // incremented by workerPoolSetAffinity
+#ifdef __linux__
+    cpu_set_t affinity;          // CPUs of the worker threads
+#endif
+} workerPool;
+
+typedef struct rangeJob {        // a job of workerPoolRunRange: one driver band per thread claims its items
+    workerPoolRangeTask task;
+    void *arg;
+    int nitems;
+    int minChunk;
+    int chunk;                   // WORKER_SCHED_CHUNKS
+    int sched;
+    int nthreads;
+    unsigned int *speeds;        // speed model of the task (NULL: none)
+    unsigned int callerSpeed;    // share of the caller: the mean speed of the workers
+    unsigned long long totalSpeed;  // sum of the speeds of the threads of the job (0: not measured yet)
+    int next;                    // first item not claimed yet (atomic)
+} rangeJob;
+
+#define MAX_SPEED_TASKS 16       // range tasks with a speed model; the others get equal shares
+
+typedef struct taskSpeeds {      // speed model of one range task, so that the items always are of the same kind
+    workerPoolRangeTask task;
+    unsigned int speeds[MAX_POOL_THREADS];  // items/s of each worker (moving average), written by that worker only
+} taskSpeeds;
+
+static workerPool pool;
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;   // protects the pool fields
+static pthread_mutex_t runLock = PTHREAD_MUTEX_INITIALIZER;    // serializes jobs, init and shutdown
+static pthread_cond_t jobPosted = PTHREAD_COND_INITIALIZER;    // a new job (or quit) is available
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;      // the last band of the job is finished
+static __thread int workerId;           // 1..nworkers in the worker threads, 0 in the callers (yuvProfBusy)
+static int schedule = WORKER_SCHED_ADAPTIVE;
+static taskSpeeds speedTable[MAX_SPEED_TASKS];
+static int nspeedTasks;
+static pthread_mutex_t speedLock = PTHREAD_MUTEX_INITIALIZER;   // protects the keys of speedTable
+
+#define CHUNKS_PER_THREAD 8     // WORKER_SCHED_CHUNKS: chunks of nitems/(threads*CHUNKS_PER_THREAD) items
+
+// Claim and process bands of the current job until none is left. Called with poolLock held.
+static void workerPoolDrain(void)
+{
+    while (pool.nextBand < pool.nbands) {
+        int band = pool.nextBand++;
+        workerPoolTask task = pool.task;
+        void *arg = pool.arg;
+        int nbands = pool.nbands;
+        long long t0;
+
+        pthread_mutex_unlock(&poolLock);
+        t0 = yuvProfStart();
+        task(arg, band, nbands);
+        yuvProfBusy(YUV_PROF_POOL, workerId, t0);
+        pthread_mutex_lock(&poolLock);
+        if (--pool.pendingBands == 0)
+            pthread_cond_signal(&jobDone);
+    }
+}
+
+static void *workerPoolLoop(void *args)
+{
+    unsigned int seen;      // generation of the last job this worker has seen
+    unsigned int pinned = 0;    // affinityGen applied to this thread
+
+    workerId = (int)(long)args;
+    // a job posted before this thread gets here is simply drained by the others
+    pthread_mutex_lock(&poolLock);
+    seen = pool.generation;
+    for (;;) {
+        while (!pool.quit && pool.generation == seen)
+            pthread_cond_wait(&jobPosted, &poolLock);
+        if (pool.quit)
+            break;
+        seen = pool.generation;
+#ifdef __linux__
+        if (pinned != pool.affinityGen) {
+            pinned = pool.affinityGen;
+            sched_setaffinity(0, sizeof(pool.affinity), &pool.affinity);     // 0: this thread
+        }
+#endif
+        workerPoolDrain();
+    }
+    pthread_mutex_unlock(&poolLock);
+    return NULL;
+}
+
+static void workerPoolStop(void)
+{
+    int i;
+
+    if (!pool.running)
+        return;
+    pthread_mutex_lock(&poolLock);
+    pool.quit = 1;
+    pthread_cond_broadcast(&jobPosted);
+    pthread_mutex_unlock(&poolLock);
+    for (i=0; i < pool.nworkers; i++)
+        pthread_join(pool.th[i], NULL);
+    pool.nworkers = 0;
+    pool.running = 0;
+    pool.quit = 0;
+}
+
+int workerPoolInit(int nthr)
+{
+    int i;
+
+    if (nthr <= 0)
+        nthr = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthr < 1)
+        nthr = 1;
+    if (nthr > MAX_POOL_THREADS)
+        nthr = MAX_POOL_THREADS;
+
+    pthread_mutex_lock(&runLock);
+    if (pool.running && pool.nworkers == nthr-1) {
+        pthread_mutex_unlock(&runLock);
+        return nthr;
+    }
+    workerPoolStop();
+    for (i=0; i < nthr-1; i++) {
+        if (pthread_create(&(pool.th[i]), NULL, workerPoolLoop, (void *)(long)(i+1)) != 0)
+            break;
+        pool.nworkers++;
+    }
+    pool.running = 1;
+    pthread_mutex_unlock(&runLock);
+    return pool.nworkers+1;
+}
+
+void workerPoolShutdown(void)
+{
+    pthread_mutex_lock(&runLock);
+    workerPoolStop();
+    pthread_mutex_unlock(&runLock);
+}
+
+int workerPoolSize(void)
+{
+    return pool.running ? pool.nworkers+1 : 1;
+}
+
+void workerPoolRun(workerPoolTask task, void *arg, int nbands)
+{
+    int band;
+    long long t0;
+
+    if (nbands <= 0)
+        return;
+    pthread_mutex_lock(&runLock);
+    t0 = yuvProfStart();
+    if (!pool.running || pool.nworkers == 0) {
+        for (band=0; band < nbands; band++) {
+            long long t1 = yuvProfStart();
+
+            task(arg, band, nbands);
+            yuvProfBusy(YUV_PROF_POOL, 0, t1);
+        }
+        yuvProfJob(YUV_PROF_POOL, t0);
+        pthread_mutex_unlock(&runLock);
+        return;
+    }
+    pthread_mutex_lock(&poolLock);
+    pool.task = task;
+    pool.arg = arg;
+    pool.nbands = nbands;
+    pool.nextBand = 0;
+    pool.pendingBands = nbands;
+    pool.generation++;
+    pthread_cond_broadcast(&jobPosted);
+    workerPoolDrain();                 // the caller works too instead of just waiting
+    while (pool.pendingBands > 0)      // barrier: wait for the bands still running on the workers
+        pthread_cond_wait(&jobDone, &poolLock);
+    pthread_mutex_unlock(&poolLock);
+    yuvProfJob(YUV_PROF_POOL, t0);
+    pthread_mutex_unlock(&runLock);
+}
+
+static long long nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+// Speeds of the workers on task (slot 0, the callers, is not used); NULL if the table is full
+static unsigned int *speedsOf(workerPoolRangeTask task)
+{
+    unsigned int *s = NULL;
+    int i;
+
+    pthread_mutex_lock(&speedLock);
+    for (i=0; i < nspeedTasks && speedTable[i].task != task; i++)
+        ;
+    if (i == nspeedTasks && i < MAX_SPEED_TASKS) {
+        speedTable[i].task = task;
+        nspeedTasks++;
+    }
+    if (i < nspeedTasks)
+        s = speedTable[i].speeds;
+    pthread_mutex_unlock(&speedLock);
+    return s;
+}
+
+// Items of the next chunk of this thread when left items are not claimed yet
+static int chunkSize(const rangeJob *j, int left)
+{
+    long long c;
+
+    if (j->sched == WORKER_SCHED_CHUNKS)
+        c = j->chunk;
+    else if (j->totalSpeed > 0) {
+        unsigned int const speed = workerId > 0 ? __atomic_load_n(&j->speeds[workerId], __ATOMIC_RELAXED) : j->callerSpeed;
+
+        c = (long long)((unsigned long long)left*speed/j->totalSpeed/2);   // half of this thread's share of what is left
+    } else
+        c = left/j->nthreads/2;
+    return c < j->minChunk ? j->minChunk : (int)c;
+}
+
+// Moving average of the items/s of this worker on the task of the job. The callers are not measured: any thread
+// can post a job, on any core, so one slot would mix them
+static void updateSpeed(const rangeJob *j, int items, long long ns)
+{
+    unsigned int old;
+    long long rate = ns > 0 ? items*1000000000LL/ns : 0;
+
+    if (!j->speeds || workerId == 0 || rate <= 0)
+        return;
+    if (rate > 0x3fffffff)
+        rate = 0x3fffffff;
+    old = __atomic_load_n(&j->speeds[workerId], __ATOMIC_RELAXED);
+    __atomic_store_n(&j->speeds[workerId], old ? (3*old + (unsigned int)rate)/4 : (unsigned int)rate, __ATOMIC_RELAXED);
+}
+
+// Driver band of workerPoolRunRange: the static range of the band, or chunks claimed until none is left
+static void rangeBand(void *args, int band, int nbands)
+{
+    rangeJob *j = (rangeJob *)args;
+
+    if (j->sched == WORKER_SCHED_STATIC) {
+        int const item0 = (int)((long long)j->nitems*band/nbands);
+        int const item1 = (int)((long long)j->nitems*(band+1)/nbands);
+
+        if (item1 > item0)
+            j->task(j->arg, item0, item1);
+        return;
+    }
+    for (;;) {
+        int item0 = __atomic_load_n(&j->next, __ATOMIC_RELAXED);
+        int n;
+        long long t0;
+
+        if (item0 >= j->nitems)
+            break;
+        n = chunkSize(j, j->nitems - item0);
+        if (n > j->nitems - item0)
+            n = j->nitems - item0;
+        if (!__atomic_compare_exchange_n(&j->next, &item0, item0+n, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            continue;       // another thread claimed these items first
+        t0 = j->sched == WORKER_SCHED_ADAPTIVE ? nowNs() : 0;
+        j->task(j->arg, item0, item0+n);
+        if (t0)
+            updateSpeed(j, n, nowNs() - t0);
+    }
+}
+
+void workerPoolRunRange(workerPoolRangeTask task, void *arg, int nitems, int minChunk)
+{
+    rangeJob j;
+    int i;
+
+    if (nitems <= 0)
+        return;
+    j.task = task;
+    j.arg = arg;
+    j.nitems = nitems;
+    j.minChunk = minChunk > 0 ? minChunk : 1;
+    j.sched = __atomic_load_n(&schedule, __ATOMIC_RELAXED);
+    j.nthreads = workerPoolSize();
+    j.chunk = nitems/(j.nthreads*CHUNKS_PER_THREAD);
+    j.speeds = j.sched == WORKER_SCHED_ADAPTIVE ? speedsOf(task) : NULL;
+    j.callerSpeed = 0;
+    j.totalSpeed = 0;
+    j.next = 0;
+    for (i=1; j.speeds && i < j.nthreads; i++) {
+        unsigned int const speed = __atomic_load_n(&j.speeds[i], __ATOMIC_RELAXED);
+
+        if (speed == 0) {           // a worker not measured yet: equal shares until all of them are
+            j.totalSpeed = 0;
+            break;
+        }
+        j.totalSpeed += speed;
+    }
+    if (j.totalSpeed > 0) {
+        j.callerSpeed = (unsigned int)(j.totalSpeed/(j.nthreads-1));
+        j.totalSpeed += j.callerSpeed;
+    }
+    workerPoolRun(rangeBand, (void *)&j, j.nthreads);
+}
+
+int workerPoolWorkerId(void)
+{
+    return workerId;
+}
+
+void workerPoolSetSchedule(int sched)
+{
+    if (sched >= WORKER_SCHED_STATIC && sched <= WORKER_SCHED_ADAPTIVE)
+        __atomic_store_n(&schedule, sched, __ATOMIC_RELAXED);
+}
+
+int workerPoolGetSchedule(void)
+{
+    return __atomic_load_n(&schedule, __ATOMIC_RELAXED);
+}
+
+#ifdef __linux__
+// Relative capacity of a CPU: cpu_capacity (energy model, 1024 for the biggest core) or the maximum frequency
+static long cpuCapacity(int cpu, int freq)
+{
+    char path[96];
+    FILE *f;
+    long value = 0;
+
+    snprintf(path, sizeof(path), freq ? "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq"
+                                      : "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+    f = fopen(path, "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "%ld", &value) != 1)
+        value = 0;
+    fclose(f);
+    return value;
+}
+
+// CPUs of the fastest cluster in set; returns how many, 0 if all the cores are the same or unknown
+static int bigCoreSet(cpu_set_t *set)
+{
+    int const ncpu = (int)sysconf(_SC_NPROCESSORS_CONF);
+    long best = 0, worst = 0;
+    int freq, cpu, n = 0;
+
+    CPU_ZERO(set);
+    for (freq=0; freq < 2 && best == 0; freq++) {
+        worst = 0;
+        for (cpu=0; cpu < ncpu && cpu < CPU_SETSIZE; cpu++) {
+            long const c = cpuCapacity(cpu, freq);
+
+            if (c > best)
+                best = c;
+            if (c > 0 && (worst == 0 || c < worst))
+                worst = c;
+        }
+        if (best == worst)          // unknown, or a homogeneous CPU
+            best = 0;
+    }
+    if (best == 0)
+        return 0;
+    for (cpu=0; cpu < ncpu && cpu < CPU_SETSIZE; cpu++)
+        if (cpuCapacity(cpu, freq-1) == best) {
+            CPU_SET(cpu, set);
+            n++;
+        }
+    return n;
+}
+#endif
+
+int workerPoolBigCores(void)
+{
+#ifdef __linux__
+    cpu_set_t set;
+
+    return bigCoreSet(&set);
+#else
+    return 0;
+#endif
+}
+
+int workerPoolSetAffinity(int bigOnly)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    int n = bigOnly ? bigCoreSet(&set) : 0;
+    int cpu;
+
+    if (n == 0) {                   // any core
+        int const ncpu = (int)sysconf(_SC_NPROCESSORS_CONF);
+
+        CPU_ZERO(&set);
+        for (cpu=0; cpu < ncpu && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &set);
+        n = ncpu;
+    }
+    pthread_mutex_lock(&poolLock);
+    pool.affinity = set;
+    pool.affinityGen++;
+    pthread_mutex_unlock(&poolLock);
+    return n;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,57 @@
+//
+// Persistent pool of native worker threads.
+// The pool is created once (workerPoolInit) and reused for every frame: a frame is handed
+// to it as a set of independent bands that the workers (and the calling thread) process.
+//
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#define MAX_POOL_THREADS 16
+
+// Function that processes band number "band" out of "nbands" bands of a job
+typedef void (*workerPoolTask)(void *arg, int band, int nbands);
+
+// Start the pool with nthr threads in total (the caller counts as one of them).
+// nthr<=0 uses the number of online cores. Calling it again with the same size does nothing.
+int workerPoolInit(int nthr);
+
+// Stop and join all the worker threads. Jobs submitted afterwards run on the calling thread.
+void workerPoolShutdown(void);
+
+// Number of threads (including the caller) that cooperate in a job; 1 if the pool is not running
+int workerPoolSize(void);
+
+// Run task(arg, band, nbands) for every band in [0, nbands) and wait until all of them are done
+void workerPoolRun(workerPoolTask task, void *arg, int nbands);
+
+// Function that processes the items [item0, item1) of a job (row pairs, rows...)
+typedef void (*workerPoolRangeTask)(void *arg, int item0, int item1);
+
+// Scheduling of the items of workerPoolRunRange
+#define WORKER_SCHED_STATIC   0     // one equal range per thread: the slowest core sets the time of the job
+#define WORKER_SCHED_CHUNKS   1     // fixed chunks claimed from an atomic counter by the threads that are free
+#define WORKER_SCHED_ADAPTIVE 2     // chunks claimed from an atomic counter, sized by the measured speed of each
+                                    // worker thread on that task (items/s, moving average) and shrinking with the
+                                    // work left (default). The caller is not measured: it takes the mean share
+
+// Run task over [0, nitems) in chunks of at least minChunk items and wait until all of them are done.
+// On big.LITTLE CPUs the big cores claim more chunks (and bigger ones with WORKER_SCHED_ADAPTIVE) than the LITTLE ones
+void workerPoolRunRange(workerPoolRangeTask task, void *arg, int nitems, int minChunk);
+
+// Index of the calling thread: 1..workerPoolSize()-1 in the workers, 0 in any other thread (the caller of a job).
+// Jobs run one at a time, so a task can keep per-thread data in workerPoolSize() slots
+int workerPoolWorkerId(void);
+
+void workerPoolSetSchedule(int sched);
+int workerPoolGetSchedule(void);
+
+// Number of CPUs of the fastest cluster (highest cpu_capacity or cpuinfo_max_freq in sysfs),
+// 0 if all the cores are the same or it can't be known
+int workerPoolBigCores(void);
+
+// Pin the worker threads (not the callers) to the fastest cluster (bigOnly) or let them run on any core.
+// Applied by every worker before its next job. Returns the number of CPUs they can run on, 0 if not supported
+int workerPoolSetAffinity(int bigOnly);
+
+#endif
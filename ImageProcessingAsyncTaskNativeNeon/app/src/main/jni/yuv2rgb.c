@@ -0,0 +1,86 @@
+//
+// Coefficient table of the fixed-point YUV -> RGB conversion (see yuv2rgb.h)
+//
+
+#include <pthread.h>
+#include "yuv2rgb.h"
+
+// [matrix][range], coefficients scaled by 256 and rounded
+static const yuvCoefs coefTable[2][2] = {
+    {   // BT.601
+        { 298, 16, 409, -100, -208, 516 },      // limited range (the classic 298/409/100/208/516 integer math)
+        { 256,  0, 359,  -88, -183, 454 }       // full range
+    },
+    {   // BT.709
+        { 298, 16, 459,  -55, -136, 541 },      // limited range
+        { 256,  0, 403,  -48, -120, 475 }       // full range
+    }
+};
+
+static const yuvCoefs *currentCoefs = &coefTable[YUV_BT601][YUV_LIMITED_RANGE];
+
+// grey level of every Y value, for each entry of the table (built once)
+static unsigned char greyTable[4][256];
+static pthread_once_t greyOnce = PTHREAD_ONCE_INIT;
+
+static void buildGreyTables(void)
+{
+    const yuvChroma none = { 128, 128, 128 };      // U = V = 0: only the rounding constant
+    int t, y;
+
+    for (t=0; t < 4; t++)
+        for (y=0; y < 256; y++)
+            greyTable[t][y] = (unsigned char)(yuvPixel(&coefTable[t>>1][t&1], y, &none) & 0xff);
+}
+
+// conversion tables of every entry of the table and the clamp table (built once)
+static yuvLUT lutTable[4];
+static unsigned char clampTable[1024];
+static pthread_once_t lutOnce = PTHREAD_ONCE_INIT;
+
+static void buildLUTs(void)
+{
+    int t, i;
+
+    for (i=0; i < 1024; i++)
+        clampTable[i] = (unsigned char)yuvClamp255(i + YUV_CLAMP_LUT_MIN);
+    for (t=0; t < 4; t++) {
+        const yuvCoefs *c = &coefTable[t>>1][t&1];
+        yuvLUT *l = &lutTable[t];
+
+        for (i=0; i < 256; i++) {
+            l->y[i] = (i > c->yoff ? i - c->yoff : 0)*c->ycoef;
+            l->rv[i] = 128 + c->rv*(i-128);
+            l->gu[i] = c->gu*(i-128);
+            l->gv[i] = 128 + c->gv*(i-128);
+            l->bu[i] = 128 + c->bu*(i-128);
+        }
+        l->clamp = clampTable - YUV_CLAMP_LUT_MIN;
+    }
+}
+
+void yuvSetColorSpace(int matrix, int range)
+{
+    if (matrix != YUV_BT709)
+        matrix = YUV_BT601;
+    if (range != YUV_FULL_RANGE)
+        range = YUV_LIMITED_RANGE;
+    currentCoefs = &coefTable[matrix][range];
+}
+
+const yuvCoefs *yuvGetCoefs(void)
+{
+    return currentCoefs;
+}
+
+const unsigned char *yuvGetGreyLUT(void)
+{
+    pthread_once(&greyOnce, buildGreyTables);
+    return greyTable[currentCoefs - &coefTable[0][0]];
+}
+
+const yuvLUT *yuvGetLUT(void)
+{
+    pthread_once(&lutOnce, buildLUTs);
+    return &lutTable[currentCoefs - &coefTable[0][0]];
+}
@@ -0,0 +1,118 @@
+//
+// Fixed-point YUV -> RGB reference shared by every native backend (scalar, pthread, OMP and NEON).
+//
+// For each pixel (u and v already centered, i.e. minus 128):
+//   Y' = max(Y - yoff, 0)
+//   R = [128 + ycoef*Y' + rv*V] >> 8
+//   G = [128 + ycoef*Y' + gu*U + gv*V] >> 8
+//   B = [128 + ycoef*Y' + bu*U] >> 8
+// saturated to [0,255]. This is exactly what the NEON kernel computes with vqsub/vmlal/vqmovun/vshrn,
+// so all the backends produce bit-identical images.
+//
+
+#ifndef YUV2RGB_H
+#define YUV2RGB_H
+
+// Colour matrices
+#define YUV_BT601 0
+#define YUV_BT709 1
+
+// Ranges
+#define YUV_LIMITED_RANGE 0     // Y in [16,235], UV in [16,240] (camera preview frames)
+#define YUV_FULL_RANGE 1        // Y, U and V in [0,255] (JPEG)
+
+typedef struct yuvCoefs {   // coefficients scaled by 256
+    int ycoef;
+    int yoff;
+    int rv;
+    int gu;
+    int gv;
+    int bu;
+} yuvCoefs;
+
+// Select the matrix and range used by all the backends (BT.601 limited range by default)
+void yuvSetColorSpace(int matrix, int range);
+
+// Coefficients currently selected
+const yuvCoefs *yuvGetCoefs(void);
+
+// Grey level of each Y value with the coefficients currently selected: [128 + ycoef*Y'] >> 8 saturated,
+// the same value the RGB conversion gives to R, G and B when U = V = 0
+const unsigned char *yuvGetGreyLUT(void);
+
+// Lookup tables of the conversion for the coefficients currently selected (built once for every matrix and range).
+// With them the chroma of a 2x2 block is three additions and each pixel one load and three clamp lookups:
+//   yuvPixelLUT(t, y, yuvChromaLUT(t, u, v)) == yuvPixel(c, y, yuvChromaOf(c, u-128, v-128))
+#define YUV_CLAMP_LUT_MIN (-384)    // clamp[] covers [YUV_CLAMP_LUT_MIN, YUV_CLAMP_LUT_MIN+1024), wider than any (yy+chroma)>>8
+
+typedef struct yuvLUT {
+    int y[256];                     // max(Y - yoff, 0)*ycoef
+    int rv[256];                    // 128 + rv*(V-128): the rounding constant is folded in r, g and b
+    int gu[256];                    // gu*(U-128)
+    int gv[256];                    // 128 + gv*(V-128)
+    int bu[256];                    // 128 + bu*(U-128)
+    const unsigned char *clamp;     // clamp[x] = x saturated to [0,255] (1 KB table shared by every colour space)
+} yuvLUT;
+
+const yuvLUT *yuvGetLUT(void);
+
+// Saturate x to [0,255] without branches
+static inline int yuvClamp255(int x)
+{
+    x &= ~(x >> 31);            // x<0 --> 0
+    x |= (255 - x) >> 31;       // x>255 --> all ones
+    return x & 0xff;
+}
+
+// Chroma contributions (including the rounding constant) shared by the four pixels of a 2x2 block
+typedef struct yuvChroma {
+    int r;
+    int g;
+    int b;
+} yuvChroma;
+
+static inline yuvChroma yuvChromaOf(const yuvCoefs *c, int u, int v)
+// u (Cb) and v (Cr) must be already centered (minus 128). In NV21 the first byte of a chroma pair is v
+{
+    yuvChroma ch;
+
+    ch.r = 128 + c->rv*v;
+    ch.g = 128 + c->gu*u + c->gv*v;
+    ch.b = 128 + c->bu*u;
+    return ch;
+}
+
+// return the ARGB8888 value 0xAARRGGBB (android.graphics.Color, Bitmap.setPixels) from Y and the chroma of its block.
+// In memory (little endian) its bytes are B G R A: YUV_OUT_BGRA8888
+static inline int yuvPixel(const yuvCoefs *c, int y, const yuvChroma *ch)
+{
+    int yy = y - c->yoff;
+
+    yy &= ~(yy >> 31);          // saturating subtraction, as vqsub_u8 does
+    yy *= c->ycoef;
+    return 0xff000000 | (yuvClamp255((yy + ch->r) >> 8) << 16)
+                      | (yuvClamp255((yy + ch->g) >> 8) << 8)
+                      | yuvClamp255((yy + ch->b) >> 8);
+}
+
+// Same with the lookup tables: u and v are the stored bytes (not centered)
+static inline yuvChroma yuvChromaLUT(const yuvLUT *t, int u, int v)
+{
+    yuvChroma ch;
+
+    ch.r = t->rv[v];
+    ch.g = t->gu[u] + t->gv[v];
+    ch.b = t->bu[u];
+    return ch;
+}
+
+static inline int yuvPixelLUT(const yuvLUT *t, int y, const yuvChroma *ch)
+{
+    int const yy = t->y[y];
+
+    return 0xff000000 | (t->clamp[(yy + ch->r) >> 8] << 16)
+                      | (t->clamp[(yy + ch->g) >> 8] << 8)
+                      | t->clamp[(yy + ch->b) >> 8];
+}
+
+#endif
@@ -0,0 +1,111 @@
+//
+// Batch conversion of frames (see yuvbatch.h)
+//
+
+#include "workerpool.h"
+#include "yuvconvert.h"
+#include "yuvbatch.h"
+
+typedef struct batchJob {      // operands shared by all the frames of a batch
+    const unsigned char * const * frames;   // NULL: packed, frame i at base + i*frameBytes
+    void * const * outs;
+    const unsigned char * base;
+    unsigned char * outBase;
+    int frameBytes;
+    int outBytes;
+    int format, width, height, stride;
+    int outFormat;
+} batchJob;
+
+static const unsigned char *frameAt(const batchJob *j, int i)
+{
+    return j->frames ? j->frames[i] : j->base + (long)i*j->frameBytes;
+}
+
+static void *outAt(const batchJob *j, int i)
+{
+    return j->outs ? j->outs[i] : (void *)(j->outBase + (long)i*j->outBytes);
+}
+
+// Grey of the Y plane (the first stride*height bytes of every format)
+static void greyFrame(const batchJob *j, const unsigned char * data, unsigned char * grey)
+{
+    int const stride = j->stride > 0 ? j->stride : j->width;
+    int r;
+
+    if (stride == j->width) {
+        convertYUV420_NV21toGREY8_SIMD(data, grey, j->width, j->height);    // the plane is one long row
+        return;
+    }
+    for (r=0; r < j->height; r++)
+        convertYUV420_NV21toGREY8_SIMD(data + r*stride, grey + r*j->width, j->width, 1);
+}
+
+// Worker pool task: frame number "frame" of the batch, with the sequential SIMD kernel
+static void batchFrame(void *args, int frame, int nframes)
+{
+    const batchJob *j = (const batchJob *)args;
+    yuvImage img;
+
+    if (j->outFormat == YUV_BATCH_GREY8)
+        greyFrame(j, frameAt(j, frame), outAt(j, frame));
+    else if (yuvImageFromBuffer(&img, frameAt(j, frame), j->format, j->width, j->height, j->stride))
+        convertYUV420toFormat_SIMD(&img, outAt(j, frame), j->outFormat);
+}
+
+static int runBatch(batchJob *j, int count)
+{
+    yuvImage img;
+    int i;
+
+    if (count <= 0 || !YUV_BATCH_VALID(j->outFormat) || !yuvBufferSize(j->format, j->width, j->height, j->stride))
+        return 0;
+    for (i=0; i < count; i++)
+        if (!frameAt(j, i) || !outAt(j, i))
+            return 0;
+    if (count >= workerPoolSize() || j->outFormat == YUV_BATCH_GREY8) {
+        workerPoolRun(batchFrame, (void *)j, count);       // one frame per task: the pool is woken once
+        return count;
+    }
+    for (i=0; i < count; i++) {                            // fewer frames than threads: bands of each frame
+        yuvImageFromBuffer(&img, frameAt(j, i), j->format, j->width, j->height, j->stride);
+        convertYUV420toFormat_SIMDParallel(&img, outAt(j, i), j->outFormat);
+    }
+    return count;
+}
+
+int convertYUV420Batch(const unsigned char * const * frames, void * const * outs, int count,
+                       int format, int width, int height, int stride, int outFormat)
+{
+    batchJob j = { 0 };
+
+    if (!frames || !outs)
+        return 0;
+    j.frames = frames;
+    j.outs = outs;
+    j.format = format;
+    j.width = width;
+    j.height = height;
+    j.stride = stride;
+    j.outFormat = outFormat;
+    return runBatch(&j, count);
+}
+
+int convertYUV420BatchPacked(const unsigned char * frames, void * out, int count,
+                             int format, int width, int height, int stride, int outFormat)
+{
+    batchJob j = { 0 };
+
+    if (!frames || !out)
+        return 0;
+    j.base = frames;
+    j.outBase = out;
+    j.frameBytes = yuvBufferSize(format, width, height, stride);
+    j.outBytes = width*height*YUV_BATCH_BYTES(outFormat);
+    j.format = format;
+    j.width = width;
+    j.height = height;
+    j.stride = stride;
+    j.outFormat = outFormat;
+    return runBatch(&j, count);
+}
@@ -0,0 +1,31 @@
+//
+// Batch conversion: many frames of the same size and layout converted in one call (recorded camera
+// streams, offline reprocessing). The worker pool is woken once per batch instead of once per frame and each
+// thread converts whole frames with the SIMD kernel, taking the next one when it is done (no bands, no barrier
+// per frame). A batch with fewer frames than pool threads is converted frame by frame in bands instead.
+//
+
+#ifndef YUVBATCH_H
+#define YUVBATCH_H
+
+#include "yuvplanes.h"
+
+// Output of the batch functions besides the YUV_OUT_* formats: one byte per pixel, the grey level of Y
+// (same values as convertYUV420_NV21toGREY8)
+#define YUV_BATCH_GREY8 4
+
+#define YUV_BATCH_BYTES(outFormat) ((outFormat) == YUV_BATCH_GREY8 ? 1 : YUV_OUT_BYTES(outFormat))
+#define YUV_BATCH_VALID(outFormat) ((outFormat) == YUV_BATCH_GREY8 || YUV_OUT_VALID(outFormat))
+
+// Convert count frames: frames[i], a packed buffer of one of the YUV_FORMAT_* with a Y row stride of stride bytes
+// (width if <= 0, see yuvImageFromBuffer), into outs[i], width*height pixels of outFormat. Returns the number of
+// frames converted: count, or 0 if the arguments are not valid
+int convertYUV420Batch(const unsigned char * const * frames, void * const * outs, int count,
+                       int format, int width, int height, int stride, int outFormat);
+
+// Same for frames stored one after the other in one buffer (yuvBufferSize bytes each) into one output buffer
+// (width*height*YUV_BATCH_BYTES(outFormat) bytes each)
+int convertYUV420BatchPacked(const unsigned char * frames, void * out, int count,
+                             int format, int width, int height, int stride, int outFormat);
+
+#endif
@@ -0,0 +1,216 @@
+//
+// Scalar, pthread, worker pool and OpenMP kernels of the YUV420 NV21 -> RGB8888 conversion.
+// They have no JNI dependency (the JNI glue is in processimg.c) so they also build on the host.
+//
+
+#include <string.h>
+#include <pthread.h>
+#include <omp.h>
+#include "workerpool.h"
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+#include "yuvprofile.h"
+
+#define PREFETCH_BYTES 64       // one cache line of Y (and of UV) per prefetch
+#define CHUNK_PAIRS 4           // row pairs claimed at a time by the threads of the pthread kernel
+#define MIN_CHUNK_PAIRS 2       // smallest chunk of the worker pool kernel
+
+    typedef struct paramST {  // data structure holding all operands needed by a worker thread
+        const unsigned char * data;
+        int * pixels;
+        int width;
+        int height;
+        int my_id;
+        int * nextPair;       // pthread kernel: first row pair not claimed yet (shared, atomic)
+    } paramST;
+
+    // Tile size of the OpenMP kernel (see yuvSetTileSize)
+    static int tilePairs = YUV_TILE_PAIRS_DEFAULT;
+    static int tileCols = 0;
+
+    void yuvSetTileSize(int pairs, int cols)
+    {
+        tilePairs = pairs > 0 ? pairs : YUV_TILE_PAIRS_DEFAULT;
+        tileCols = cols > 0 ? (cols + YUV_TILE_ALIGN-1) & ~(YUV_TILE_ALIGN-1) : 0;
+    }
+
+    void yuvGetTileSize(int *pairs, int *cols)
+    {
+        *pairs = tilePairs;
+        *cols = tileCols;
+    }
+
+    // process the whole image
+    void convertYUV420_NV21toRGB8888(const unsigned char * data, int * pixels, int width, int height)
+    // pixels must have room for width*height ints, one per pixel
+    {
+        // row pair by row pair: no division or modulo per pixel, next row pair prefetched
+        convertYUV420_NV21toRGB8888Tile(data, pixels, width, height, 0, height/2, 0, width);
+    }
+
+    // Process the row pairs [pair0, pair1) and the columns [col0, col1) of the image (col0, col1 even).
+    // The SIMD kernels use it for the columns that do not fill a whole SIMD block.
+    // While a row pair is converted, the same columns of the next one (two Y lines and the UV line) are
+    // prefetched one cache line ahead, so a tile does not stall on every row change
+    void convertYUV420_NV21toRGB8888Tile(const unsigned char * data, int * pixels, int width, int height,
+                                         int pair0, int pair1, int col0, int col1)
+    {
+        const unsigned char *uv = data + width*height;
+        const yuvCoefs *c = yuvGetCoefs();
+        yuvChroma ch;
+        int i, j, x, xEnd, row;
+
+        for (j=pair0; j < pair1; j++) {
+            row = 2*j*width;
+            for (x=col0; x < col1; x=xEnd) {
+                xEnd = x+PREFETCH_BYTES < col1 ? x+PREFETCH_BYTES : col1;
+                if (j+1 < height/2) {
+                    __builtin_prefetch(data+row+2*width+x);
+                    __builtin_prefetch(data+row+3*width+x);
+                    __builtin_prefetch(uv+(j+1)*width+x);
+                }
+                for (i=x; i < xEnd; i+=2) {
+                    ch = yuvChromaOf(c, uv[j*width+i+1]-128, uv[j*width+i]-128);     // V U pairs
+                    pixels[row+i  ] = yuvPixel(c, data[row+i  ], &ch);
+                    pixels[row+i+1] = yuvPixel(c, data[row+i+1], &ch);
+                    pixels[row+width+i  ] = yuvPixel(c, data[row+width+i  ], &ch);
+                    pixels[row+width+i+1] = yuvPixel(c, data[row+width+i+1], &ch);
+                }
+            }
+        }
+    }
+
+    // Same for grey: Y only, with the same rounding as the RGB conversion (chroma terms are 0)
+    void convertYUV420_NV21toGREY8888Tile(const unsigned char * data, int * pixels, int width, int height,
+                                          int pair0, int pair1, int col0, int col1)
+    {
+        const yuvCoefs *c = yuvGetCoefs();
+        const yuvChroma ch = yuvChromaOf(c, 0, 0);
+        int i, row;
+
+        for (row=2*pair0; row < 2*pair1; row++)
+            for (i=col0; i < col1; i++)
+                pixels[row*width+i] = yuvPixel(c, data[row*width+i], &ch);
+    }
+
+    // Convert n pixels with their own Y, U and V (a row of a YUV 4:4:4 image, e.g. the samples of a scaled image)
+    void convertYUV444toRGB8888Row(const unsigned char * y, const unsigned char * u, const unsigned char * v, int * pixels, int n)
+    {
+        const yuvCoefs *c = yuvGetCoefs();
+        yuvChroma ch;
+        int i;
+
+        for (i=0; i < n; i++) {
+            ch = yuvChromaOf(c, u[i]-128, v[i]-128);
+            pixels[i] = yuvPixel(c, y[i], &ch);
+        }
+    }
+
+    // Claim chunks of CHUNK_PAIRS row pairs until none is left: a thread on a fast core converts
+    // more chunks than one on a slow core, instead of waiting for it at the join
+    static void convertYUV420_NV21toRGB8888Drain(const paramST *param)
+    {
+        int const pairs = param->height/2;
+        long long t0 = yuvProfStart();
+        int pair0;
+
+        while ((pair0 = __atomic_fetch_add(param->nextPair, CHUNK_PAIRS, __ATOMIC_RELAXED)) < pairs) {
+            int const pair1 = pair0+CHUNK_PAIRS < pairs ? pair0+CHUNK_PAIRS : pairs;
+
+            convertYUV420_NV21toRGB8888Tile(param->data, param->pixels, param->width, param->height, pair0, pair1, 0, param->width);
+        }
+        yuvProfBusy(YUV_PROF_PTHREAD, param->my_id, t0);
+    }
+
+    // pthread entry point
+    static void *convertYUV420_NV21toRGB8888Chunk(void *args)
+    {
+        convertYUV420_NV21toRGB8888Drain((const paramST *)args);
+        pthread_exit(NULL);
+    }
+
+    // Process the row pairs [pair0, pair1) of the image (worker pool task)
+    static void convertYUV420_NV21toRGB8888Range(void *args, int pair0, int pair1)
+    {
+        const paramST *param = (const paramST *)args;
+
+        convertYUV420_NV21toRGB8888Tile(param->data, param->pixels, param->width, param->height, pair0, pair1, 0, param->width);
+    }
+
+    // process the whole image in tiles of tilePairs row pairs x tileCols columns (yuvSetTileSize).
+    // Each thread gets a contiguous range of tiles, and tiles start on a 64-byte line of output
+    // (width multiple of 16): threads never write the same cache line
+    void convertYUV420_NV21toRGB8888_OMP(const unsigned char * data, int * pixels, int width, int height)
+    // pixels must have room for width*height ints, one per pixel
+    {
+        int const pairs = height/2;
+        int const tp = tilePairs;
+        int const tc = tileCols > 0 && tileCols < width ? tileCols : width;
+        int const tilesX = (width + tc-1)/tc;
+        int const ntiles = (pairs + tp-1)/tp*tilesX;
+        long long const tjob = yuvProfStart();
+
+#pragma omp parallel
+        {
+            long long const t0 = yuvProfStart();
+            int t;
+
+            // nowait: each thread times its own tiles, without the barrier of the loop
+#pragma omp for schedule(static) nowait
+            for (t=0; t < ntiles; t++) {
+                int const pair0 = t/tilesX*tp;         // one division per tile, not per pixel
+                int const col0 = t%tilesX*tc;
+                int const pair1 = pair0+tp < pairs ? pair0+tp : pairs;
+                int const col1 = col0+tc < width ? col0+tc : width;
+                //__android_log_print(ANDROID_LOG_INFO, "HOOKnative", "num threads %d", omp_get_num_threads());
+                convertYUV420_NV21toRGB8888Tile(data, pixels, width, height, pair0, pair1, col0, col1);
+            }
+            yuvProfBusy(YUV_PROF_OMP, omp_get_thread_num(), t0);
+        }
+        yuvProfJob(YUV_PROF_OMP, tjob);
+    }
+
+    // Process the whole image in parallel using nthr pthreads, which claim chunks of row pairs
+    void convertYUV420_NV21toRGB8888Parallel(const unsigned char * data, int * pixels, int width, int height, int nthr)
+    {
+        pthread_t th[MAX_NUM_THREADS];
+        paramST params[MAX_NUM_THREADS];
+        int my_nthr = nthr < 1 ? 1 : nthr;
+        int nextPair = 0;
+        int i, created;
+        long long const t0 = yuvProfStart();
+
+        if (my_nthr > MAX_NUM_THREADS)
+            my_nthr = MAX_NUM_THREADS;
+        for (created=0; created < my_nthr; created++) {
+            params[created].data = data;
+            params[created].pixels = pixels;
+            params[created].width = width;
+            params[created].height = height;
+            params[created].my_id = created;
+            params[created].nextPair = &nextPair;
+            if (pthread_create(&(th[created]), NULL, convertYUV420_NV21toRGB8888Chunk, (void *)&(params[created])) != 0)
+                break;
+        }
+        if (created < my_nthr)      // no more threads: the caller claims the remaining rows
+            convertYUV420_NV21toRGB8888Drain(&(params[created]));
+        for (i=0; i < created; i++) {
+            pthread_join(th[i], NULL);
+        }
+        yuvProfJob(YUV_PROF_PTHREAD, t0);
+    }
+
+    // Process the whole image in parallel on the persistent worker pool (no thread creation per frame),
+    // in chunks of row pairs scheduled by workerPoolRunRange
+    void convertYUV420_NV21toRGB8888Pool(const unsigned char * data, int * pixels, int width, int height)
+    {
+        paramST param;
+
+        param.data = data;
+        param.pixels = pixels;
+        param.width = width;
+        param.height = height;
+        param.my_id = 0;
+        param.nextPair = NULL;
+        workerPoolRunRange(convertYUV420_NV21toRGB8888Range, (void *)&param, height/2, MIN_CHUNK_PAIRS);
+    }
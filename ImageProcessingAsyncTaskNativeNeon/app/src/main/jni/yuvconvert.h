@@ -0,0 +1,121 @@
+//
+// YUV420 NV21 -> RGB8888 conversion kernels, without any JNI dependency.
+// They are used by the JNI glue (processimg.c, processimg_neon.c) and by the host tools (host/).
+// In every kernel, pixels must have room for width*height ints, one per pixel.
+//
+
+#ifndef YUVCONVERT_H
+#define YUVCONVERT_H
+
+#define MAX_NUM_THREADS 16
+
+// Sequential scalar version
+void convertYUV420_NV21toRGB8888(const unsigned char * data, int * pixels, int width, int height);
+
+// Parallel version creating nthr pthreads for the frame
+void convertYUV420_NV21toRGB8888Parallel(const unsigned char * data, int * pixels, int width, int height, int nthr);
+
+// Parallel version running on the persistent worker pool (see workerpool.h)
+void convertYUV420_NV21toRGB8888Pool(const unsigned char * data, int * pixels, int width, int height);
+
+// Parallel version with OpenMP (uses the number of threads set with omp_set_num_threads).
+// The frame is split in tiles of yuvSetTileSize, scheduled statically
+void convertYUV420_NV21toRGB8888_OMP(const unsigned char * data, int * pixels, int width, int height);
+
+// Tiles of the OpenMP kernel: pairs row pairs x cols columns (cols <= 0: whole rows, pairs <= 0: the default).
+// cols is rounded up to a multiple of YUV_TILE_ALIGN pixels (one 64-byte line of output), so two threads never
+// write the same cache line when width is a multiple of YUV_TILE_ALIGN too
+#define YUV_TILE_ALIGN 16
+#define YUV_TILE_PAIRS_DEFAULT 8
+void yuvSetTileSize(int pairs, int cols);
+void yuvGetTileSize(int *pairs, int *cols);
+
+// GREY8888 versions (yuvgrey.c): only the Y plane is read, R = G = B = grey level of Y with the
+// current colour space (the RGB conversion with U = V = 0)
+void convertYUV420_NV21toGREY8888(const unsigned char * data, int * pixels, int width, int height);
+void convertYUV420_NV21toGREY8888Parallel(const unsigned char * data, int * pixels, int width, int height, int nthr);
+void convertYUV420_NV21toGREY8888Pool(const unsigned char * data, int * pixels, int width, int height);
+void convertYUV420_NV21toGREY8888_OMP(const unsigned char * data, int * pixels, int width, int height);
+
+// Single channel grey output: one byte per pixel, grey must have room for width*height bytes
+void convertYUV420_NV21toGREY8(const unsigned char * data, unsigned char * grey, int width, int height);
+
+// Grey of n Y values (lookup table), as GREY8888 ints or as bytes (grey may be y itself)
+void convertYtoGREY8888Row(const unsigned char * y, int * pixels, int n);
+void convertYtoGREY8Row(const unsigned char * y, unsigned char * grey, int n);
+
+// Scalar conversion of the row pairs [pair0, pair1) and the columns [col0, col1) (col0, col1 even)
+void convertYUV420_NV21toRGB8888Tile(const unsigned char * data, int * pixels, int width, int height,
+                                     int pair0, int pair1, int col0, int col1);
+void convertYUV420_NV21toGREY8888Tile(const unsigned char * data, int * pixels, int width, int height,
+                                      int pair0, int pair1, int col0, int col1);
+
+// Table-driven scalar versions (yuvlut.c, tables of yuvGetLUT): same images as the scalar kernels with
+// lookups instead of multiplications (BACKEND_LUT, BACKEND_LUT_POOL)
+void convertYUV420_NV21toRGB8888_LUT(const unsigned char * data, int * pixels, int width, int height);
+void convertYUV420_NV21toRGB8888LUTPool(const unsigned char * data, int * pixels, int width, int height);
+void convertYUV420_NV21toRGB8888LUTTile(const unsigned char * data, int * pixels, int width, int height,
+                                        int pair0, int pair1, int col0, int col1);
+
+// Scalar conversion of n pixels that have their own Y, U and V (a row of a YUV 4:4:4 image)
+void convertYUV444toRGB8888Row(const unsigned char * y, const unsigned char * u, const unsigned char * v, int * pixels, int n);
+
+// SIMD versions. They return 0 (and do nothing) if they are not compiled in this build or the
+// frame is not supported (width and height must be even). The columns that do not fill a SIMD
+// block (width not multiple of 8) are converted with the scalar tile kernel.
+// The CPU must support the instruction set: check yuvCPUFeatures() before calling them directly.
+int convertYUV420_NV21toRGB8888_NEON(const unsigned char * data, int * pixels, int width, int height);
+int convertYUV420_NV21toGREY8888_NEON(const unsigned char * data, int * pixels, int width, int height);
+int convertYUV420_NV21toRGB8888_NEON64(const unsigned char * data, int * pixels, int width, int height);    // AArch64
+int convertYUV420_NV21toRGB8888_SSE41(const unsigned char * data, int * pixels, int width, int height);
+int convertYUV420_NV21toGREY8888_SSE41(const unsigned char * data, int * pixels, int width, int height);
+int convertYUV420_NV21toRGB8888_AVX2(const unsigned char * data, int * pixels, int width, int height);
+
+// Band versions of the SIMD kernels: only the row pairs [pair0, pair1) (rows 2*pair0 .. 2*pair1-1)
+int convertYUV420_NV21toRGB8888_NEON_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+int convertYUV420_NV21toGREY8888_NEON_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+int convertYUV420_NV21toRGB8888_NEON64_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+int convertYUV420_NV21toRGB8888_SSE41_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+int convertYUV420_NV21toGREY8888_SSE41_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+int convertYUV420_NV21toRGB8888_AVX2_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+
+// SIMD versions of convertYtoGREY8888Row / convertYtoGREY8Row: they convert the first n&~15 values and
+// return how many they converted (0 if the colour space has ycoef outside [256,511])
+int convertYtoGREY8888Row_NEON(const unsigned char * y, int * pixels, int n);
+int convertYtoGREY8Row_NEON(const unsigned char * y, unsigned char * grey, int n);
+int convertYtoGREY8888Row_SSE41(const unsigned char * y, int * pixels, int n);
+int convertYtoGREY8Row_SSE41(const unsigned char * y, unsigned char * grey, int n);
+
+// Runtime dispatch (yuvdispatch.c): the CPU is inspected once and the fastest kernel is selected
+#define YUV_CPU_NEON  1
+#define YUV_CPU_SSE41 2
+#define YUV_CPU_AVX2  4
+
+void yuvDispatchInit(void);         // optional: done on first use otherwise
+int yuvCPUFeatures(void);           // YUV_CPU_* flags of the running CPU
+int yuvHasNEON(void);               // 1 if the NEON kernels can run on this CPU
+int yuvHasSIMD(void);               // 1 if there is a SIMD kernel for this CPU
+const char *yuvSIMDName(void);      // name of the selected instruction set ("none" if no SIMD)
+
+// Convert with the selected SIMD kernel. Returns 1 if it was used, 0 if the table-driven scalar version
+// was used instead (no SIMD or unsupported frame size); the image is converted in both cases.
+int convertYUV420_NV21toRGB8888_SIMD(const unsigned char * data, int * pixels, int width, int height);
+
+// Same for the row pairs [pair0, pair1) only (the table-driven kernel if there is no SIMD)
+int convertYUV420_NV21toRGB8888_SIMDRows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+
+// Same for grey (GREY8888 and single channel)
+int convertYUV420_NV21toGREY8888_SIMD(const unsigned char * data, int * pixels, int width, int height);
+int convertYUV420_NV21toGREY8_SIMD(const unsigned char * data, unsigned char * grey, int width, int height);
+
+// YUV 4:4:4 row with the selected SIMD kernel and a scalar tail (scalar only if there is no SIMD).
+// Any output format: convertYUV444toFormatRow_SIMD (yuvplanes.h)
+void convertYUV444toRGB8888Row_SIMD(const unsigned char * y, const unsigned char * u, const unsigned char * v, int * pixels, int n);
+
+// SIMD kernel on the persistent worker pool: the frame is split in bands of row pairs and every
+// band is converted with the selected SIMD kernel. Same return values as the sequential versions
+// (they fall back to the table-driven kernel on the pool, the grey one to the scalar kernel).
+int convertYUV420_NV21toRGB8888_SIMDParallel(const unsigned char * data, int * pixels, int width, int height);
+int convertYUV420_NV21toGREY8888_SIMDParallel(const unsigned char * data, int * pixels, int width, int height);
+
+#endif
@@ -0,0 +1,400 @@
+//
+// Created by Andrés Rodríguez Moreno on 28/11/15.
+//
+// NEON kernels of the YUV420 NV21 -> RGB8888 / GREY8888 conversion (the JNI glue is in processimg_neon.c)
+//
+
+#include <string.h>
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+
+// NEON Implementation
+
+#if (defined(__ARM_ARCH_7A__) && defined(__ARM_NEON__)) || defined(__aarch64__)
+#include <arm_neon.h>
+
+#define bytes_per_pixel 4 // RGB+alfa
+
+    int convertYUV420_NV21toRGB8888_NEON(const unsigned char * data, int * pixels, int width, int height)
+    {
+        return convertYUV420_NV21toRGB8888_NEON_Rows(data, pixels, width, height, 0, height/2);
+    }
+
+    int convertYUV420_NV21toRGB8888_NEON_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+    // pixels must have room for width*height ints, one per pixel. Converts the row pairs [pair0, pair1)
+    {
+        yuvImage img;
+
+        return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) &&
+               convertYUV420toFormat_NEON_Rows(&img, pixels, YUV_OUT_INT8888, pair0, pair1);
+    }
+
+    // 4 bytes at v and 4 at u (any alignment) as { v0..v3, u0..u3 }
+    static inline uint8x8_t loadPlanar(const unsigned char *v, const unsigned char *u)
+    {
+        uint32_t a, b;
+
+        memcpy(&a, v, 4);
+        memcpy(&b, u, 4);
+        return vcreate_u8((uint64_t)a | ((uint64_t)b << 32));
+    }
+
+    // Store the 8 pixels of pblock (R, G, B and alpha vectors) in the output format: 8*YUV_OUT_BYTES(format) bytes
+    static inline __attribute__((always_inline)) void storeBlock(unsigned char *out, uint8x8x4_t pblock, int const format)
+    {
+        if (format == YUV_OUT_RGB565) {
+    // B>>3 widened to u16, then G>>2 and R>>3 shifted left and inserted over it: R<<11 | G<<5 | B
+            uint16x8_t p = vmovl_u8(vshr_n_u8(pblock.val[2], 3));
+            p = vsliq_n_u16(p, vmovl_u8(vshr_n_u8(pblock.val[1], 2)), 5);
+            p = vsliq_n_u16(p, vmovl_u8(vshr_n_u8(pblock.val[0], 3)), 11);
+            vst1q_u16((uint16_t *)out, p);
+        } else if (format == YUV_OUT_RGB888) {
+    // 3-way strided store, no alpha: r1 g1 b1 r2 g2 b2 ...
+            uint8x8x3_t p;
+            p.val[0] = pblock.val[0];
+            p.val[1] = pblock.val[1];
+            p.val[2] = pblock.val[2];
+            vst3_u8(out, p);
+        } else if (format == YUV_OUT_BGRA8888) {
+            uint8x8_t const r = pblock.val[0];
+            pblock.val[0] = pblock.val[2];
+            pblock.val[2] = r;
+            vst4_u8(out, pblock);
+        } else {
+            vst4_u8(out, pblock);
+        }
+    }
+
+    // Convert the itWidth blocks of 8 pixels of a row pair (y0, y1 --> out0, out1). c0 is the row of interleaved
+    // chroma pairs (NV21 or NV12 layout), or the V row and c1 the U row (planar layout).
+    // layout and format are constants at every call, so each chroma layout and output format gets its own specialised loop
+    static inline __attribute__((always_inline)) void convertRowPair(const unsigned char *y0, const unsigned char *y1,
+                                                                    const unsigned char *c0, const unsigned char *c1,
+                                                                    unsigned char *out0, unsigned char *out1, int itWidth,
+                                                                    yuvCoefs const* c, int const layout, int const format)
+    {
+        int const bpp = YUV_OUT_BYTES(format);
+        unsigned char const fill_alpha=0xff;
+
+    // a block temporary stores consecutively 8 pixels
+        uint8x8x4_t pblock; //Array of 4 vectors with 8 lines, 8 bits each
+    // Last position of the array initialized with 8 lines equal to 0xFF
+        pblock.val[3] = vdup_n_u8(fill_alpha); // alpha channel in the last
+
+//R = [128 + 298(Y - 16) + 409(V - 128)] >> 8
+//G = [128 + 298(Y - 16) - 100(U - 128) - 208(V - 128)] >> 8
+//B = [128 + 298(Y - 16) + 516(U - 128)] >> 8
+// (BT.601 limited range; the actual coefficients are taken from the table in yuv2rgb.c)
+
+    // simd constants
+        uint8x8_t const Yshift = vdup_n_u8(c->yoff); //this is the constant to substract to y
+        int16x8_t const half = vdupq_n_s16(128); // this is the constant to substract to u and v
+        int32x4_t const rounding = vdupq_n_s32(128); // this is the constant to round adding 128/256=0.5
+
+    // tmp variable to load y and uv
+        uint16x8_t t;
+        int16x4x2_t VU;
+        int i;
+
+        for ( i=0; i<8*itWidth; i+=8) {
+// load u8x8 y values, substract 16 to each one and promote to u16x8:
+            t = vmovl_u8(vqsub_u8(vld1_u8(y0+i), Yshift));
+// splits the u16x8 in two u16x4 that are multiplied by 298 and promoted to u32x4
+            int32x4_t const Y00 = vmulq_n_u32(vmovl_u16(vget_low_u16(t)), c->ycoef);
+            int32x4_t const Y01 = vmulq_n_u32(vmovl_u16(vget_high_u16(t)), c->ycoef);
+// the same with the next row that also shares the u and v values
+            t = vmovl_u8(vqsub_u8(vld1_u8(y1+i), Yshift));
+            int32x4_t const Y10 = vmulq_n_u32(vmovl_u16(vget_low_u16(t)), c->ycoef);
+            int32x4_t const Y11 = vmulq_n_u32(vmovl_u16(vget_high_u16(t)), c->ycoef);
+
+            if (layout == YUV_CHROMA_PLANAR) {
+    // 4 V and 4 U from their planes: { v0..v3, u0..u3 } promoted to s16 and centered, already split
+                t = vsubq_s16((int16x8_t)vmovl_u8(loadPlanar(c0+i/2, c1+i/2)), half);
+                VU.val[0] = vget_low_s16(t);
+                VU.val[1] = vget_high_s16(t);
+            } else {
+    // load vu pack 4 sets of vu into a uint8x8_t, layout : { v0,u0, v1,u1, v2,u2, v3,u3 } (NV21: V first)
+    // u8x8 pack is promoted to u16x8 and then 128 is subtracted to each line
+                t = vsubq_s16((int16x8_t)vmovl_u8(vld1_u8(c0+i)), half);
+
+//Unzip operation to compute VU array
+// 	    Low part of t	        High part of t
+//  	v2 u2 v3 u3             v0 u0 v1 u1
+// After unzip op:
+// VU.val[0] : v0, v1, v2, v3
+// VU.val[1] : u0, u1, u2, u3
+                VU = vuzp_s16(vget_low_s16(t), vget_high_s16(t));
+                if (layout == YUV_CHROMA_UV) {      // NV12: the pairs come the other way round
+                    int16x4_t const first = VU.val[0];
+                    VU.val[0] = VU.val[1];
+                    VU.val[1] = first;
+                }
+            }
+
+// tR : 128+409V
+// tG : 128-100U-208V
+// tB : 128+516U
+// int32x4_t  vmlal_s16(int32x4_t a, int16x4_t b, int16x4_t c);    // VMLAL.S16 q0,d0,d0
+
+            int32x4_t const tR = vmlal_n_s16(rounding, VU.val[0], c->rv);
+            int32x4_t const tG = vmlal_n_s16(vmlal_n_s16(rounding, VU.val[1], c->gu), VU.val[0], c->gv);
+            int32x4_t const tB = vmlal_n_s16(rounding, VU.val[1], c->bu);
+// Dup TR to combine with two different y
+            int32x4x2_t const R = vzipq_s32(tR, tR); // [tR0, tR0, tR1, tR1] [tR2, tR2, tR3, tR3]
+            int32x4x2_t const G = vzipq_s32(tG, tG); // [tG0, tG0, tG1, tG1] [tG2, tG2, tG3, tG3]
+            int32x4x2_t const B = vzipq_s32(tB, tB); // [tB0, tB0, tB1, tB1] [tB2, tB2, tB3, tB3]
+
+/* The following intrinsics are:
+// vaddq_s32  standard addition
+// int32x4_t   vaddq_s32(int32x4_t a, int32x4_t b);     // VADD.I32 q0,q0,q0
+
+// vqmovun_s32  Vector saturating narrow integer signed->unsigned
+//uint16x4_t vqmovun_s32(int32x4_t a);                     // VQMOVUN.S32 d0,q0
+
+// These intrinsics join two 64 bit vectors into a single 128 bit vector
+//uint16x8_t  vcombine_u16(uint16x4_t low, uint16x4_t high);   // VMOV d0,d0
+
+//Vector narrowing shift right by constant
+// uint8x8_t  vshrn_n_u16(uint16x8_t a, __constrange(1,8) int b);  // VSHRN.I16 d0,q0,#8
+*/
+// upper 8 pixels
+//store_pixel_block(out, pblock,
+            pblock.val[0] = vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(R.val[0], Y00)), vqmovun_s32(vaddq_s32(R.val[1], Y01))), 8);
+            pblock.val[1] = vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(G.val[0], Y00)), vqmovun_s32(vaddq_s32(G.val[1], Y01))), 8);
+            pblock.val[2] = vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(B.val[0], Y00)), vqmovun_s32(vaddq_s32(B.val[1], Y01))), 8);
+// Strided store: 4 is the stride factor
+// pblock has a1 a2 a3 a4 a5 a6 a7 a8 b1 b2 b3 b4 b5 b6 b7 b8 g1 g2 g3 g4 g5 g6 g7 g8 r1 r2 r3 r4 r5 r6 r7 r8
+// after vst4 --> a1 b1 g1 r1 a2 b2 g2 r2 ....
+            storeBlock(out0+i*bpp, pblock, format);
+
+//For the row below (+ width) same u and v values are also used.
+// lower 8 pixels
+//store_pixel_block(out+stride, pblock,
+            pblock.val[0] =vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(R.val[0], Y10)), vqmovun_s32(vaddq_s32(R.val[1], Y11))), 8);
+            pblock.val[1] =vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(G.val[0], Y10)), vqmovun_s32(vaddq_s32(G.val[1], Y11))), 8);
+            pblock.val[2] =vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(B.val[0], Y10)), vqmovun_s32(vaddq_s32(B.val[1], Y11))), 8);
+            storeBlock(out1+i*bpp, pblock, format);
+        }
+    }
+
+    // Row pairs [pair0, pair1) of any descriptor with a SIMD layout, in one output format
+    static inline __attribute__((always_inline)) void convertRows(const yuvImage *img, unsigned char * out, int pair0, int pair1,
+                                                                 int layout, int const format)
+    {
+        yuvCoefs const* c = yuvGetCoefs();
+        int const width = img->width;
+        int const rowBytes = width*YUV_OUT_BYTES(format);
+        int j;
+
+        for ( j=pair0; j<pair1; ++j) {
+            const unsigned char *y0 = img->y.data + 2*j*img->y.rowStride;
+            const unsigned char *u = img->u.data + j*img->u.rowStride;
+            const unsigned char *v = img->v.data + j*img->v.rowStride;
+            unsigned char *out0 = out + 2*j*rowBytes;
+            unsigned char *out1 = out0 + rowBytes;
+
+    // iteration count: blocks of 8 pixels, the rest of the row is done by the scalar tail
+            switch (layout) {
+                case YUV_CHROMA_VU: convertRowPair(y0, y0+img->y.rowStride, v, NULL, out0, out1, width>>3, c, YUV_CHROMA_VU, format); break;
+                case YUV_CHROMA_UV: convertRowPair(y0, y0+img->y.rowStride, u, NULL, out0, out1, width>>3, c, YUV_CHROMA_UV, format); break;
+                default:            convertRowPair(y0, y0+img->y.rowStride, v, u, out0, out1, width>>3, c, YUV_CHROMA_PLANAR, format); break;
+            }
+        }
+    }
+
+    int convertYUV420toFormat_NEON_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+    {
+        int const layout = yuvChromaLayout(img);
+
+        if (!out || !YUV_OUT_VALID(format) || !yuvImageCheck(img, pair0, pair1) || layout == YUV_CHROMA_OTHER)
+            return 0;
+
+        switch (format) {
+            case YUV_OUT_BGRA8888: convertRows(img, out, pair0, pair1, layout, YUV_OUT_BGRA8888); break;
+            case YUV_OUT_RGB565:   convertRows(img, out, pair0, pair1, layout, YUV_OUT_RGB565); break;
+            case YUV_OUT_RGB888:   convertRows(img, out, pair0, pair1, layout, YUV_OUT_RGB888); break;
+            default:               convertRows(img, out, pair0, pair1, layout, YUV_OUT_RGBA8888); break;
+        }
+    // scalar tail: width not multiple of 8
+        if (img->width&7)
+            convertYUV420toFormatTile(img, out, format, pair0, pair1, img->width&~7, img->width);
+        return 1;
+    }
+
+int convertYUV420_NV21toGREY8888_NEON(const unsigned char * data, int * pixels, int width, int height)
+{
+    return convertYUV420_NV21toGREY8888_NEON_Rows(data, pixels, width, height, 0, height/2);
+}
+
+int convertYUV420_NV21toGREY8888_NEON_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+// pixels must have room for width*height ints, one per pixel. Converts the row pairs [pair0, pair1)
+{
+    // pre-condition : width and height must be even, the row pairs inside the image
+    if (0!=(width&1) || width<2 || 0!=(height&1) || height<2 || pair0<0 || pair1<pair0 || pair1>height/2 || !pixels || !data)
+        return 0;
+
+    // only the Y plane is read; the rows of the band are contiguous, so they are converted as one long row
+    int const first = 2*pair0*width;
+    int const n = 2*(pair1-pair0)*width;
+    int const done = convertYtoGREY8888Row_NEON(data+first, pixels+first, n);
+
+    if (done < n)       // scalar tail (lookup table)
+        convertYtoGREY8888Row(data+first+done, pixels+first+done, n-done);
+    return 1;
+}
+
+// grey = [128 + ycoef*Y'] >> 8 with ycoef = 256 + r: that is Y' + ([128 + r*Y'] >> 8), which fits in 16 bits
+// (r*Y' <= 255*255), so 16 pixels are done with u8 x u8 -> u16 multiplies. -1 if ycoef is out of [256,511]
+static int greyRemainder(void)
+{
+    int const r = yuvGetCoefs()->ycoef - 256;
+    return (r >= 0 && r <= 255) ? r : -1;
+}
+
+// Grey level of the first n&~15 Y values, replicated in R, G and B; returns how many were converted
+int convertYtoGREY8888Row_NEON(const unsigned char * y, int * pixels, int n)
+{
+    unsigned char* out = (unsigned char*) pixels;
+    int const r = greyRemainder();
+    int i;
+
+    if (r < 0)
+        return 0;
+    uint8x16_t const Yshift = vdupq_n_u8(yuvGetCoefs()->yoff);
+    uint8x8_t const rr = vdup_n_u8(r);
+    uint16x8_t const rounding = vdupq_n_u16(128);
+    uint8x16x4_t pblock;
+    pblock.val[3] = vdupq_n_u8(0xff);
+
+    for (i=0; i+16 <= n; i+=16, out+=16*bytes_per_pixel) {
+        uint8x16_t const ys = vqsubq_u8(vld1q_u8(y+i), Yshift);
+        uint8x8_t const lo = vshrn_n_u16(vmlal_u8(rounding, vget_low_u8(ys), rr), 8);
+        uint8x8_t const hi = vshrn_n_u16(vmlal_u8(rounding, vget_high_u8(ys), rr), 8);
+        uint8x16_t const g = vqaddq_u8(ys, vcombine_u8(lo, hi));
+
+        // byte replicate: g g g 0xff for every pixel
+        pblock.val[0] = g;
+        pblock.val[1] = g;
+        pblock.val[2] = g;
+        vst4q_u8(out, pblock);
+    }
+    return i;
+}
+
+// Same, with one byte per pixel
+int convertYtoGREY8Row_NEON(const unsigned char * y, unsigned char * grey, int n)
+{
+    int const r = greyRemainder();
+    int i;
+
+    if (r < 0)
+        return 0;
+    uint8x16_t const Yshift = vdupq_n_u8(yuvGetCoefs()->yoff);
+    uint8x8_t const rr = vdup_n_u8(r);
+    uint16x8_t const rounding = vdupq_n_u16(128);
+
+    for (i=0; i+16 <= n; i+=16) {
+        uint8x16_t const ys = vqsubq_u8(vld1q_u8(y+i), Yshift);
+        uint8x8_t const lo = vshrn_n_u16(vmlal_u8(rounding, vget_low_u8(ys), rr), 8);
+        uint8x8_t const hi = vshrn_n_u16(vmlal_u8(rounding, vget_high_u8(ys), rr), 8);
+        vst1q_u8(grey+i, vqaddq_u8(ys, vcombine_u8(lo, hi)));
+    }
+    return i;
+}
+
+// Convert the first n&~7 pixels of a YUV 4:4:4 row (one U and V per pixel) in the output format (a constant at
+// every call); returns how many were converted
+static inline __attribute__((always_inline)) int row444(const unsigned char * y, const unsigned char * u, const unsigned char * v,
+                                                        unsigned char * out, int const format, int n)
+{
+    yuvCoefs const* c = yuvGetCoefs();
+
+    uint8x8_t const Yshift = vdup_n_u8(c->yoff);
+    int16x8_t const half = vdupq_n_s16(128);
+    int32x4_t const rounding = vdupq_n_s32(128);
+
+    uint8x8x4_t pblock;
+    pblock.val[3] = vdup_n_u8(0xff);
+
+    uint16x8_t t;
+    int i;
+
+    for (i=0; i+8 <= n; i+=8, out+=8*YUV_OUT_BYTES(format)) {
+        // 298(Y - 16) of the 8 pixels
+        t = vmovl_u8(vqsub_u8(vld1_u8(y+i), Yshift));
+        int32x4_t const Y0 = vmulq_n_u32(vmovl_u16(vget_low_u16(t)), c->ycoef);
+        int32x4_t const Y1 = vmulq_n_u32(vmovl_u16(vget_high_u16(t)), c->ycoef);
+
+        // U - 128 and V - 128, one of each per pixel
+        int16x8_t const U = vsubq_s16((int16x8_t)vmovl_u8(vld1_u8(u+i)), half);
+        int16x8_t const V = vsubq_s16((int16x8_t)vmovl_u8(vld1_u8(v+i)), half);
+
+        int32x4_t const R0 = vmlal_n_s16(rounding, vget_low_s16(V), c->rv);
+        int32x4_t const R1 = vmlal_n_s16(rounding, vget_high_s16(V), c->rv);
+        int32x4_t const G0 = vmlal_n_s16(vmlal_n_s16(rounding, vget_low_s16(U), c->gu), vget_low_s16(V), c->gv);
+        int32x4_t const G1 = vmlal_n_s16(vmlal_n_s16(rounding, vget_high_s16(U), c->gu), vget_high_s16(V), c->gv);
+        int32x4_t const B0 = vmlal_n_s16(rounding, vget_low_s16(U), c->bu);
+        int32x4_t const B1 = vmlal_n_s16(rounding, vget_high_s16(U), c->bu);
+
+        pblock.val[0] = vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(R0, Y0)), vqmovun_s32(vaddq_s32(R1, Y1))), 8);
+        pblock.val[1] = vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(G0, Y0)), vqmovun_s32(vaddq_s32(G1, Y1))), 8);
+        pblock.val[2] = vshrn_n_u16(vcombine_u16(vqmovun_s32(vaddq_s32(B0, Y0)), vqmovun_s32(vaddq_s32(B1, Y1))), 8);
+        storeBlock(out, pblock, format);
+    }
+    return i;
+}
+
+int convertYUV444toFormatRow_NEON(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n)
+{
+    switch (format) {
+        case YUV_OUT_BGRA8888: return row444(y, u, v, out, YUV_OUT_BGRA8888, n);
+        case YUV_OUT_RGB565:   return row444(y, u, v, out, YUV_OUT_RGB565, n);
+        case YUV_OUT_RGB888:   return row444(y, u, v, out, YUV_OUT_RGB888, n);
+        default:               return row444(y, u, v, out, YUV_OUT_RGBA8888, n);
+    }
+}
+
+#else
+// NEON not available in this build: the kernels do nothing and report it (never selected by yuvdispatch.c)
+
+    int convertYUV420_NV21toRGB8888_NEON(const unsigned char * data, int * pixels, int width, int height)
+    {
+        return 0;
+    }
+
+    int convertYUV420_NV21toGREY8888_NEON(const unsigned char * data, int * pixels, int width, int height)
+    {
+        return 0;
+    }
+
+    int convertYUV420_NV21toRGB8888_NEON_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+    {
+        return 0;
+    }
+
+    int convertYUV420_NV21toGREY8888_NEON_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+    {
+        return 0;
+    }
+
+    int convertYUV444toFormatRow_NEON(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n)
+    {
+        return 0;
+    }
+
+    int convertYtoGREY8888Row_NEON(const unsigned char * y, int * pixels, int n)
+    {
+        return 0;
+    }
+
+    int convertYtoGREY8Row_NEON(const unsigned char * y, unsigned char * grey, int n)
+    {
+        return 0;
+    }
+
+    int convertYUV420toFormat_NEON_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+    {
+        return 0;
+    }
+#endif
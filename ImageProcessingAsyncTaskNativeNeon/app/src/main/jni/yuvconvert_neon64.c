@@ -0,0 +1,240 @@
+//
+// AArch64 NEON kernel of the YUV420 -> RGB conversion (every chroma layout and output format of yuvplanes.h).
+// 16 pixels of two rows per iteration, all the arithmetic in 16-bit lanes (8 per register,
+// twice the lanes of the 32-bit ARMv7 kernel) and bit-identical to the fixed-point reference (yuv2rgb.h).
+//
+// Every coefficient c is split as c = 256*q + r with r in [-128,127], so that
+//   128 + c_y*Y' + c_u*U + c_v*V = 256*(q_y*Y' + q_u*U + q_v*V) + (128 + r_y*Y' + r_u*U + r_v*V) = 256*H + L
+// and (256*H + L) >> 8 = H + (L >> 8) exactly. Both H and L fit in 16 bits for the coefficient table.
+//
+
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+typedef struct splitCoef {
+    int16_t q;      // multiple of 256
+    int16_t r;      // remainder in [-128,127]
+} splitCoef;
+
+static splitCoef split(int c)
+{
+    splitCoef s;
+
+    s.q = (int16_t)((c + 128) >> 8);
+    s.r = (int16_t)(c - 256*s.q);
+    return s;
+}
+
+// 1 if L = 128 + ry*Y' + ra*U + rb*V fits in s16 for Y' in [0,ymax] and U, V in [-128,127]
+static int lowFits16(int ry, int ymax, int ra, int rb)
+{
+    int hi = 128 + (ry > 0 ? ry*ymax : 0) + (ra > 0 ? 127*ra : -128*ra) + (rb > 0 ? 127*rb : -128*rb);
+    int lo = 128 + (ry < 0 ? ry*ymax : 0) + (ra < 0 ? 127*ra : -128*ra) + (rb < 0 ? 127*rb : -128*rb);
+    return hi <= 32767 && lo >= -32768;
+}
+
+int convertYUV420_NV21toRGB8888_NEON64(const unsigned char * data, int * pixels, int width, int height)
+{
+    return convertYUV420_NV21toRGB8888_NEON64_Rows(data, pixels, width, height, 0, height/2);
+}
+
+int convertYUV420_NV21toRGB8888_NEON64_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+// pixels must have room for width*height ints, one per pixel. Converts the row pairs [pair0, pair1)
+{
+    yuvImage img;
+
+    return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) &&
+           convertYUV420toFormat_NEON64_Rows(&img, pixels, YUV_OUT_INT8888, pair0, pair1);
+}
+
+// coefficients of a conversion, split (see above)
+typedef struct splitCoefs {
+    splitCoef ky, kr, kgu, kgv, kb;
+    uint8x16_t Yshift;
+} splitCoefs;
+
+// Store the 16 pixels of pblock (R, G, B and alpha vectors) in the output format: 16*YUV_OUT_BYTES(format) bytes
+static inline __attribute__((always_inline)) void storeBlock(unsigned char *out, uint8x16x4_t pblock, int const format)
+{
+    if (format == YUV_OUT_RGB565) {
+        // B>>3 widened to u16, G>>2 and R>>3 shifted left and inserted over it: R<<11 | G<<5 | B, 8 pixels per register
+        uint8x16_t const r = vshrq_n_u8(pblock.val[0], 3), g = vshrq_n_u8(pblock.val[1], 2), b = vshrq_n_u8(pblock.val[2], 3);
+        uint16x8_t p0 = vmovl_u8(vget_low_u8(b)), p1 = vmovl_high_u8(b);
+        p0 = vsliq_n_u16(vsliq_n_u16(p0, vmovl_u8(vget_low_u8(g)), 5), vmovl_u8(vget_low_u8(r)), 11);
+        p1 = vsliq_n_u16(vsliq_n_u16(p1, vmovl_high_u8(g), 5), vmovl_high_u8(r), 11);
+        vst1q_u16((uint16_t *)out, p0);
+        vst1q_u16((uint16_t *)(out+16), p1);
+    } else if (format == YUV_OUT_RGB888) {
+        // 3-way strided store, no alpha: r1 g1 b1 r2 g2 b2 ...
+        uint8x16x3_t p;
+        p.val[0] = pblock.val[0];
+        p.val[1] = pblock.val[1];
+        p.val[2] = pblock.val[2];
+        vst3q_u8(out, p);
+    } else if (format == YUV_OUT_BGRA8888) {
+        uint8x16_t const r = pblock.val[0];
+        pblock.val[0] = pblock.val[2];
+        pblock.val[2] = r;
+        vst4q_u8(out, pblock);
+    } else {
+        // Strided store of 16 pixels: r1 g1 b1 a1 r2 g2 b2 a2 ...
+        vst4q_u8(out, pblock);
+    }
+}
+
+// The simdWidth columns of a row pair (y --> out). c0 is the row of interleaved chroma pairs (NV21 or NV12 layout),
+// or the V row and c1 the U row (planar layout). layout and format are constants at every call, so each chroma
+// layout and output format gets its own specialised loop
+static inline __attribute__((always_inline)) void convertRowPair(const unsigned char *y[2], const unsigned char *c0,
+                                                                const unsigned char *c1, unsigned char *out[2],
+                                                                int simdWidth, splitCoefs const* k, int const layout,
+                                                                int const format)
+{
+    splitCoef const ky = k->ky, kr = k->kr, kgu = k->kgu, kgv = k->kgv, kb = k->kb;
+    uint8x16_t const Yshift = k->Yshift;
+    uint8x8_t const half = vdup_n_u8(128);
+    int16x8_t const rounding = vdupq_n_s16(128);
+
+    // a block temporary stores consecutively 16 pixels, alpha channel in the last
+    uint8x16x4_t pblock;
+    pblock.val[3] = vdupq_n_u8(0xff);
+
+    int i;
+
+    for (i=0; i < simdWidth; i+=16) {
+        if (i+16 > simdWidth)   // multiple of 8 but not of 16: redo the last 16 pixels (same values)
+            i = simdWidth-16;
+
+        // 8 chroma pairs centered in s16, V and U (the first byte of an NV21 pair is V)
+        uint8x8x2_t VUb;
+        if (layout == YUV_CHROMA_PLANAR) {
+            VUb.val[0] = vld1_u8(c0 + i/2);
+            VUb.val[1] = vld1_u8(c1 + i/2);
+        } else {
+            uint8x8x2_t const pairs = vld2_u8(c0 + i);     // deinterleaved { first0..first7 } { second0..second7 }
+            VUb.val[0] = pairs.val[layout == YUV_CHROMA_UV];
+            VUb.val[1] = pairs.val[layout != YUV_CHROMA_UV];
+        }
+        int16x8_t const V = vreinterpretq_s16_u16(vsubl_u8(VUb.val[0], half));
+        int16x8_t const U = vreinterpretq_s16_u16(vsubl_u8(VUb.val[1], half));
+
+        // chroma terms of each pair: high part (multiples of 256) and low part (with the rounding)
+        int16x8_t const hR = vmulq_n_s16(V, kr.q);
+        int16x8_t const lR = vmlaq_n_s16(rounding, V, kr.r);
+        int16x8_t const hG = vmlaq_n_s16(vmulq_n_s16(U, kgu.q), V, kgv.q);
+        int16x8_t const lG = vmlaq_n_s16(vmlaq_n_s16(rounding, U, kgu.r), V, kgv.r);
+        int16x8_t const hB = vmulq_n_s16(U, kb.q);
+        int16x8_t const lB = vmlaq_n_s16(rounding, U, kb.r);
+
+        // duplicate every pair term for its two pixels: pixels 0-7 and 8-15
+        int16x8_t const hR0 = vzip1q_s16(hR, hR), hR1 = vzip2q_s16(hR, hR);
+        int16x8_t const lR0 = vzip1q_s16(lR, lR), lR1 = vzip2q_s16(lR, lR);
+        int16x8_t const hG0 = vzip1q_s16(hG, hG), hG1 = vzip2q_s16(hG, hG);
+        int16x8_t const lG0 = vzip1q_s16(lG, lG), lG1 = vzip2q_s16(lG, lG);
+        int16x8_t const hB0 = vzip1q_s16(hB, hB), hB1 = vzip2q_s16(hB, hB);
+        int16x8_t const lB0 = vzip1q_s16(lB, lB), lB1 = vzip2q_s16(lB, lB);
+
+        int row;
+        for (row=0; row < 2; row++) {       // both rows share the chroma terms
+            // 16 Y values minus offset (saturating), widened to s16
+            uint8x16_t const ys = vqsubq_u8(vld1q_u8(y[row] + i), Yshift);
+            int16x8_t const Y0 = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(ys)));
+            int16x8_t const Y1 = vreinterpretq_s16_u16(vmovl_high_u8(ys));
+            int16x8_t const hY0 = vmulq_n_s16(Y0, ky.q), lY0 = vmulq_n_s16(Y0, ky.r);
+            int16x8_t const hY1 = vmulq_n_s16(Y1, ky.q), lY1 = vmulq_n_s16(Y1, ky.r);
+
+            // H + (L >> 8), saturated to u8
+            pblock.val[0] = vcombine_u8(vqmovun_s16(vaddq_s16(vaddq_s16(hY0, hR0), vshrq_n_s16(vaddq_s16(lY0, lR0), 8))),
+                                        vqmovun_s16(vaddq_s16(vaddq_s16(hY1, hR1), vshrq_n_s16(vaddq_s16(lY1, lR1), 8))));
+            pblock.val[1] = vcombine_u8(vqmovun_s16(vaddq_s16(vaddq_s16(hY0, hG0), vshrq_n_s16(vaddq_s16(lY0, lG0), 8))),
+                                        vqmovun_s16(vaddq_s16(vaddq_s16(hY1, hG1), vshrq_n_s16(vaddq_s16(lY1, lG1), 8))));
+            pblock.val[2] = vcombine_u8(vqmovun_s16(vaddq_s16(vaddq_s16(hY0, hB0), vshrq_n_s16(vaddq_s16(lY0, lB0), 8))),
+                                        vqmovun_s16(vaddq_s16(vaddq_s16(hY1, hB1), vshrq_n_s16(vaddq_s16(lY1, lB1), 8))));
+            storeBlock(out[row] + i*YUV_OUT_BYTES(format), pblock, format);
+        }
+    }
+}
+
+// Row pairs [pair0, pair1) in one output format
+static inline __attribute__((always_inline)) void convertRows(const yuvImage *img, unsigned char * out, int pair0, int pair1,
+                                                             int layout, int simdWidth, splitCoefs const* k, int const format)
+{
+    int const rowBytes = img->width*YUV_OUT_BYTES(format);
+    int j;
+
+    for (j=pair0; j < pair1; j++) {
+        const unsigned char *y[2];
+        unsigned char *o[2];
+        const unsigned char *u = img->u.data + j*img->u.rowStride;
+        const unsigned char *v = img->v.data + j*img->v.rowStride;
+
+        y[0] = img->y.data + 2*j*img->y.rowStride;
+        y[1] = y[0] + img->y.rowStride;
+        o[0] = out + 2*j*rowBytes;
+        o[1] = o[0] + rowBytes;
+        switch (layout) {
+            case YUV_CHROMA_VU: convertRowPair(y, v, NULL, o, simdWidth, k, YUV_CHROMA_VU, format); break;
+            case YUV_CHROMA_UV: convertRowPair(y, u, NULL, o, simdWidth, k, YUV_CHROMA_UV, format); break;
+            default:            convertRowPair(y, v, u, o, simdWidth, k, YUV_CHROMA_PLANAR, format); break;
+        }
+    }
+}
+
+int convertYUV420toFormat_NEON64_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+{
+    yuvCoefs const* c = yuvGetCoefs();
+    int const layout = yuvChromaLayout(img);
+    int const width = img->width;
+    splitCoefs k;
+
+    if (!out || !YUV_OUT_VALID(format) || !yuvImageCheck(img, pair0, pair1) || layout == YUV_CHROMA_OTHER)
+        return 0;
+
+    k.ky = split(c->ycoef);
+    k.kr = split(c->rv);
+    k.kgu = split(c->gu);
+    k.kgv = split(c->gv);
+    k.kb = split(c->bu);
+    k.Yshift = vdupq_n_u8(c->yoff);
+    // the low part L must not overflow 16 bits (true for every entry of the table; checked in case it changes)
+    int const ymax = 255 - c->yoff;
+    if (!lowFits16(k.ky.r, ymax, k.kgu.r, k.kgv.r) || !lowFits16(k.ky.r, ymax, 0, k.kr.r) || !lowFits16(k.ky.r, ymax, k.kb.r, 0))
+        return 0;
+
+    // columns done with SIMD (a multiple of 8, at least 16); the rest of the row is done by the scalar tail
+    int const simdWidth = (width&~7) >= 16 ? (width&~7) : 0;
+
+    switch (format) {
+        case YUV_OUT_BGRA8888: convertRows(img, out, pair0, pair1, layout, simdWidth, &k, YUV_OUT_BGRA8888); break;
+        case YUV_OUT_RGB565:   convertRows(img, out, pair0, pair1, layout, simdWidth, &k, YUV_OUT_RGB565); break;
+        case YUV_OUT_RGB888:   convertRows(img, out, pair0, pair1, layout, simdWidth, &k, YUV_OUT_RGB888); break;
+        default:               convertRows(img, out, pair0, pair1, layout, simdWidth, &k, YUV_OUT_RGBA8888); break;
+    }
+    // scalar tail: width not multiple of 8 (or less than 16)
+    if (simdWidth < width)
+        convertYUV420toFormatTile(img, out, format, pair0, pair1, simdWidth, width);
+    return 1;
+}
+
+#else
+// Not an AArch64 build
+
+int convertYUV420_NV21toRGB8888_NEON64(const unsigned char * data, int * pixels, int width, int height)
+{
+    return 0;
+}
+
+int convertYUV420_NV21toRGB8888_NEON64_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    return 0;
+}
+
+int convertYUV420toFormat_NEON64_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+{
+    return 0;
+}
+#endif
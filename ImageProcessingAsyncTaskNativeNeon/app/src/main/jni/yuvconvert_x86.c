@@ -0,0 +1,532 @@
+//
+// SSE4.1 and AVX2 kernels of the YUV420 -> RGB8888 conversion (and the other output formats, see yuvplanes.h).
+// Same fixed-point math as the NEON kernel (see yuv2rgb.h), so the output is bit-identical.
+// Each function is compiled for its own instruction set (target attribute); the caller must
+// check that the CPU supports it (see yuvdispatch.c).
+//
+
+#include <string.h>
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+
+#define SSE41 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2")))
+
+typedef struct x86Consts {   // 128-bit copies of the coefficients
+    __m128i yoff;       // u8: Y offset
+    __m128i ycoef;      // s16 pairs {ycoef, 0}: madd with a zero-extended Y gives ycoef*Y
+    __m128i rcoef;      // s16 pairs {v, u} coefficients for R, G and B (NV21 order)
+    __m128i gcoef;
+    __m128i bcoef;
+    __m128i rounding;   // s32: 128
+    __m128i alpha;      // u16: 0xff00
+} x86Consts;
+
+// {a, b} as the s16 pair of a madd
+static inline int pair16(int a, int b)
+{
+    return (int)(((unsigned)b << 16) | ((unsigned)a & 0xffff));
+}
+
+// The chroma pairs come as {v, u} (NV21 order). swapped: they come as {u, v} (NV12): the coefficient pairs are
+// swapped instead
+static SSE41 void loadConsts(x86Consts *k, const yuvCoefs *c, int swapped)
+{
+    k->yoff = _mm_set1_epi8((char)c->yoff);
+    k->ycoef = _mm_set1_epi32(c->ycoef);
+    k->rcoef = _mm_set1_epi32(swapped ? pair16(0, c->rv) : pair16(c->rv, 0));
+    k->gcoef = _mm_set1_epi32(swapped ? pair16(c->gu, c->gv) : pair16(c->gv, c->gu));
+    k->bcoef = _mm_set1_epi32(swapped ? pair16(c->bu, 0) : pair16(0, c->bu));
+    k->rounding = _mm_set1_epi32(128);
+    k->alpha = _mm_set1_epi16((short)0xff00);
+}
+
+// 4 bytes at p (any alignment) in the low lane
+static SSE41 inline __m128i load4(const unsigned char *p)
+{
+    int w;
+
+    memcpy(&w, p, 4);
+    return _mm_cvtsi32_si128(w);
+}
+
+// 4 pixels of one channel (32-bit) --> saturated to u16 and shifted: 8 pixels of one channel in u16
+static SSE41 inline __m128i narrow(__m128i lo, __m128i hi)
+{
+    return _mm_srli_epi16(_mm_packus_epi32(lo, hi), 8);
+}
+
+// Store 8 pixels of R, G, B (u16) in the output format (a constant at every call). out advances by
+// 8*YUV_OUT_BYTES(format) bytes: exactly that is written
+static SSE41 inline __attribute__((always_inline)) void store8(unsigned char *out, __m128i r, __m128i g, __m128i b,
+                                                              __m128i alpha, int const format)
+{
+    if (format == YUV_OUT_RGB565) {
+        // R<<11 | G<<5 | B with the top bits of each channel, one u16 per pixel
+        __m128i const rb = _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11), _mm_srli_epi16(b, 3));
+        _mm_storeu_si128((__m128i *)out, _mm_or_si128(rb, _mm_slli_epi16(_mm_srli_epi16(g, 2), 5)));
+        return;
+    }
+    if (format == YUV_OUT_BGRA8888) {
+        __m128i const t = r;
+        r = b;
+        b = t;
+    }
+    // interleave with alpha: R G B A bytes (B G R A when swapped)
+    __m128i const rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    __m128i const ba = _mm_or_si128(b, alpha);
+    __m128i const lo = _mm_unpacklo_epi16(rg, ba), hi = _mm_unpackhi_epi16(rg, ba);
+
+    if (format == YUV_OUT_RGB888) {
+        // drop the alpha bytes: 12 bytes of each half, joined as 16 + 8 bytes
+        __m128i const pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        __m128i const p0 = _mm_shuffle_epi8(lo, pack), p1 = _mm_shuffle_epi8(hi, pack);
+        _mm_storeu_si128((__m128i *)out, _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+        _mm_storel_epi64((__m128i *)(out+16), _mm_srli_si128(p1, 4));
+        return;
+    }
+    _mm_storeu_si128((__m128i *)out, lo);
+    _mm_storeu_si128((__m128i *)(out+16), hi);
+}
+
+// Convert 8 pixels of two rows (y0, y1 --> out0, out1) that share the 4 chroma pairs in the low half of uv
+static SSE41 inline __attribute__((always_inline)) void block8(const unsigned char *y0, const unsigned char *y1, __m128i uv,
+                                                              unsigned char *out0, unsigned char *out1, const x86Consts *k,
+                                                              int const format)
+{
+    // 8 Y values minus offset (saturating), zero-extended to 32 bits, times ycoef
+    __m128i t = _mm_cvtepu8_epi16(_mm_subs_epu8(_mm_loadl_epi64((const __m128i *)y0), k->yoff));
+    __m128i const Y00 = _mm_madd_epi16(_mm_cvtepu16_epi32(t), k->ycoef);
+    __m128i const Y01 = _mm_madd_epi16(_mm_cvtepu16_epi32(_mm_srli_si128(t, 8)), k->ycoef);
+    t = _mm_cvtepu8_epi16(_mm_subs_epu8(_mm_loadl_epi64((const __m128i *)y1), k->yoff));
+    __m128i const Y10 = _mm_madd_epi16(_mm_cvtepu16_epi32(t), k->ycoef);
+    __m128i const Y11 = _mm_madd_epi16(_mm_cvtepu16_epi32(_mm_srli_si128(t, 8)), k->ycoef);
+
+    // 4 chroma pairs { v0,u0, v1,u1, v2,u2, v3,u3 } promoted to s16 and centered; one madd per channel
+    // gives the chroma term of each pair, then every term is duplicated for the two pixels that share it
+    __m128i const uv16 = _mm_sub_epi16(_mm_cvtepu8_epi16(uv), _mm_set1_epi16(128));
+    __m128i const tR = _mm_add_epi32(k->rounding, _mm_madd_epi16(uv16, k->rcoef));
+    __m128i const tG = _mm_add_epi32(k->rounding, _mm_madd_epi16(uv16, k->gcoef));
+    __m128i const tB = _mm_add_epi32(k->rounding, _mm_madd_epi16(uv16, k->bcoef));
+    __m128i const R0 = _mm_unpacklo_epi32(tR, tR), R1 = _mm_unpackhi_epi32(tR, tR);
+    __m128i const G0 = _mm_unpacklo_epi32(tG, tG), G1 = _mm_unpackhi_epi32(tG, tG);
+    __m128i const B0 = _mm_unpacklo_epi32(tB, tB), B1 = _mm_unpackhi_epi32(tB, tB);
+
+    // upper 8 pixels
+    store8(out0, narrow(_mm_add_epi32(R0, Y00), _mm_add_epi32(R1, Y01)),
+                 narrow(_mm_add_epi32(G0, Y00), _mm_add_epi32(G1, Y01)),
+                 narrow(_mm_add_epi32(B0, Y00), _mm_add_epi32(B1, Y01)), k->alpha, format);
+    // lower 8 pixels
+    store8(out1, narrow(_mm_add_epi32(R0, Y10), _mm_add_epi32(R1, Y11)),
+                 narrow(_mm_add_epi32(G0, Y10), _mm_add_epi32(G1, Y11)),
+                 narrow(_mm_add_epi32(B0, Y10), _mm_add_epi32(B1, Y11)), k->alpha, format);
+}
+
+int convertYUV420_NV21toRGB8888_SSE41(const unsigned char * data, int * pixels, int width, int height)
+{
+    return convertYUV420_NV21toRGB8888_SSE41_Rows(data, pixels, width, height, 0, height/2);
+}
+
+int convertYUV420_NV21toRGB8888_SSE41_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    yuvImage img;
+
+    return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) &&
+           convertYUV420toFormat_SSE41_Rows(&img, pixels, YUV_OUT_INT8888, pair0, pair1);
+}
+
+// Row pairs [pair0, pair1) in one output format (a constant at every call): one loop per layout and format
+static SSE41 inline __attribute__((always_inline)) void rowPairs8(const yuvImage *img, unsigned char * out, int const format,
+                                                                 int pair0, int pair1, int layout, const x86Consts *k)
+{
+    int const bpp = YUV_OUT_BYTES(format);
+    int const width = img->width;
+    int i, j;
+
+    for (j=pair0; j < pair1; j++) {
+        const unsigned char *y0 = img->y.data + 2*j*img->y.rowStride;
+        const unsigned char *y1 = y0 + img->y.rowStride;
+        unsigned char *out0 = out + 2*j*width*bpp;
+        unsigned char *out1 = out0 + width*bpp;
+
+        if (layout == YUV_CHROMA_PLANAR) {
+            // 4 V and 4 U interleaved as the pairs of NV21
+            const unsigned char *u = img->u.data + j*img->u.rowStride;
+            const unsigned char *v = img->v.data + j*img->v.rowStride;
+            for (i=0; i+8 <= width; i+=8)
+                block8(y0+i, y1+i, _mm_unpacklo_epi8(load4(v+i/2), load4(u+i/2)), out0+i*bpp, out1+i*bpp, k, format);
+        } else {
+            // 4 interleaved pairs (NV21, or NV12 with the swapped coefficients)
+            const unsigned char *uv = (layout == YUV_CHROMA_VU ? img->v.data : img->u.data) + j*img->u.rowStride;
+            for (i=0; i+8 <= width; i+=8)
+                block8(y0+i, y1+i, _mm_loadl_epi64((const __m128i *)(uv+i)), out0+i*bpp, out1+i*bpp, k, format);
+        }
+    }
+}
+
+// Row pairs [pair0, pair1) of any descriptor with a SIMD layout
+SSE41 int convertYUV420toFormat_SSE41_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+{
+    int const layout = yuvChromaLayout(img);
+    int const width = img->width;
+    x86Consts k;
+
+    if (!out || !YUV_OUT_VALID(format) || !yuvImageCheck(img, pair0, pair1) || layout == YUV_CHROMA_OTHER)
+        return 0;
+    loadConsts(&k, yuvGetCoefs(), layout == YUV_CHROMA_UV);
+
+    switch (format) {
+        case YUV_OUT_BGRA8888: rowPairs8(img, out, YUV_OUT_BGRA8888, pair0, pair1, layout, &k); break;
+        case YUV_OUT_RGB565:   rowPairs8(img, out, YUV_OUT_RGB565, pair0, pair1, layout, &k); break;
+        case YUV_OUT_RGB888:   rowPairs8(img, out, YUV_OUT_RGB888, pair0, pair1, layout, &k); break;
+        default:               rowPairs8(img, out, YUV_OUT_RGBA8888, pair0, pair1, layout, &k); break;
+    }
+    // scalar tail: width not multiple of 8
+    if (width&7)
+        convertYUV420toFormatTile(img, out, format, pair0, pair1, width&~7, width);
+    return 1;
+}
+
+// Convert the first n&~7 pixels of a YUV 4:4:4 row (one U and V per pixel) in the output format (a constant at
+// every call); returns how many were converted
+static SSE41 inline __attribute__((always_inline)) int row444(const unsigned char * y, const unsigned char * u, const unsigned char * v,
+                                                             unsigned char * out, int const format, int n, const x86Consts *kp)
+{
+    x86Consts const k = *kp;
+    int i;
+
+    for (i=0; i+8 <= n; i+=8, out+=8*YUV_OUT_BYTES(format)) {
+        __m128i const t = _mm_cvtepu8_epi16(_mm_subs_epu8(_mm_loadl_epi64((const __m128i *)(y+i)), k.yoff));
+        __m128i const Y0 = _mm_madd_epi16(_mm_cvtepu16_epi32(t), k.ycoef);
+        __m128i const Y1 = _mm_madd_epi16(_mm_cvtepu16_epi32(_mm_srli_si128(t, 8)), k.ycoef);
+
+        // 8 vu pairs { v0,u0, v1,u1, ... } (one per pixel) promoted to s16 and centered, 4 per madd
+        __m128i const uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v+i)), _mm_loadl_epi64((const __m128i *)(u+i)));
+        __m128i const uv0 = _mm_sub_epi16(_mm_cvtepu8_epi16(uv), _mm_set1_epi16(128));
+        __m128i const uv1 = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(uv, 8)), _mm_set1_epi16(128));
+
+        store8(out, narrow(_mm_add_epi32(_mm_add_epi32(k.rounding, _mm_madd_epi16(uv0, k.rcoef)), Y0),
+                           _mm_add_epi32(_mm_add_epi32(k.rounding, _mm_madd_epi16(uv1, k.rcoef)), Y1)),
+                    narrow(_mm_add_epi32(_mm_add_epi32(k.rounding, _mm_madd_epi16(uv0, k.gcoef)), Y0),
+                           _mm_add_epi32(_mm_add_epi32(k.rounding, _mm_madd_epi16(uv1, k.gcoef)), Y1)),
+                    narrow(_mm_add_epi32(_mm_add_epi32(k.rounding, _mm_madd_epi16(uv0, k.bcoef)), Y0),
+                           _mm_add_epi32(_mm_add_epi32(k.rounding, _mm_madd_epi16(uv1, k.bcoef)), Y1)), k.alpha, format);
+    }
+    return i;
+}
+
+SSE41 int convertYUV444toFormatRow_SSE41(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n)
+{
+    x86Consts k;
+
+    loadConsts(&k, yuvGetCoefs(), 0);
+    switch (format) {
+        case YUV_OUT_BGRA8888: return row444(y, u, v, out, YUV_OUT_BGRA8888, n, &k);
+        case YUV_OUT_RGB565:   return row444(y, u, v, out, YUV_OUT_RGB565, n, &k);
+        case YUV_OUT_RGB888:   return row444(y, u, v, out, YUV_OUT_RGB888, n, &k);
+        default:               return row444(y, u, v, out, YUV_OUT_RGBA8888, n, &k);
+    }
+}
+
+// grey = [128 + ycoef*Y'] >> 8 = Y' + ([128 + r*Y'] >> 8) with ycoef = 256 + r, all in 16 bits
+// (see the NEON version), for the 16 Y values at y
+static SSE41 inline __m128i grey16(const unsigned char *y, __m128i yoff, __m128i r, __m128i rounding)
+{
+    __m128i const ys = _mm_subs_epu8(_mm_loadu_si128((const __m128i *)y), yoff);
+    __m128i const lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_cvtepu8_epi16(ys), r), rounding), 8);
+    __m128i const hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(ys, _mm_setzero_si128()), r), rounding), 8);
+
+    return _mm_adds_epu8(ys, _mm_packus_epi16(lo, hi));
+}
+
+// Grey level of the first n&~15 Y values, replicated in R, G and B; returns how many were converted
+SSE41 int convertYtoGREY8888Row_SSE41(const unsigned char * y, int * pixels, int n)
+{
+    const yuvCoefs *c = yuvGetCoefs();
+    unsigned char *out = (unsigned char *) pixels;
+    int i;
+
+    if (c->ycoef < 256 || c->ycoef > 511)
+        return 0;
+    __m128i const yoff = _mm_set1_epi8((char)c->yoff);
+    __m128i const r = _mm_set1_epi16((short)(c->ycoef - 256));
+    __m128i const rounding = _mm_set1_epi16(128);
+    __m128i const alpha = _mm_set1_epi8((char)0xff);
+
+    for (i=0; i+16 <= n; i+=16, out+=16*4) {
+        __m128i const g = grey16(y+i, yoff, r, rounding);
+        // byte replicate: (g g) and (g 0xff) pairs interleaved give g g g 0xff for every pixel
+        __m128i const gg0 = _mm_unpacklo_epi8(g, g), gg1 = _mm_unpackhi_epi8(g, g);
+        __m128i const ga0 = _mm_unpacklo_epi8(g, alpha), ga1 = _mm_unpackhi_epi8(g, alpha);
+
+        _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi16(gg0, ga0));
+        _mm_storeu_si128((__m128i *)(out+16), _mm_unpackhi_epi16(gg0, ga0));
+        _mm_storeu_si128((__m128i *)(out+32), _mm_unpacklo_epi16(gg1, ga1));
+        _mm_storeu_si128((__m128i *)(out+48), _mm_unpackhi_epi16(gg1, ga1));
+    }
+    return i;
+}
+
+// Same, with one byte per pixel
+SSE41 int convertYtoGREY8Row_SSE41(const unsigned char * y, unsigned char * grey, int n)
+{
+    const yuvCoefs *c = yuvGetCoefs();
+    int i;
+
+    if (c->ycoef < 256 || c->ycoef > 511)
+        return 0;
+    __m128i const yoff = _mm_set1_epi8((char)c->yoff);
+    __m128i const r = _mm_set1_epi16((short)(c->ycoef - 256));
+    __m128i const rounding = _mm_set1_epi16(128);
+
+    for (i=0; i+16 <= n; i+=16)
+        _mm_storeu_si128((__m128i *)(grey+i), grey16(y+i, yoff, r, rounding));
+    return i;
+}
+
+int convertYUV420_NV21toGREY8888_SSE41(const unsigned char * data, int * pixels, int width, int height)
+{
+    return convertYUV420_NV21toGREY8888_SSE41_Rows(data, pixels, width, height, 0, height/2);
+}
+
+int convertYUV420_NV21toGREY8888_SSE41_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    // pre-condition : width and height must be even, the row pairs inside the image
+    if (0!=(width&1) || width<2 || 0!=(height&1) || height<2 || pair0<0 || pair1<pair0 || pair1>height/2 || !pixels || !data)
+        return 0;
+
+    // only the Y plane is read; the rows of the band are contiguous, so they are converted as one long row
+    int const first = 2*pair0*width;
+    int const n = 2*(pair1-pair0)*width;
+    int const done = convertYtoGREY8888Row_SSE41(data+first, pixels+first, n);
+
+    if (done < n)       // scalar tail (lookup table)
+        convertYtoGREY8888Row(data+first+done, pixels+first+done, n-done);
+    return 1;
+}
+
+// 8 pixels of one channel (32-bit, in lane order) x 2 --> 16 pixels in u16, in pixel order
+static AVX2 inline __m256i narrow16(__m256i lo, __m256i hi)
+{
+    return _mm256_srli_epi16(_mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8), 8);
+}
+
+// Store 16 pixels of R, G, B (u16) in the output format (a constant at every call), as store8
+static AVX2 inline __attribute__((always_inline)) void store16(unsigned char *out, __m256i r, __m256i g, __m256i b,
+                                                              __m256i alpha, int const format)
+{
+    if (format == YUV_OUT_RGB565) {
+        __m256i const rb = _mm256_or_si256(_mm256_slli_epi16(_mm256_srli_epi16(r, 3), 11), _mm256_srli_epi16(b, 3));
+        _mm256_storeu_si256((__m256i *)out, _mm256_or_si256(rb, _mm256_slli_epi16(_mm256_srli_epi16(g, 2), 5)));
+        return;
+    }
+    if (format == YUV_OUT_RGB888) {     // two 128-bit halves of 8 pixels, 24 bytes each
+        store8(out, _mm256_castsi256_si128(r), _mm256_castsi256_si128(g), _mm256_castsi256_si128(b),
+               _mm256_castsi256_si128(alpha), format);
+        store8(out+24, _mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1), _mm256_extracti128_si256(b, 1),
+               _mm256_castsi256_si128(alpha), format);
+        return;
+    }
+    if (format == YUV_OUT_BGRA8888) {
+        __m256i const t = r;
+        r = b;
+        b = t;
+    }
+    __m256i const rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+    __m256i const ba = _mm256_or_si256(b, alpha);
+    __m256i const lo = _mm256_unpacklo_epi16(rg, ba);     // pixels 0-3 | 8-11
+    __m256i const hi = _mm256_unpackhi_epi16(rg, ba);     // pixels 4-7 | 12-15
+
+    _mm256_storeu_si256((__m256i *)out, _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *)(out+32), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+int convertYUV420_NV21toRGB8888_AVX2(const unsigned char * data, int * pixels, int width, int height)
+{
+    return convertYUV420_NV21toRGB8888_AVX2_Rows(data, pixels, width, height, 0, height/2);
+}
+
+int convertYUV420_NV21toRGB8888_AVX2_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    yuvImage img;
+
+    return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) &&
+           convertYUV420toFormat_AVX2_Rows(&img, pixels, YUV_OUT_INT8888, pair0, pair1);
+}
+
+typedef struct avx2Consts {
+    __m256i yoff;
+    __m256i ycoef;
+    __m256i rcoef;
+    __m256i gcoef;
+    __m256i bcoef;
+    __m256i rounding;
+    __m256i half;
+    __m256i alpha;
+} avx2Consts;
+
+// Convert 16 pixels of two rows (y0, y1 --> out0, out1) that share the 8 chroma pairs of uv
+static AVX2 inline __attribute__((always_inline)) void block16(const unsigned char *y0, const unsigned char *y1, __m128i uv,
+                                                              unsigned char *out0, unsigned char *out1, const avx2Consts *k,
+                                                              int const format)
+{
+    // 16 Y values of each row minus offset, zero-extended to 32 bits (8 per register), times ycoef
+    __m128i t = _mm_subs_epu8(_mm_loadu_si128((const __m128i *)y0), _mm256_castsi256_si128(k->yoff));
+    __m256i const Y00 = _mm256_madd_epi16(_mm256_cvtepu8_epi32(t), k->ycoef);
+    __m256i const Y01 = _mm256_madd_epi16(_mm256_cvtepu8_epi32(_mm_srli_si128(t, 8)), k->ycoef);
+    t = _mm_subs_epu8(_mm_loadu_si128((const __m128i *)y1), _mm256_castsi256_si128(k->yoff));
+    __m256i const Y10 = _mm256_madd_epi16(_mm256_cvtepu8_epi32(t), k->ycoef);
+    __m256i const Y11 = _mm256_madd_epi16(_mm256_cvtepu8_epi32(_mm_srli_si128(t, 8)), k->ycoef);
+
+    // 8 vu pairs: chroma term of each pair (pairs 0-3 | 4-7), duplicated for its two pixels
+    __m256i const uv16 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(uv), k->half);
+    __m256i const tR = _mm256_add_epi32(k->rounding, _mm256_madd_epi16(uv16, k->rcoef));
+    __m256i const tG = _mm256_add_epi32(k->rounding, _mm256_madd_epi16(uv16, k->gcoef));
+    __m256i const tB = _mm256_add_epi32(k->rounding, _mm256_madd_epi16(uv16, k->bcoef));
+    __m256i const rl = _mm256_unpacklo_epi32(tR, tR), rh = _mm256_unpackhi_epi32(tR, tR);
+    __m256i const gl = _mm256_unpacklo_epi32(tG, tG), gh = _mm256_unpackhi_epi32(tG, tG);
+    __m256i const bl = _mm256_unpacklo_epi32(tB, tB), bh = _mm256_unpackhi_epi32(tB, tB);
+    __m256i const R0 = _mm256_permute2x128_si256(rl, rh, 0x20), R1 = _mm256_permute2x128_si256(rl, rh, 0x31);
+    __m256i const G0 = _mm256_permute2x128_si256(gl, gh, 0x20), G1 = _mm256_permute2x128_si256(gl, gh, 0x31);
+    __m256i const B0 = _mm256_permute2x128_si256(bl, bh, 0x20), B1 = _mm256_permute2x128_si256(bl, bh, 0x31);
+
+    // upper 16 pixels
+    store16(out0, narrow16(_mm256_add_epi32(R0, Y00), _mm256_add_epi32(R1, Y01)),
+                  narrow16(_mm256_add_epi32(G0, Y00), _mm256_add_epi32(G1, Y01)),
+                  narrow16(_mm256_add_epi32(B0, Y00), _mm256_add_epi32(B1, Y01)), k->alpha, format);
+    // lower 16 pixels
+    store16(out1, narrow16(_mm256_add_epi32(R0, Y10), _mm256_add_epi32(R1, Y11)),
+                  narrow16(_mm256_add_epi32(G0, Y10), _mm256_add_epi32(G1, Y11)),
+                  narrow16(_mm256_add_epi32(B0, Y10), _mm256_add_epi32(B1, Y11)), k->alpha, format);
+}
+
+// AVX2 version of rowPairs8: 16 pixels per block, and one block of 8 when width&15 >= 8
+static AVX2 inline __attribute__((always_inline)) void rowPairs16(const yuvImage *img, unsigned char * out, int const format,
+                                                                 int pair0, int pair1, int layout,
+                                                                 const x86Consts *k, const avx2Consts *k2)
+{
+    int const bpp = YUV_OUT_BYTES(format);
+    int const width = img->width;
+    int i, j;
+
+    for (j=pair0; j < pair1; j++) {
+        const unsigned char *y0 = img->y.data + 2*j*img->y.rowStride;
+        const unsigned char *y1 = y0 + img->y.rowStride;
+        unsigned char *out0 = out + 2*j*width*bpp;
+        unsigned char *out1 = out0 + width*bpp;
+
+        if (layout == YUV_CHROMA_PLANAR) {
+            // 8 V and 8 U interleaved as the pairs of NV21
+            const unsigned char *u = img->u.data + j*img->u.rowStride;
+            const unsigned char *v = img->v.data + j*img->v.rowStride;
+            for (i=0; i+16 <= width; i+=16)
+                block16(y0+i, y1+i, _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v+i/2)), _mm_loadl_epi64((const __m128i *)(u+i/2))),
+                        out0+i*bpp, out1+i*bpp, k2, format);
+            if (i+8 <= width)
+                block8(y0+i, y1+i, _mm_unpacklo_epi8(load4(v+i/2), load4(u+i/2)), out0+i*bpp, out1+i*bpp, k, format);
+        } else {
+            // interleaved pairs (NV21, or NV12 with the swapped coefficients)
+            const unsigned char *uv = (layout == YUV_CHROMA_VU ? img->v.data : img->u.data) + j*img->u.rowStride;
+            for (i=0; i+16 <= width; i+=16)
+                block16(y0+i, y1+i, _mm_loadu_si128((const __m128i *)(uv+i)), out0+i*bpp, out1+i*bpp, k2, format);
+            if (i+8 <= width)
+                block8(y0+i, y1+i, _mm_loadl_epi64((const __m128i *)(uv+i)), out0+i*bpp, out1+i*bpp, k, format);
+        }
+    }
+}
+
+AVX2 int convertYUV420toFormat_AVX2_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+{
+    const yuvCoefs *c = yuvGetCoefs();
+    int const layout = yuvChromaLayout(img);
+    int const width = img->width;
+    x86Consts k;
+    avx2Consts k2;
+
+    if (!out || !YUV_OUT_VALID(format) || !yuvImageCheck(img, pair0, pair1) || layout == YUV_CHROMA_OTHER)
+        return 0;
+    loadConsts(&k, c, layout == YUV_CHROMA_UV);
+
+    k2.yoff = _mm256_set1_epi8((char)c->yoff);
+    k2.ycoef = _mm256_broadcastsi128_si256(k.ycoef);
+    k2.rcoef = _mm256_broadcastsi128_si256(k.rcoef);
+    k2.gcoef = _mm256_broadcastsi128_si256(k.gcoef);
+    k2.bcoef = _mm256_broadcastsi128_si256(k.bcoef);
+    k2.rounding = _mm256_set1_epi32(128);
+    k2.half = _mm256_set1_epi16(128);
+    k2.alpha = _mm256_set1_epi16((short)0xff00);
+
+    switch (format) {
+        case YUV_OUT_BGRA8888: rowPairs16(img, out, YUV_OUT_BGRA8888, pair0, pair1, layout, &k, &k2); break;
+        case YUV_OUT_RGB565:   rowPairs16(img, out, YUV_OUT_RGB565, pair0, pair1, layout, &k, &k2); break;
+        case YUV_OUT_RGB888:   rowPairs16(img, out, YUV_OUT_RGB888, pair0, pair1, layout, &k, &k2); break;
+        default:               rowPairs16(img, out, YUV_OUT_RGBA8888, pair0, pair1, layout, &k, &k2); break;
+    }
+    // scalar tail: width not multiple of 8
+    if (width&7)
+        convertYUV420toFormatTile(img, out, format, pair0, pair1, width&~7, width);
+    return 1;
+}
+
+#else
+// Not an x86 build
+
+int convertYUV420_NV21toRGB8888_SSE41(const unsigned char * data, int * pixels, int width, int height)
+{
+    return 0;
+}
+
+int convertYUV420_NV21toRGB8888_AVX2(const unsigned char * data, int * pixels, int width, int height)
+{
+    return 0;
+}
+
+int convertYUV420_NV21toRGB8888_SSE41_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    return 0;
+}
+
+int convertYUV444toFormatRow_SSE41(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n)
+{
+    return 0;
+}
+
+int convertYtoGREY8888Row_SSE41(const unsigned char * y, int * pixels, int n)
+{
+    return 0;
+}
+
+int convertYtoGREY8Row_SSE41(const unsigned char * y, unsigned char * grey, int n)
+{
+    return 0;
+}
+
+int convertYUV420_NV21toGREY8888_SSE41(const unsigned char * data, int * pixels, int width, int height)
+{
+    return 0;
+}
+
+int convertYUV420_NV21toGREY8888_SSE41_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    return 0;
+}
+
+int convertYUV420_NV21toRGB8888_AVX2_Rows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    return 0;
+}
+
+int convertYUV420toFormat_SSE41_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+{
+    return 0;
+}
+
+int convertYUV420toFormat_AVX2_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+{
+    return 0;
+}
+#endif
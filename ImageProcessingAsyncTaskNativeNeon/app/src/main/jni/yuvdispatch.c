@@ -0,0 +1,292 @@
+//
+// Runtime selection of the fastest SIMD kernel for the CPU we are running on.
+// The CPU is inspected once (CPUID on x86, AT_HWCAP on ARM) and the kernels are
+// chosen through function pointers, so the same library runs on every device.
+//
+
+#include <pthread.h>
+#include "workerpool.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__arm__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+
+// smallest chunk of row pairs of the parallel SIMD conversion (workerPoolRunRange): the pool threads claim
+// chunks on demand, so the big cores convert more rows than the LITTLE ones
+#define MIN_CHUNK_PAIRS 4
+
+typedef int (*yuvRowsKernel)(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1);
+typedef int (*yuvRow444Kernel)(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n);
+typedef int (*yuvGrey8RowKernel)(const unsigned char * y, unsigned char * grey, int n);
+typedef int (*yuvPlanesKernel)(const yuvImage *img, void * out, int format, int pair0, int pair1);
+
+static pthread_once_t dispatchOnce = PTHREAD_ONCE_INIT;
+static int cpuFeatures;
+static yuvRowsKernel rgbKernel;     // NULL if there is no SIMD kernel for this CPU
+static yuvRowsKernel greyKernel;
+static yuvRow444Kernel row444Kernel;
+static yuvGrey8RowKernel grey8Kernel;
+static yuvPlanesKernel planesKernel;
+static const char *simdName = "none";
+
+static int detectCPUFeatures(void)
+{
+    int features = 0;
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    if (ecx & bit_SSE4_1)
+        features |= YUV_CPU_SSE41;
+    // AVX2 also needs the OS to save the YMM registers (OSXSAVE and XCR0 bits 1-2)
+    if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX) && __get_cpuid_max(0, NULL) >= 7) {
+        unsigned int xcr0lo, xcr0hi;
+        __asm__ volatile ("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if ((xcr0lo & 6) == 6 && (ebx & bit_AVX2))
+            features |= YUV_CPU_AVX2;
+    }
+#elif defined(__arm__)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON)     // some ARMv7 cores (e.g. Tegra 2) have no NEON
+        features |= YUV_CPU_NEON;
+#elif defined(__aarch64__)
+    features |= YUV_CPU_NEON;                 // Advanced SIMD is mandatory in ARMv8-A
+#endif
+    return features;
+}
+
+static void selectKernels(void)
+{
+    cpuFeatures = detectCPUFeatures();
+    if (cpuFeatures & YUV_CPU_NEON) {
+#if defined(__aarch64__)
+        rgbKernel = convertYUV420_NV21toRGB8888_NEON64_Rows;
+        planesKernel = convertYUV420toFormat_NEON64_Rows;
+#else
+        rgbKernel = convertYUV420_NV21toRGB8888_NEON_Rows;
+        planesKernel = convertYUV420toFormat_NEON_Rows;
+#endif
+        greyKernel = convertYUV420_NV21toGREY8888_NEON_Rows;
+        row444Kernel = convertYUV444toFormatRow_NEON;
+        grey8Kernel = convertYtoGREY8Row_NEON;
+        simdName = "NEON";
+    } else if (cpuFeatures & YUV_CPU_AVX2) {
+        rgbKernel = convertYUV420_NV21toRGB8888_AVX2_Rows;
+        planesKernel = convertYUV420toFormat_AVX2_Rows;
+        greyKernel = convertYUV420_NV21toGREY8888_SSE41_Rows;   // grey is bound by the stores: SSE4.1 is enough
+        row444Kernel = convertYUV444toFormatRow_SSE41;         // 8 pixels per row chunk: SSE4.1 is enough
+        grey8Kernel = convertYtoGREY8Row_SSE41;
+        simdName = "AVX2";
+    } else if (cpuFeatures & YUV_CPU_SSE41) {
+        rgbKernel = convertYUV420_NV21toRGB8888_SSE41_Rows;
+        planesKernel = convertYUV420toFormat_SSE41_Rows;
+        greyKernel = convertYUV420_NV21toGREY8888_SSE41_Rows;
+        row444Kernel = convertYUV444toFormatRow_SSE41;
+        grey8Kernel = convertYtoGREY8Row_SSE41;
+        simdName = "SSE4.1";
+    }
+}
+
+void yuvDispatchInit(void)
+{
+    pthread_once(&dispatchOnce, selectKernels);
+}
+
+int yuvCPUFeatures(void)
+{
+    yuvDispatchInit();
+    return cpuFeatures;
+}
+
+int yuvHasNEON(void)
+{
+    return (yuvCPUFeatures() & YUV_CPU_NEON) != 0;
+}
+
+int yuvHasSIMD(void)
+{
+    yuvDispatchInit();
+    return rgbKernel != NULL;
+}
+
+const char *yuvSIMDName(void)
+{
+    yuvDispatchInit();
+    return simdName;
+}
+
+int convertYUV420_NV21toRGB8888_SIMD(const unsigned char * data, int * pixels, int width, int height)
+{
+    yuvDispatchInit();
+    if (rgbKernel && rgbKernel(data, pixels, width, height, 0, height/2))
+        return 1;
+    convertYUV420_NV21toRGB8888(data, pixels, width, height);     // no SIMD kernel or unsupported frame size
+    return 0;
+}
+
+int convertYUV420_NV21toRGB8888_SIMDRows(const unsigned char * data, int * pixels, int width, int height, int pair0, int pair1)
+{
+    yuvDispatchInit();
+    if (rgbKernel && rgbKernel(data, pixels, width, height, pair0, pair1))
+        return 1;
+    convertYUV420_NV21toRGB8888Tile(data, pixels, width, height, pair0, pair1, 0, width);
+    return 0;
+}
+
+int convertYUV420_NV21toGREY8888_SIMD(const unsigned char * data, int * pixels, int width, int height)
+{
+    yuvDispatchInit();
+    if (greyKernel && greyKernel(data, pixels, width, height, 0, height/2))
+        return 1;
+    convertYUV420_NV21toGREY8888(data, pixels, width, height);
+    return 0;
+}
+
+int convertYUV420_NV21toGREY8_SIMD(const unsigned char * data, unsigned char * grey, int width, int height)
+{
+    int const n = width*height;
+    int done = 0;
+
+    yuvDispatchInit();
+    if (grey8Kernel)
+        done = grey8Kernel(data, grey, n);     // the Y plane is one long row
+    if (done < n)
+        convertYtoGREY8Row(data+done, grey+done, n-done);
+    return done > 0;
+}
+
+void convertYUV444toFormatRow_SIMD(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n)
+{
+    int done = 0;
+
+    yuvDispatchInit();
+    if (row444Kernel)
+        done = row444Kernel(y, u, v, out, format, n);
+    if (done < n)
+        convertYUV444toFormatRow(y+done, u+done, v+done, (unsigned char *)out + done*YUV_OUT_BYTES(format), format, n-done);
+}
+
+void convertYUV444toRGB8888Row_SIMD(const unsigned char * y, const unsigned char * u, const unsigned char * v, int * pixels, int n)
+{
+    convertYUV444toFormatRow_SIMD(y, u, v, pixels, YUV_OUT_INT8888, n);
+}
+
+typedef struct simdBands {   // operands of the parallel SIMD conversion, shared by all the bands
+    yuvRowsKernel kernel;
+    const unsigned char * data;
+    int * pixels;
+    int width;
+    int height;
+} simdBands;
+
+// Worker pool task: the row pairs [pair0, pair1)
+static void simdBand(void *args, int pair0, int pair1)
+{
+    const simdBands *p = (const simdBands *)args;
+
+    p->kernel(p->data, p->pixels, p->width, p->height, pair0, pair1);
+}
+
+static int runSIMDBands(yuvRowsKernel kernel, const unsigned char * data, int * pixels, int width, int height)
+{
+    simdBands p;
+
+    // checks the frame once (an empty band is always accepted by the kernels)
+    if (!kernel || !kernel(data, pixels, width, height, 0, 0))
+        return 0;
+    p.kernel = kernel;
+    p.data = data;
+    p.pixels = pixels;
+    p.width = width;
+    p.height = height;
+    workerPoolRunRange(simdBand, (void *)&p, height/2, MIN_CHUNK_PAIRS);
+    return 1;
+}
+
+int convertYUV420_NV21toRGB8888_SIMDParallel(const unsigned char * data, int * pixels, int width, int height)
+{
+    yuvDispatchInit();
+    if (runSIMDBands(rgbKernel, data, pixels, width, height))
+        return 1;
+    convertYUV420_NV21toRGB8888Pool(data, pixels, width, height);    // no SIMD kernel or unsupported frame size
+    return 0;
+}
+
+int convertYUV420_NV21toGREY8888_SIMDParallel(const unsigned char * data, int * pixels, int width, int height)
+{
+    yuvDispatchInit();
+    if (runSIMDBands(greyKernel, data, pixels, width, height))
+        return 1;
+    convertYUV420_NV21toGREY8888Pool(data, pixels, width, height);
+    return 0;
+}
+
+// Scalar kernel of the plane descriptors, with the signature of the SIMD ones
+static int planesScalarRows(const yuvImage *img, void * out, int format, int pair0, int pair1)
+{
+    if (!out || !YUV_OUT_VALID(format) || !yuvImageCheck(img, pair0, pair1))
+        return 0;
+    convertYUV420toFormatTile(img, out, format, pair0, pair1, 0, img->width);
+    return 1;
+}
+
+// SIMD kernel for the layout of img, scalar if there is none
+static yuvPlanesKernel planesKernelFor(const yuvImage *img)
+{
+    yuvDispatchInit();
+    return planesKernel && yuvChromaLayout(img) != YUV_CHROMA_OTHER ? planesKernel : planesScalarRows;
+}
+
+int convertYUV420toFormat_SIMD(const yuvImage *img, void * out, int format)
+{
+    int const pairs = img->height/2;
+
+    return planesKernelFor(img)(img, out, format, 0, pairs) || planesScalarRows(img, out, format, 0, pairs);
+}
+
+typedef struct planesBands {   // operands of the parallel conversion of a descriptor
+    yuvPlanesKernel kernel;
+    const yuvImage * img;
+    void * out;
+    int format;
+} planesBands;
+
+static void planesBand(void *args, int pair0, int pair1)
+{
+    const planesBands *p = (const planesBands *)args;
+
+    if (!p->kernel(p->img, p->out, p->format, pair0, pair1))
+        planesScalarRows(p->img, p->out, p->format, pair0, pair1);     // coefficients the SIMD kernel cannot take
+}
+
+int convertYUV420toFormat_SIMDParallel(const yuvImage *img, void * out, int format)
+{
+    planesBands p;
+
+    if (!out || !YUV_OUT_VALID(format) || !yuvImageCheck(img, 0, img->height/2))
+        return 0;
+    p.kernel = planesKernelFor(img);
+    p.img = img;
+    p.out = out;
+    p.format = format;
+    workerPoolRunRange(planesBand, (void *)&p, img->height/2, MIN_CHUNK_PAIRS);
+    return 1;
+}
+
+int convertYUV420toRGB8888_SIMD(const yuvImage *img, int * pixels)
+{
+    return convertYUV420toFormat_SIMD(img, pixels, YUV_OUT_INT8888);
+}
+
+int convertYUV420toRGB8888_SIMDParallel(const yuvImage *img, int * pixels)
+{
+    return convertYUV420toFormat_SIMDParallel(img, pixels, YUV_OUT_INT8888);
+}
@@ -0,0 +1,335 @@
+//
+// Convolution engine on the luma plane (see yuvfilter.h): band driver, sliding window of input
+// rows, scalar row kernels and selection of the SIMD row kernels (NEON in yuvfilter_neon.c,
+// SSE4.1 in yuvfilter_x86.c).
+//
+
+#include <string.h>
+#include <pthread.h>
+#include "framearena.h"
+#include "workerpool.h"
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+#include "yuvfilter.h"
+
+#define PAD 2                   // replicated border columns on each side of a window row (radius of 5x5)
+
+// bytes of one window row in the scratch buffer ({h, d, p}), rounded to keep every row 16-byte aligned
+#define WINDOW_ROW_BYTES(width) ((2*(width)*sizeof(short) + (width) + 2*PAD + 15) & ~(size_t)15)
+
+typedef struct filterKernels {  // row kernels of the running CPU
+    int (*h121)(const unsigned char * p, unsigned short * h, int x0, int x1);
+    int (*h14641)(const unsigned char * p, unsigned short * h, int x0, int x1);
+    int (*hsobel)(const unsigned char * p, unsigned short * h, short * d, int x0, int x1);
+    int (*v121)(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                unsigned char * out, int x0, int x1);
+    int (*v14641)(const unsigned short * const * h, unsigned char * out, int x0, int x1);
+    int (*vsobel)(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                  const short * d2, unsigned char * out, int x0, int x1);
+    int (*conv)(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                unsigned char * out, int x0, int x1);
+} filterKernels;
+
+typedef struct windowRow {      // one input row of the sliding window
+    unsigned char * p;          // padded copy of the luma row (p[-PAD] .. p[width+PAD-1])
+    unsigned short * h;         // horizontal pass of the separable filters
+    short * d;                  // horizontal derivative (Sobel)
+} windowRow;
+
+typedef struct filterJob {      // operands shared by all the bands of a frame
+    const unsigned char * luma;
+    int width;
+    int height;
+    int filter;
+    const short * kernel;
+    int ksize;                  // 3 or 5
+    int shift;
+    int threshold;
+    void * out;
+    int outFormat;
+    unsigned char * scratch;    // scratchSize bytes per band
+    size_t scratchSize;
+} filterJob;
+
+// Scalar row kernels (same contract as the SIMD ones, they always finish the row)
+
+static int rowH121(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x < x1; x++)
+        h[x] = (unsigned short)(p[x-1] + 2*p[x] + p[x+1]);
+    return x1;
+}
+
+static int rowH14641(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x < x1; x++)
+        h[x] = (unsigned short)(p[x-2] + 4*(p[x-1] + p[x+1]) + 6*p[x] + p[x+2]);
+    return x1;
+}
+
+static int rowHsobel(const unsigned char * p, unsigned short * h, short * d, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x < x1; x++) {
+        h[x] = (unsigned short)(p[x-1] + 2*p[x] + p[x+1]);
+        d[x] = (short)(p[x+1] - p[x-1]);
+    }
+    return x1;
+}
+
+static int rowV121(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                   unsigned char * out, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x < x1; x++)
+        out[x] = (unsigned char)((h0[x] + 2*h1[x] + h2[x] + 8) >> 4);
+    return x1;
+}
+
+static int rowV14641(const unsigned short * const * h, unsigned char * out, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x < x1; x++)
+        out[x] = (unsigned char)((h[0][x] + 4*(h[1][x] + h[3][x]) + 6*h[2][x] + h[4][x] + 128) >> 8);
+    return x1;
+}
+
+static int rowVsobel(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                     const short * d2, unsigned char * out, int x0, int x1)
+{
+    int x, gx, gy, m;
+
+    for (x=x0; x < x1; x++) {
+        gx = d0[x] + 2*d1[x] + d2[x];
+        gy = h2[x] - h0[x];
+        m = (gx < 0 ? -gx : gx) + (gy < 0 ? -gy : gy);
+        out[x] = (unsigned char)(m > 255 ? 255 : m);
+    }
+    return x1;
+}
+
+static int rowConv(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                   unsigned char * out, int x0, int x1)
+{
+    int const r = ksize/2;
+    int const rounding = shift > 0 ? 1 << (shift-1) : 0;
+    int x, i, j, sum;
+
+    for (x=x0; x < x1; x++) {
+        sum = rounding;
+        for (i=0; i < ksize; i++)
+            for (j=0; j < ksize; j++)
+                sum += kernel[i*ksize+j]*p[i][x+j-r];
+        out[x] = (unsigned char)yuvClamp255(sum >> shift);
+    }
+    return x1;
+}
+
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+static filterKernels simd;
+
+static void selectFilterKernels(void)
+{
+    int const features = yuvCPUFeatures();
+
+    if (features & YUV_CPU_NEON) {
+        simd.h121 = filterRowH121_NEON;
+        simd.h14641 = filterRowH14641_NEON;
+        simd.hsobel = filterRowHsobel_NEON;
+        simd.v121 = filterRowV121_NEON;
+        simd.v14641 = filterRowV14641_NEON;
+        simd.vsobel = filterRowVsobel_NEON;
+        simd.conv = filterRowConv_NEON;
+    } else if (features & YUV_CPU_SSE41) {
+        simd.h121 = filterRowH121_SSE41;
+        simd.h14641 = filterRowH14641_SSE41;
+        simd.hsobel = filterRowHsobel_SSE41;
+        simd.v121 = filterRowV121_SSE41;
+        simd.v14641 = filterRowV14641_SSE41;
+        simd.vsobel = filterRowVsobel_SSE41;
+        simd.conv = filterRowConv_SSE41;
+    } else {                    // the scalar kernels do the whole row
+        simd.h121 = rowH121;
+        simd.h14641 = rowH14641;
+        simd.hsobel = rowHsobel;
+        simd.v121 = rowV121;
+        simd.v14641 = rowV14641;
+        simd.vsobel = rowVsobel;
+        simd.conv = rowConv;
+    }
+}
+
+// Copy the luma row "row" (clamped to the image: replicated border) into the window row and do its horizontal pass
+static void loadRow(const filterJob *job, windowRow *w, int row)
+{
+    int const width = job->width;
+    int x;
+
+    if (row < 0) row = 0;
+    if (row > job->height-1) row = job->height-1;
+    memcpy(w->p, job->luma + row*width, width);
+    w->p[-2] = w->p[-1] = w->p[0];
+    w->p[width] = w->p[width+1] = w->p[width-1];
+
+    switch (job->filter) {
+        case YUV_FILTER_GAUSS3:
+            x = simd.h121(w->p, w->h, 0, width);
+            rowH121(w->p, w->h, x, width);
+            break;
+        case YUV_FILTER_GAUSS5:
+            x = simd.h14641(w->p, w->h, 0, width);
+            rowH14641(w->p, w->h, x, width);
+            break;
+        case YUV_FILTER_SOBEL:
+            x = simd.hsobel(w->p, w->h, w->d, 0, width);
+            rowHsobel(w->p, w->h, w->d, x, width);
+            break;
+        default:                // generic kernels work on the padded rows
+            break;
+    }
+}
+
+// Vertical pass: output row from the ksize window rows w[0] .. w[ksize-1]
+static void filterRow(const filterJob *job, windowRow * const *w, unsigned char *out)
+{
+    int const width = job->width;
+    const unsigned char *p[5];
+    const unsigned short *h[5];
+    int i, x;
+
+    switch (job->filter) {
+        case YUV_FILTER_GAUSS3:
+            x = simd.v121(w[0]->h, w[1]->h, w[2]->h, out, 0, width);
+            rowV121(w[0]->h, w[1]->h, w[2]->h, out, x, width);
+            break;
+        case YUV_FILTER_GAUSS5:
+            for (i=0; i < 5; i++)
+                h[i] = w[i]->h;
+            x = simd.v14641(h, out, 0, width);
+            rowV14641(h, out, x, width);
+            break;
+        case YUV_FILTER_SOBEL:
+            x = simd.vsobel(w[0]->h, w[2]->h, w[0]->d, w[1]->d, w[2]->d, out, 0, width);
+            rowVsobel(w[0]->h, w[2]->h, w[0]->d, w[1]->d, w[2]->d, out, x, width);
+            break;
+        default:
+            for (i=0; i < job->ksize; i++)
+                p[i] = w[i]->p;
+            x = simd.conv(p, job->ksize, job->kernel, job->shift, out, 0, width);
+            rowConv(p, job->ksize, job->kernel, job->shift, out, x, width);
+            break;
+    }
+}
+
+// Threshold the filtered row and store it in the output format
+static void storeRow(const filterJob *job, unsigned char *row, int y)
+{
+    int const width = job->width;
+    int x;
+
+    if (job->threshold >= 0)
+        for (x=0; x < width; x++)
+            row[x] = row[x] > job->threshold ? 255 : 0;
+    if (job->outFormat == YUV_FILTER_GREY8) {
+        memcpy((unsigned char *)job->out + y*width, row, width);
+    } else {
+        int *pixels = (int *)job->out + y*width;
+        for (x=0; x < width; x++)
+            pixels[x] = 0xff000000 | (row[x]*0x010101);
+    }
+}
+
+// Filter the output rows [row0, row1) with the window rows and output row in scratch
+static void filterRows(const filterJob *job, unsigned char *scratch, int row0, int row1)
+{
+    int const width = job->width;
+    int const k = job->ksize, r = k/2;
+    windowRow rows[5];
+    windowRow *win[5];
+    unsigned char *out;
+    int i, j;
+
+    // scratch: k rows of {h, d, p}, then the output row
+    for (j=0; j < k; j++) {
+        rows[j].h = (unsigned short *)scratch;
+        rows[j].d = (short *)(scratch + width*sizeof(short));
+        rows[j].p = scratch + 2*width*sizeof(short) + PAD;
+        scratch += WINDOW_ROW_BYTES(width);
+    }
+    out = scratch;
+
+    // input row i goes to rows[(i - row0 + r) % k]; once rows i-k+1 .. i are in, output row i-r is ready
+    for (i=row0-r; i < row1+r; i++) {
+        loadRow(job, &rows[(i-row0+r) % k], i);
+        if (i-r < row0)
+            continue;
+        for (j=0; j < k; j++)
+            win[j] = &rows[(i-k+1+j-row0+r) % k];
+        filterRow(job, win, out);
+        storeRow(job, out, i-r);
+    }
+}
+
+// Worker pool task: band "band" out of "nbands" of the output rows
+static void filterBand(void *args, int band, int nbands)
+{
+    const filterJob *job = (const filterJob *)args;
+
+    filterRows(job, job->scratch + band*job->scratchSize,
+               job->height*band/nbands, job->height*(band+1)/nbands);
+}
+
+static int runFilter(const unsigned char * luma, int width, int height, int filter, const short * kernel, int shift,
+                     int threshold, void * out, int outFormat, int parallel)
+{
+    filterJob job;
+    int nbands = 1;
+
+    if (!luma || !out || width < 1 || height < 1 || filter < YUV_FILTER_CONV3 || filter > YUV_FILTER_SOBEL ||
+        ((filter == YUV_FILTER_CONV3 || filter == YUV_FILTER_CONV5) && (!kernel || shift < 0 || shift > 30)) ||
+        threshold < YUV_FILTER_NO_THRESHOLD || threshold > 255 ||
+        (outFormat != YUV_FILTER_GREY8 && outFormat != YUV_FILTER_GREY8888))
+        return 0;
+    pthread_once(&kernelsOnce, selectFilterKernels);
+
+    job.luma = luma;
+    job.width = width;
+    job.height = height;
+    job.filter = filter;
+    job.kernel = kernel;
+    job.ksize = (filter == YUV_FILTER_CONV5 || filter == YUV_FILTER_GAUSS5) ? 5 : 3;
+    job.shift = shift;
+    job.threshold = threshold;
+    job.out = out;
+    job.outFormat = outFormat;
+    job.scratchSize = job.ksize*WINDOW_ROW_BYTES(width) + ((width + 15) & ~(size_t)15);
+    if (parallel)
+        nbands = workerPoolSize() < height ? workerPoolSize() : height;
+    job.scratch = yuvScratch(YUV_SCRATCH_FILTER, nbands*job.scratchSize);     // kept for the next frame
+    if (!job.scratch)
+        return 0;
+    if (nbands > 1)
+        workerPoolRun(filterBand, (void *)&job, nbands);
+    else
+        filterRows(&job, job.scratch, 0, height);
+    return 1;
+}
+
+int filterLuma(const unsigned char * luma, int width, int height, int filter, const short * kernel, int shift,
+               int threshold, void * out, int outFormat)
+{
+    return runFilter(luma, width, height, filter, kernel, shift, threshold, out, outFormat, 0);
+}
+
+int filterLumaPool(const unsigned char * luma, int width, int height, int filter, const short * kernel, int shift,
+                   int threshold, void * out, int outFormat)
+{
+    return runFilter(luma, width, height, filter, kernel, shift, threshold, out, outFormat, 1);
+}
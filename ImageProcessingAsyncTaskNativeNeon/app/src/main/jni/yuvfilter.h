@@ -0,0 +1,67 @@
+//
+// Convolution engine on the luma (Y) plane of NV21 frames: generic 3x3 / 5x5 integer kernels,
+// separable Gaussian blur and Sobel edge magnitude, with optional thresholding.
+// Every band of output rows keeps a sliding window of 3 or 5 preprocessed input rows (borders
+// replicated, horizontal pass of the separable filters already done), so each input row is read
+// from memory once and the vertical pass works on rows that are in the cache.
+//
+
+#ifndef YUVFILTER_H
+#define YUVFILTER_H
+
+// Filters
+#define YUV_FILTER_CONV3  0     // generic 3x3 kernel (kernel: 9 coefficients, row by row)
+#define YUV_FILTER_CONV5  1     // generic 5x5 kernel (kernel: 25 coefficients, row by row)
+#define YUV_FILTER_GAUSS3 2     // Gaussian blur [1 2 1] x [1 2 1] / 16
+#define YUV_FILTER_GAUSS5 3     // Gaussian blur [1 4 6 4 1] x [1 4 6 4 1] / 256
+#define YUV_FILTER_SOBEL  4     // Sobel gradient magnitude |Gx| + |Gy|, saturated to 255
+
+// Output formats
+#define YUV_FILTER_GREY8    0   // one byte per pixel
+#define YUV_FILTER_GREY8888 1   // one int per pixel, R = G = B (as the GREY8888 conversion)
+
+#define YUV_FILTER_NO_THRESHOLD -1
+
+// Filter the width x height luma plane into out (width*height pixels in outFormat).
+// For YUV_FILTER_CONV3/5 each output pixel is [sum(kernel*Y) + rounding] >> shift saturated to [0,255]
+// (coefficients in [-32768, 32767], shift in [0,30]); kernel and shift are ignored by the other filters.
+// With threshold in [0,255] the pixels are 255 if the filtered value is greater than threshold and 0 otherwise.
+// Returns 0 (and does nothing) if the arguments are not valid.
+int filterLuma(const unsigned char * luma, int width, int height, int filter, const short * kernel, int shift,
+               int threshold, void * out, int outFormat);
+
+// Same, with the output rows split in bands on the persistent worker pool
+int filterLumaPool(const unsigned char * luma, int width, int height, int filter, const short * kernel, int shift,
+                   int threshold, void * out, int outFormat);
+
+// Row kernels of the engine (yuvfilter.c has the scalar ones). The input rows are padded: p[-2] and
+// p[width+1] are valid. Each one processes the columns [x0, x1) from x0 on, in whole SIMD blocks, and
+// returns the first column it did not process (the caller finishes the row with the scalar kernel).
+//   H121   h = p[-1] + 2p + p[+1]                     Hsobel  also d = p[+1] - p[-1]
+//   H14641 h = p[-2] + 4p[-1] + 6p + 4p[+1] + p[+2]
+//   V121   out = (h0 + 2h1 + h2 + 8) >> 4             V14641  out = (h0 + 4h1 + 6h2 + 4h3 + h4 + 128) >> 8
+//   Vsobel out = sat(|d0 + 2d1 + d2| + |h2 - h0|)
+//   Conv   out = sat([sum(k*p) + rounding] >> shift) over ksize rows
+int filterRowH121_NEON(const unsigned char * p, unsigned short * h, int x0, int x1);
+int filterRowH14641_NEON(const unsigned char * p, unsigned short * h, int x0, int x1);
+int filterRowHsobel_NEON(const unsigned char * p, unsigned short * h, short * d, int x0, int x1);
+int filterRowV121_NEON(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                       unsigned char * out, int x0, int x1);
+int filterRowV14641_NEON(const unsigned short * const * h, unsigned char * out, int x0, int x1);
+int filterRowVsobel_NEON(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                         const short * d2, unsigned char * out, int x0, int x1);
+int filterRowConv_NEON(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                       unsigned char * out, int x0, int x1);
+
+int filterRowH121_SSE41(const unsigned char * p, unsigned short * h, int x0, int x1);
+int filterRowH14641_SSE41(const unsigned char * p, unsigned short * h, int x0, int x1);
+int filterRowHsobel_SSE41(const unsigned char * p, unsigned short * h, short * d, int x0, int x1);
+int filterRowV121_SSE41(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                        unsigned char * out, int x0, int x1);
+int filterRowV14641_SSE41(const unsigned short * const * h, unsigned char * out, int x0, int x1);
+int filterRowVsobel_SSE41(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                          const short * d2, unsigned char * out, int x0, int x1);
+int filterRowConv_SSE41(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                        unsigned char * out, int x0, int x1);
+
+#endif
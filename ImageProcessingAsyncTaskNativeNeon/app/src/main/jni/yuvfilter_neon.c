@@ -0,0 +1,159 @@
+//
+// NEON row kernels of the luma convolution engine (see yuvfilter.h), for ARMv7 NEON and AArch64.
+// Same integer math as the scalar kernels of yuvfilter.c, so the output is bit-identical.
+//
+
+#include "yuvfilter.h"
+
+#if (defined(__ARM_ARCH_7A__) && defined(__ARM_NEON__)) || defined(__aarch64__)
+#include <arm_neon.h>
+
+int filterRowH121_NEON(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x+8 <= x1; x+=8)
+        vst1q_u16(h+x, vaddq_u16(vaddl_u8(vld1_u8(p+x-1), vld1_u8(p+x+1)), vshll_n_u8(vld1_u8(p+x), 1)));
+    return x;
+}
+
+int filterRowH14641_NEON(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    uint8x8_t const six = vdup_n_u8(6);
+    uint16x8_t s;
+    int x;
+
+    for (x=x0; x+8 <= x1; x+=8) {
+        s = vaddl_u8(vld1_u8(p+x-2), vld1_u8(p+x+2));
+        s = vaddq_u16(s, vshlq_n_u16(vaddl_u8(vld1_u8(p+x-1), vld1_u8(p+x+1)), 2));
+        vst1q_u16(h+x, vmlal_u8(s, vld1_u8(p+x), six));
+    }
+    return x;
+}
+
+int filterRowHsobel_NEON(const unsigned char * p, unsigned short * h, short * d, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x+8 <= x1; x+=8) {
+        uint8x8_t const l = vld1_u8(p+x-1), r = vld1_u8(p+x+1);
+        vst1q_u16(h+x, vaddq_u16(vaddl_u8(l, r), vshll_n_u8(vld1_u8(p+x), 1)));
+        vst1q_s16(d+x, vreinterpretq_s16_u16(vsubl_u8(r, l)));
+    }
+    return x;
+}
+
+int filterRowV121_NEON(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                       unsigned char * out, int x0, int x1)
+{
+    uint16x8_t s;
+    int x;
+
+    // h <= 1020: the sums fit in 16 bits, vrshrn adds the rounding
+    for (x=x0; x+8 <= x1; x+=8) {
+        s = vaddq_u16(vaddq_u16(vld1q_u16(h0+x), vld1q_u16(h2+x)), vshlq_n_u16(vld1q_u16(h1+x), 1));
+        vst1_u8(out+x, vrshrn_n_u16(s, 4));
+    }
+    return x;
+}
+
+int filterRowV14641_NEON(const unsigned short * const * h, unsigned char * out, int x0, int x1)
+{
+    uint16x8_t s, c;
+    int x;
+
+    // at most 16*4080: fits in u16
+    for (x=x0; x+8 <= x1; x+=8) {
+        c = vld1q_u16(h[2]+x);
+        s = vaddq_u16(vld1q_u16(h[0]+x), vld1q_u16(h[4]+x));
+        s = vaddq_u16(s, vshlq_n_u16(vaddq_u16(vld1q_u16(h[1]+x), vld1q_u16(h[3]+x)), 2));
+        s = vaddq_u16(s, vaddq_u16(vshlq_n_u16(c, 2), vshlq_n_u16(c, 1)));
+        vst1_u8(out+x, vrshrn_n_u16(s, 8));
+    }
+    return x;
+}
+
+int filterRowVsobel_NEON(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                         const short * d2, unsigned char * out, int x0, int x1)
+{
+    int16x8_t gx, gy;
+    int x;
+
+    for (x=x0; x+8 <= x1; x+=8) {
+        gx = vaddq_s16(vaddq_s16(vld1q_s16(d0+x), vld1q_s16(d2+x)), vshlq_n_s16(vld1q_s16(d1+x), 1));
+        gy = vreinterpretq_s16_u16(vsubq_u16(vld1q_u16(h2+x), vld1q_u16(h0+x)));
+        vst1_u8(out+x, vqmovn_u16(vreinterpretq_u16_s16(vaddq_s16(vabsq_s16(gx), vabsq_s16(gy)))));
+    }
+    return x;
+}
+
+// Generic kernel, 8 columns per iteration in 32 bits (one vmlal by scalar per tap and half)
+int filterRowConv_NEON(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                       unsigned char * out, int x0, int x1)
+{
+    int const r = ksize/2;
+    int32x4_t const rounding = vdupq_n_s32(shift > 0 ? 1 << (shift-1) : 0);
+    int32x4_t const count = vdupq_n_s32(-shift);     // negative: arithmetic shift right
+    int32x4_t lo, hi;
+    int16x8_t v;
+    int i, j, x;
+
+    for (x=x0; x+8 <= x1; x+=8) {
+        lo = rounding;
+        hi = rounding;
+        for (i=0; i < ksize; i++)
+            for (j=0; j < ksize; j++) {
+                v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p[i]+x+j-r)));
+                lo = vmlal_n_s16(lo, vget_low_s16(v), kernel[i*ksize+j]);
+                hi = vmlal_n_s16(hi, vget_high_s16(v), kernel[i*ksize+j]);
+            }
+        lo = vshlq_s32(lo, count);
+        hi = vshlq_s32(hi, count);
+        vst1_u8(out+x, vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))));
+    }
+    return x;
+}
+
+#else
+
+// no NEON: nothing is filtered, the scalar kernels do the whole row
+
+int filterRowH121_NEON(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowH14641_NEON(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowHsobel_NEON(const unsigned char * p, unsigned short * h, short * d, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowV121_NEON(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                       unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowV14641_NEON(const unsigned short * const * h, unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowVsobel_NEON(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                         const short * d2, unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowConv_NEON(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                       unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+#endif
@@ -0,0 +1,197 @@
+//
+// SSE4.1 row kernels of the luma convolution engine (see yuvfilter.h).
+// Same integer math as the scalar kernels of yuvfilter.c, so the output is bit-identical.
+// The caller must check that the CPU supports SSE4.1 (yuvfilter.c does it once).
+//
+
+#include "yuvfilter.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+
+#define SSE41 __attribute__((target("sse4.1")))
+
+// 8 bytes at p, zero-extended to u16
+static SSE41 inline __m128i load8(const unsigned char *p)
+{
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)p));
+}
+
+static SSE41 inline __m128i load16(const void *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static SSE41 inline void store16(void *p, __m128i v)
+{
+    _mm_storeu_si128((__m128i *)p, v);
+}
+
+SSE41 int filterRowH121_SSE41(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x+8 <= x1; x+=8)
+        store16(h+x, _mm_add_epi16(_mm_add_epi16(load8(p+x-1), load8(p+x+1)), _mm_slli_epi16(load8(p+x), 1)));
+    return x;
+}
+
+SSE41 int filterRowH14641_SSE41(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x+8 <= x1; x+=8) {
+        __m128i const c = load8(p+x);
+        __m128i const s = _mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(load8(p+x-1), load8(p+x+1)), 2),
+                                        _mm_add_epi16(load8(p+x-2), load8(p+x+2)));
+        store16(h+x, _mm_add_epi16(s, _mm_add_epi16(_mm_slli_epi16(c, 2), _mm_slli_epi16(c, 1))));    // + 6c
+    }
+    return x;
+}
+
+SSE41 int filterRowHsobel_SSE41(const unsigned char * p, unsigned short * h, short * d, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x+8 <= x1; x+=8) {
+        __m128i const l = load8(p+x-1), r = load8(p+x+1);
+        store16(h+x, _mm_add_epi16(_mm_add_epi16(l, r), _mm_slli_epi16(load8(p+x), 1)));
+        store16(d+x, _mm_sub_epi16(r, l));
+    }
+    return x;
+}
+
+SSE41 int filterRowV121_SSE41(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                              unsigned char * out, int x0, int x1)
+{
+    __m128i const rounding = _mm_set1_epi16(8);
+    __m128i lo, hi;
+    int x;
+
+    // h <= 1020: the sums fit in 16 bits
+    for (x=x0; x+16 <= x1; x+=16) {
+        lo = _mm_add_epi16(_mm_add_epi16(load16(h0+x), load16(h2+x)), _mm_slli_epi16(load16(h1+x), 1));
+        hi = _mm_add_epi16(_mm_add_epi16(load16(h0+x+8), load16(h2+x+8)), _mm_slli_epi16(load16(h1+x+8), 1));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, rounding), 4);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, rounding), 4);
+        store16(out+x, _mm_packus_epi16(lo, hi));
+    }
+    return x;
+}
+
+// h0 + 4h1 + 6h2 + 4h3 + h4 + 128 of 8 columns (at most 16*4080 + 128: fits in u16)
+static SSE41 inline __m128i sum14641(const unsigned short * const * h, int x)
+{
+    __m128i const c = load16(h[2]+x);
+    __m128i const s = _mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(load16(h[1]+x), load16(h[3]+x)), 2),
+                                    _mm_add_epi16(load16(h[0]+x), load16(h[4]+x)));
+
+    return _mm_add_epi16(_mm_add_epi16(s, _mm_set1_epi16(128)), _mm_add_epi16(_mm_slli_epi16(c, 2), _mm_slli_epi16(c, 1)));
+}
+
+SSE41 int filterRowV14641_SSE41(const unsigned short * const * h, unsigned char * out, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x+16 <= x1; x+=16)
+        store16(out+x, _mm_packus_epi16(_mm_srli_epi16(sum14641(h, x), 8), _mm_srli_epi16(sum14641(h, x+8), 8)));
+    return x;
+}
+
+// |d0 + 2d1 + d2| + |h2 - h0| of 8 columns (at most 2040)
+static SSE41 inline __m128i sobel8(const unsigned short * h0, const unsigned short * h2, const short * d0,
+                                   const short * d1, const short * d2, int x)
+{
+    __m128i const gx = _mm_add_epi16(_mm_add_epi16(load16(d0+x), load16(d2+x)), _mm_slli_epi16(load16(d1+x), 1));
+    __m128i const gy = _mm_sub_epi16(load16(h2+x), load16(h0+x));
+
+    return _mm_add_epi16(_mm_abs_epi16(gx), _mm_abs_epi16(gy));
+}
+
+SSE41 int filterRowVsobel_SSE41(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                                const short * d2, unsigned char * out, int x0, int x1)
+{
+    int x;
+
+    for (x=x0; x+16 <= x1; x+=16)
+        store16(out+x, _mm_packus_epi16(sobel8(h0, h2, d0, d1, d2, x), sobel8(h0, h2, d0, d1, d2, x+8)));
+    return x;
+}
+
+// Generic kernel, 8 columns per iteration in 32 bits: two horizontal taps per _mm_madd_epi16
+// (the pixels of columns x+j and x+j+1 interleaved, times the coefficient pair {k[j], k[j+1]})
+SSE41 int filterRowConv_SSE41(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                              unsigned char * out, int x0, int x1)
+{
+    int const r = ksize/2;
+    __m128i const rounding = _mm_set1_epi32(shift > 0 ? 1 << (shift-1) : 0);
+    __m128i const count = _mm_cvtsi32_si128(shift);
+    __m128i coef[5][3];
+    int i, j, x;
+
+    for (i=0; i < ksize; i++)
+        for (j=0; j < ksize; j+=2)
+            coef[i][j/2] = _mm_set1_epi32((int)(((unsigned)(j+1 < ksize ? kernel[i*ksize+j+1] : 0) << 16) |
+                                                ((unsigned)kernel[i*ksize+j] & 0xffff)));
+
+    for (x=x0; x+8 <= x1; x+=8) {
+        __m128i lo = rounding, hi = rounding;
+        for (i=0; i < ksize; i++) {
+            const unsigned char *row = p[i] + x - r;
+            for (j=0; j < ksize; j+=2) {
+                __m128i const a = load8(row+j);
+                __m128i const b = j+1 < ksize ? load8(row+j+1) : _mm_setzero_si128();
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), coef[i][j/2]));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), coef[i][j/2]));
+            }
+        }
+        lo = _mm_sra_epi32(lo, count);
+        hi = _mm_sra_epi32(hi, count);
+        _mm_storel_epi64((__m128i *)(out+x), _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128()));
+    }
+    return x;
+}
+
+#else
+
+// not x86: nothing is filtered, the scalar kernels do the whole row
+
+int filterRowH121_SSE41(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowH14641_SSE41(const unsigned char * p, unsigned short * h, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowHsobel_SSE41(const unsigned char * p, unsigned short * h, short * d, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowV121_SSE41(const unsigned short * h0, const unsigned short * h1, const unsigned short * h2,
+                        unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowV14641_SSE41(const unsigned short * const * h, unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowVsobel_SSE41(const unsigned short * h0, const unsigned short * h2, const short * d0, const short * d1,
+                          const short * d2, unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+int filterRowConv_SSE41(const unsigned char * const * p, int ksize, const short * kernel, int shift,
+                        unsigned char * out, int x0, int x1)
+{
+    return x0;
+}
+
+#endif
@@ -0,0 +1,131 @@
+//
+// Scalar, pthread, worker pool and OpenMP kernels of the YUV420 NV21 -> GREY conversion.
+// Grey only depends on Y, so the chroma plane is never read: the Y plane is converted as one long
+// row through the grey lookup table of yuv2rgb.c (same values as the RGB conversion with U = V = 0).
+//
+
+#include <string.h>
+#include <pthread.h>
+#include <omp.h>
+#include "workerpool.h"
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+
+typedef struct greyJob {   // operands of the parallel grey conversion, shared by all the chunks
+    const unsigned char * data;
+    int * pixels;
+    int width;
+    int height;
+    int my_id;
+    int nthr;
+} greyJob;
+
+void convertYtoGREY8888Row(const unsigned char * y, int * pixels, int n)
+{
+    const unsigned char *lut = yuvGetGreyLUT();
+    int i;
+
+    for (i=0; i < n; i++)
+        pixels[i] = 0xff000000 | (lut[y[i]]*0x010101);
+}
+
+void convertYtoGREY8Row(const unsigned char * y, unsigned char * grey, int n)
+{
+    const yuvCoefs *c = yuvGetCoefs();
+    const unsigned char *lut;
+    int i;
+
+    if (c->ycoef == 256 && c->yoff == 0) {      // full range: grey is Y
+        if (grey != y)
+            memcpy(grey, y, n);
+        return;
+    }
+    lut = yuvGetGreyLUT();
+    for (i=0; i < n; i++)
+        grey[i] = lut[y[i]];
+}
+
+void convertYUV420_NV21toGREY8888(const unsigned char * data, int * pixels, int width, int height)
+{
+    convertYtoGREY8888Row(data, pixels, width*height);
+}
+
+// Rows [height*my_id/nthr, height*(my_id+1)/nthr) of the image
+static void convertGreyChunk(const greyJob *job)
+{
+    int const row0 = (int)((long long)job->height*job->my_id/job->nthr);
+    int const row1 = (int)((long long)job->height*(job->my_id+1)/job->nthr);
+
+    convertYtoGREY8888Row(job->data + row0*job->width, job->pixels + row0*job->width, (row1-row0)*job->width);
+}
+
+// pthread entry point
+static void *convertGreyThread(void *args)
+{
+    convertGreyChunk((greyJob *)args);
+    pthread_exit(NULL);
+}
+
+// Worker pool task: the rows [row0, row1)
+static void convertGreyRange(void *args, int row0, int row1)
+{
+    const greyJob *job = (const greyJob *)args;
+
+    convertYtoGREY8888Row(job->data + row0*job->width, job->pixels + row0*job->width, (row1-row0)*job->width);
+}
+
+void convertYUV420_NV21toGREY8888Parallel(const unsigned char * data, int * pixels, int width, int height, int nthr)
+{
+    pthread_t th[MAX_NUM_THREADS];
+    greyJob jobs[MAX_NUM_THREADS];
+    int my_nthr = nthr < 1 ? 1 : nthr;
+    int i, created = 0;
+
+    if (my_nthr > MAX_NUM_THREADS)
+        my_nthr = MAX_NUM_THREADS;
+    yuvGetGreyLUT();        // the table is built once, before the threads use it
+    for (i=0; i < my_nthr; i++) {
+        jobs[i].data = data;
+        jobs[i].pixels = pixels;
+        jobs[i].width = width;
+        jobs[i].height = height;
+        jobs[i].my_id = i;
+        jobs[i].nthr = my_nthr;
+        if (created == i && pthread_create(&th[i], NULL, convertGreyThread, (void *)&jobs[i]) == 0)
+            created++;
+        else
+            convertGreyChunk(&jobs[i]);     // no thread: the caller converts these rows
+    }
+    for (i=0; i < created; i++)
+        pthread_join(th[i], NULL);
+}
+
+void convertYUV420_NV21toGREY8888Pool(const unsigned char * data, int * pixels, int width, int height)
+{
+    greyJob job;
+
+    job.data = data;
+    job.pixels = pixels;
+    job.width = width;
+    job.height = height;
+    job.my_id = 0;
+    job.nthr = 1;
+    yuvGetGreyLUT();
+    workerPoolRunRange(convertGreyRange, (void *)&job, height, 8);      // at least 8 rows per chunk
+}
+
+void convertYUV420_NV21toGREY8888_OMP(const unsigned char * data, int * pixels, int width, int height)
+{
+    const unsigned char *lut = yuvGetGreyLUT();
+    int row, i;
+
+#pragma omp parallel for schedule(static) private(i)
+    for (row=0; row < height; row++)
+        for (i=row*width; i < (row+1)*width; i++)
+            pixels[i] = 0xff000000 | (lut[data[i]]*0x010101);
+}
+
+void convertYUV420_NV21toGREY8(const unsigned char * data, unsigned char * grey, int width, int height)
+{
+    convertYtoGREY8Row(data, grey, width*height);
+}
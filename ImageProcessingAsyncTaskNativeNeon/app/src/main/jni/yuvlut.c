@@ -0,0 +1,67 @@
+//
+// Table-driven scalar kernels of the YUV420 NV21 -> RGB8888 conversion, for CPUs without a usable SIMD kernel.
+// The multiplications of yuvPixel are replaced by the lookup tables of yuv2rgb.c (yuvGetLUT): per 2x2 block the
+// chroma is three table loads and two additions, per pixel one load for Y and three for the clamp. The images are
+// bit-identical to the ones of convertYUV420_NV21toRGB8888.
+//
+
+#include "workerpool.h"
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+
+#define MIN_CHUNK_PAIRS 2       // smallest chunk of the worker pool kernel
+
+typedef struct lutJob {    // operands of the parallel conversion, shared by all the chunks
+    const unsigned char * data;
+    int * pixels;
+    int width;
+    int height;
+} lutJob;
+
+void convertYUV420_NV21toRGB8888LUTTile(const unsigned char * data, int * pixels, int width, int height,
+                                        int pair0, int pair1, int col0, int col1)
+{
+    const yuvLUT *t = yuvGetLUT();
+    int i, j;
+
+    for (j=pair0; j < pair1; j++) {
+        const unsigned char *y0 = data + 2*j*width;
+        const unsigned char *y1 = y0 + width;
+        const unsigned char *uv = data + width*height + j*width;
+        int *p0 = pixels + 2*j*width;
+        int *p1 = p0 + width;
+
+        for (i=col0; i < col1; i+=2) {
+            yuvChroma const ch = yuvChromaLUT(t, uv[i+1], uv[i]);     // V U pairs, as the reference kernel
+
+            p0[i  ] = yuvPixelLUT(t, y0[i  ], &ch);
+            p0[i+1] = yuvPixelLUT(t, y0[i+1], &ch);
+            p1[i  ] = yuvPixelLUT(t, y1[i  ], &ch);
+            p1[i+1] = yuvPixelLUT(t, y1[i+1], &ch);
+        }
+    }
+}
+
+void convertYUV420_NV21toRGB8888_LUT(const unsigned char * data, int * pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888LUTTile(data, pixels, width, height, 0, height/2, 0, width);
+}
+
+// Worker pool task: the row pairs [pair0, pair1)
+static void lutRange(void *args, int pair0, int pair1)
+{
+    const lutJob *j = (const lutJob *)args;
+
+    convertYUV420_NV21toRGB8888LUTTile(j->data, j->pixels, j->width, j->height, pair0, pair1, 0, j->width);
+}
+
+void convertYUV420_NV21toRGB8888LUTPool(const unsigned char * data, int * pixels, int width, int height)
+{
+    lutJob j;
+
+    j.data = data;
+    j.pixels = pixels;
+    j.width = width;
+    j.height = height;
+    workerPoolRunRange(lutRange, (void *)&j, height/2, MIN_CHUNK_PAIRS);
+}
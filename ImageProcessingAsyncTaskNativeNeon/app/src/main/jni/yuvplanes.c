@@ -0,0 +1,205 @@
+//
+// Plane descriptors of YUV420 frames (see yuvplanes.h) and the scalar conversion of any layout.
+//
+
+#include "yuv2rgb.h"
+#include "yuvplanes.h"
+
+static int chromaStride(int format, int stride)
+{
+    if (format == YUV_FORMAT_NV21 || format == YUV_FORMAT_NV12)
+        return stride;
+    if (format == YUV_FORMAT_YV12)
+        return (stride/2 + 15) & ~15;
+    return stride/2;
+}
+
+int yuvBufferSize(int format, int width, int height, int stride)
+{
+    if (stride <= 0)
+        stride = width;
+    if (format < YUV_FORMAT_NV21 || format > YUV_FORMAT_YV12 || width < 2 || height < 2 || (width&1) || (height&1) || stride < width)
+        return 0;
+    if (format == YUV_FORMAT_NV21 || format == YUV_FORMAT_NV12)
+        return stride*height + stride*(height/2);
+    return stride*height + 2*chromaStride(format, stride)*(height/2);
+}
+
+int yuvImageFromBuffer(yuvImage *img, const unsigned char * data, int format, int width, int height, int stride)
+{
+    const unsigned char *chroma;
+    int cstride;
+
+    if (stride <= 0)
+        stride = width;
+    if (!data || !yuvBufferSize(format, width, height, stride))
+        return 0;
+    chroma = data + stride*height;
+    cstride = chromaStride(format, stride);
+    img->width = width;
+    img->height = height;
+    img->y.data = data;
+    img->y.rowStride = stride;
+    img->y.pixelStride = 1;
+    img->u.rowStride = img->v.rowStride = cstride;
+    switch (format) {
+        case YUV_FORMAT_NV21:
+            img->v.data = chroma;
+            img->u.data = chroma+1;
+            img->u.pixelStride = img->v.pixelStride = 2;
+            break;
+        case YUV_FORMAT_NV12:
+            img->u.data = chroma;
+            img->v.data = chroma+1;
+            img->u.pixelStride = img->v.pixelStride = 2;
+            break;
+        case YUV_FORMAT_I420:
+            img->u.data = chroma;
+            img->v.data = chroma + cstride*(height/2);
+            img->u.pixelStride = img->v.pixelStride = 1;
+            break;
+        default:    // YV12
+            img->v.data = chroma;
+            img->u.data = chroma + cstride*(height/2);
+            img->u.pixelStride = img->v.pixelStride = 1;
+            break;
+    }
+    return 1;
+}
+
+int yuvImageCrop(yuvImage *sub, const yuvImage *img, int x, int y, int width, int height)
+{
+    if (((x|y|width|height) & 1) || x < 0 || y < 0 || width < 2 || height < 2 ||
+        x+width > img->width || y+height > img->height)
+        return 0;
+    *sub = *img;
+    sub->width = width;
+    sub->height = height;
+    sub->y.data = img->y.data + y*img->y.rowStride + x;
+    sub->u.data = img->u.data + (y/2)*img->u.rowStride + (x/2)*img->u.pixelStride;
+    sub->v.data = img->v.data + (y/2)*img->v.rowStride + (x/2)*img->v.pixelStride;
+    return 1;
+}
+
+int yuvChromaLayout(const yuvImage *img)
+{
+    if (img->u.pixelStride == 1 && img->v.pixelStride == 1)
+        return YUV_CHROMA_PLANAR;
+    if (img->u.pixelStride == 2 && img->v.pixelStride == 2 && img->u.rowStride == img->v.rowStride) {
+        if (img->u.data == img->v.data+1)
+            return YUV_CHROMA_VU;
+        if (img->v.data == img->u.data+1)
+            return YUV_CHROMA_UV;
+    }
+    return YUV_CHROMA_OTHER;
+}
+
+int yuvImageCheck(const yuvImage *img, int pair0, int pair1)
+{
+    int const w = img->width, h = img->height;
+
+    if ((w&1) || w < 2 || (h&1) || h < 2 || pair0 < 0 || pair1 < pair0 || pair1 > h/2)
+        return 0;
+    if (!img->y.data || !img->u.data || !img->v.data || img->y.pixelStride != 1 || img->y.rowStride < w)
+        return 0;
+    if (img->u.pixelStride < 1 || img->v.pixelStride < 1 ||
+        img->u.rowStride < (w/2-1)*img->u.pixelStride+1 || img->v.rowStride < (w/2-1)*img->v.pixelStride+1)
+        return 0;
+    return 1;
+}
+
+// Store the pixel px (yuvPixel: 0xAARRGGBB) as pixel i of a row in the output format
+static inline __attribute__((always_inline)) void storePixel(unsigned char *out, int i, int px, int const format)
+{
+    switch (format) {
+        case YUV_OUT_RGBA8888:
+            ((int *)out)[i] = (px & 0xff00ff00) | ((px >> 16) & 0xff) | ((px & 0xff) << 16);
+            break;
+        case YUV_OUT_RGB565:
+            ((unsigned short *)out)[i] = (unsigned short)(((px >> 8) & 0xf800) | ((px >> 5) & 0x7e0) | ((px >> 3) & 0x1f));
+            break;
+        case YUV_OUT_RGB888:
+            out[3*i  ] = (unsigned char)(px >> 16);
+            out[3*i+1] = (unsigned char)(px >> 8);
+            out[3*i+2] = (unsigned char)px;
+            break;
+        default:        // YUV_OUT_BGRA8888: the int itself
+            ((int *)out)[i] = px;
+            break;
+    }
+}
+
+// The tile in one output format (a constant at every call: one loop per format)
+static inline __attribute__((always_inline)) void formatTile(const yuvImage *img, unsigned char * out, int const format,
+                                                             int pair0, int pair1, int col0, int col1)
+{
+    const yuvCoefs *c = yuvGetCoefs();
+    int const rowBytes = img->width*YUV_OUT_BYTES(format);
+    int const ups = img->u.pixelStride, vps = img->v.pixelStride;
+    yuvChroma ch;
+    int i, j;
+
+    for (j=pair0; j < pair1; j++) {
+        const unsigned char *y0 = img->y.data + 2*j*img->y.rowStride;
+        const unsigned char *y1 = y0 + img->y.rowStride;
+        const unsigned char *u = img->u.data + j*img->u.rowStride;
+        const unsigned char *v = img->v.data + j*img->v.rowStride;
+        unsigned char *out0 = out + 2*j*rowBytes;
+        unsigned char *out1 = out0 + rowBytes;
+
+        for (i=col0; i < col1; i+=2) {
+            ch = yuvChromaOf(c, u[(i/2)*ups]-128, v[(i/2)*vps]-128);
+            storePixel(out0, i  , yuvPixel(c, y0[i  ], &ch), format);
+            storePixel(out0, i+1, yuvPixel(c, y0[i+1], &ch), format);
+            storePixel(out1, i  , yuvPixel(c, y1[i  ], &ch), format);
+            storePixel(out1, i+1, yuvPixel(c, y1[i+1], &ch), format);
+        }
+    }
+}
+
+void convertYUV420toFormatTile(const yuvImage *img, void * out, int format, int pair0, int pair1, int col0, int col1)
+{
+    switch (format) {
+        case YUV_OUT_BGRA8888: formatTile(img, out, YUV_OUT_BGRA8888, pair0, pair1, col0, col1); break;
+        case YUV_OUT_RGB565:   formatTile(img, out, YUV_OUT_RGB565, pair0, pair1, col0, col1); break;
+        case YUV_OUT_RGB888:   formatTile(img, out, YUV_OUT_RGB888, pair0, pair1, col0, col1); break;
+        default:               formatTile(img, out, YUV_OUT_RGBA8888, pair0, pair1, col0, col1); break;
+    }
+}
+
+// The 4:4:4 row in one output format (a constant at every call)
+static inline __attribute__((always_inline)) void formatRow444(const unsigned char * y, const unsigned char * u, const unsigned char * v,
+                                                               unsigned char * out, int const format, int n)
+{
+    const yuvCoefs *c = yuvGetCoefs();
+    yuvChroma ch;
+    int i;
+
+    for (i=0; i < n; i++) {
+        ch = yuvChromaOf(c, u[i]-128, v[i]-128);
+        storePixel(out, i, yuvPixel(c, y[i], &ch), format);
+    }
+}
+
+void convertYUV444toFormatRow(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n)
+{
+    switch (format) {
+        case YUV_OUT_BGRA8888: formatRow444(y, u, v, out, YUV_OUT_BGRA8888, n); break;
+        case YUV_OUT_RGB565:   formatRow444(y, u, v, out, YUV_OUT_RGB565, n); break;
+        case YUV_OUT_RGB888:   formatRow444(y, u, v, out, YUV_OUT_RGB888, n); break;
+        default:               formatRow444(y, u, v, out, YUV_OUT_RGBA8888, n); break;
+    }
+}
+
+int convertYUV420toFormat(const yuvImage *img, void * out, int format)
+{
+    if (!out || !YUV_OUT_VALID(format) || !yuvImageCheck(img, 0, img->height/2))
+        return 0;
+    convertYUV420toFormatTile(img, out, format, 0, img->height/2, 0, img->width);
+    return 1;
+}
+
+int convertYUV420toRGB8888(const yuvImage *img, int * pixels)
+{
+    return convertYUV420toFormat(img, pixels, YUV_OUT_INT8888);
+}
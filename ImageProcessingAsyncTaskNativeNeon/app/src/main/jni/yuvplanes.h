@@ -0,0 +1,107 @@
+//
+// YUV420 frames described plane by plane (pointer, row stride and pixel stride of Y, U and V), so that
+// NV21, NV12, I420, YV12 and padded camera buffers (Camera2 Image planes, hardware decoders) are converted
+// in place, with no repacking to NV21 first. The output is width*height packed pixels in one of the
+// YUV_OUT_* formats, written by the conversion itself (no second swizzle pass).
+//
+// The chroma math is the one of yuv2rgb.h whatever the layout: the U (Cb) samples drive bu and gu, the V (Cr)
+// samples rv and gv. The SIMD kernels read the chroma in the NV21 order (V U pairs): NV12 pairs are swapped
+// and planar rows interleaved V first, so an NV21 frame gives exactly the same image through both APIs.
+//
+
+#ifndef YUVPLANES_H
+#define YUVPLANES_H
+
+// Packed formats of yuvImageFromBuffer (same values as MainActivity.YUV_FORMAT_*)
+#define YUV_FORMAT_NV21 0       // Y plane, then interleaved V U (Android camera default)
+#define YUV_FORMAT_NV12 1       // Y plane, then interleaved U V
+#define YUV_FORMAT_I420 2       // Y plane, U plane, V plane
+#define YUV_FORMAT_YV12 3       // Y plane, V plane, U plane (chroma stride aligned to 16, as Android's YV12)
+
+// Chroma layouts, each one with its own SIMD loop (yuvChromaLayout)
+#define YUV_CHROMA_VU 0         // interleaved, V first (NV21)
+#define YUV_CHROMA_UV 1         // interleaved, U first (NV12)
+#define YUV_CHROMA_PLANAR 2     // one plane per component (I420, YV12)
+#define YUV_CHROMA_OTHER 3      // any other pixel stride: scalar only
+
+// Output pixel formats (same values as MainActivity.OUT_*). Every kernel is built for each of them from one body
+#define YUV_OUT_RGBA8888 0      // bytes R G B A: the memory of a Bitmap ARGB_8888 (copyPixelsFromBuffer)
+#define YUV_OUT_BGRA8888 1      // bytes B G R A: the ints 0xAARRGGBB of the RGB8888 functions (little endian)
+#define YUV_OUT_RGB565   2      // 16 bits R<<11 | G<<5 | B (Bitmap RGB_565): half the output bandwidth
+#define YUV_OUT_RGB888   3      // bytes R G B
+
+// Format of the int outputs: 0xAARRGGBB, as android.graphics.Color and Bitmap.setPixels take them
+#define YUV_OUT_INT8888 YUV_OUT_BGRA8888
+
+// Bytes per pixel of an output format (a constant when format is)
+#define YUV_OUT_BYTES(format) ((format) == YUV_OUT_RGB565 ? 2 : (format) == YUV_OUT_RGB888 ? 3 : 4)
+#define YUV_OUT_VALID(format) ((format) >= YUV_OUT_RGBA8888 && (format) <= YUV_OUT_RGB888)
+
+typedef struct yuvPlane {
+    const unsigned char * data;
+    int rowStride;              // bytes from a row to the next one
+    int pixelStride;            // bytes from a sample to the next one in a row (1 for Y)
+} yuvPlane;
+
+typedef struct yuvImage {
+    int width;                  // even
+    int height;                 // even
+    yuvPlane y;                 // width x height samples
+    yuvPlane u;                 // width/2 x height/2 samples
+    yuvPlane v;
+} yuvImage;
+
+// Describe a packed buffer of one of the YUV_FORMAT_* with a Y row stride of stride bytes (width if stride <= 0).
+// The chroma rows have stride bytes for NV21/NV12 and stride/2 for I420 (aligned to 16 for YV12).
+// Returns 0 if the format is unknown or the sizes are not valid
+int yuvImageFromBuffer(yuvImage *img, const unsigned char * data, int format, int width, int height, int stride);
+
+// Bytes of a packed buffer of that format (0 if not valid)
+int yuvBufferSize(int format, int width, int height, int stride);
+
+// Descriptor of the rectangle (x, y) - (x+width, y+height) of img, all even and inside the image, converted
+// in place (same strides). Returns 0 if the rectangle is not valid
+int yuvImageCrop(yuvImage *sub, const yuvImage *img, int x, int y, int width, int height);
+
+// YUV_CHROMA_* of the U and V planes
+int yuvChromaLayout(const yuvImage *img);
+
+// 1 if the descriptor can be converted and [pair0, pair1) are row pairs of the image
+int yuvImageCheck(const yuvImage *img, int pair0, int pair1);
+
+// Scalar conversion of the row pairs [pair0, pair1) and the columns [col0, col1) (col0, col1 even),
+// any layout, into out with width*YUV_OUT_BYTES(format) bytes per row. The SIMD kernels use it for the
+// columns that do not fill a whole SIMD block
+void convertYUV420toFormatTile(const yuvImage *img, void * out, int format, int pair0, int pair1, int col0, int col1);
+
+// Whole frame: scalar, SIMD (the kernel selected by yuvdispatch.c, scalar if there is none or the layout is
+// YUV_CHROMA_OTHER) and SIMD in bands on the worker pool. Return 0 (nothing converted) if the descriptor or
+// the format are not valid, 1 otherwise
+int convertYUV420toFormat(const yuvImage *img, void * out, int format);
+int convertYUV420toFormat_SIMD(const yuvImage *img, void * out, int format);
+int convertYUV420toFormat_SIMDParallel(const yuvImage *img, void * out, int format);
+
+// Same, into width*height ints 0xAARRGGBB (YUV_OUT_INT8888)
+int convertYUV420toRGB8888(const yuvImage *img, int * pixels);
+int convertYUV420toRGB8888_SIMD(const yuvImage *img, int * pixels);
+int convertYUV420toRGB8888_SIMDParallel(const yuvImage *img, int * pixels);
+
+// SIMD kernels of the row pairs [pair0, pair1). They return 0 (and do nothing) if they are not compiled in this
+// build, the descriptor or the format are not valid or the layout is YUV_CHROMA_OTHER. The CPU must support
+// the instruction set
+int convertYUV420toFormat_NEON_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1);
+int convertYUV420toFormat_NEON64_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1);  // AArch64
+int convertYUV420toFormat_SSE41_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1);
+int convertYUV420toFormat_AVX2_Rows(const yuvImage *img, void * out, int format, int pair0, int pair1);
+
+// n pixels with their own Y, U and V (a row of a YUV 4:4:4 image, e.g. the samples of a scaled image) into out,
+// n*YUV_OUT_BYTES(format) bytes: scalar, and with the selected SIMD kernel and a scalar tail
+void convertYUV444toFormatRow(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n);
+void convertYUV444toFormatRow_SIMD(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n);
+
+// SIMD versions: they convert the first n&~7 pixels and return how many they converted (0 if they are not
+// compiled in this build). The CPU must support the instruction set
+int convertYUV444toFormatRow_NEON(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n);
+int convertYUV444toFormatRow_SSE41(const unsigned char * y, const unsigned char * u, const unsigned char * v, void * out, int format, int n);
+
+#endif
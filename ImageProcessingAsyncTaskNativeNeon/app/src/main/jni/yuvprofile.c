@@ -0,0 +1,210 @@
+//
+// Per-stage latency histograms and worker accounting (see yuvprofile.h)
+//
+
+#include <string.h>
+#include <time.h>
+#include "yuvprofile.h"
+
+#define SUB_BITS 3                      // 8 linear sub-buckets per power of two
+#define SUB (1 << SUB_BITS)
+#define BUCKETS 288                     // up to 2^37 ns (137 s); longer samples go to the last bucket
+
+typedef struct profSlot {               // written by the threads that share the slot, atomically
+    unsigned int counts[YUV_STAGE_COUNT][BUCKETS];
+    unsigned long long sum[YUV_STAGE_COUNT];
+    unsigned long long max[YUV_STAGE_COUNT];
+} profSlot;
+
+typedef struct profRuntime {
+    unsigned long long wall;            // wall time of the jobs
+    unsigned long long busy[YUV_PROF_WORKERS];
+    unsigned long long tasks[YUV_PROF_WORKERS];
+} profRuntime;
+
+static int profOn;
+static profSlot slots[YUV_PROF_THREADS];
+static profRuntime runtimes[YUV_PROF_RUNTIMES];
+static int nextSlot;
+static __thread int mySlot = -1;
+
+static const char *stageNames[YUV_STAGE_COUNT] = { "jni-in", "convert", "jni-out", "downscale", "draw", "frame" };
+
+static int bucketOf(unsigned long long v)
+{
+    int msb, b;
+
+    if (v < SUB)
+        return (int)v;
+    msb = 63 - __builtin_clzll(v);
+    b = (msb - SUB_BITS + 1)*SUB + (int)((v >> (msb - SUB_BITS)) & (SUB-1));
+    return b < BUCKETS ? b : BUCKETS-1;
+}
+
+// Middle of the values of bucket b
+static long long bucketValue(int b)
+{
+    int shift;
+
+    if (b < SUB)
+        return b;
+    shift = b/SUB - 1;
+    return ((long long)(SUB + b%SUB) << shift) + ((1LL << shift) >> 1);
+}
+
+static profSlot *threadSlot(void)
+{
+    if (mySlot < 0)
+        mySlot = __atomic_fetch_add(&nextSlot, 1, __ATOMIC_RELAXED) % YUV_PROF_THREADS;
+    return &slots[mySlot];
+}
+
+void yuvProfEnable(int on)
+{
+    __atomic_store_n(&profOn, on != 0, __ATOMIC_RELAXED);
+}
+
+int yuvProfEnabled(void)
+{
+    return __atomic_load_n(&profOn, __ATOMIC_RELAXED);
+}
+
+void yuvProfReset(void)
+{
+    memset(slots, 0, sizeof(slots));
+    memset(runtimes, 0, sizeof(runtimes));
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+long long yuvProfNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+long long yuvProfStart(void)
+{
+    return yuvProfEnabled() ? yuvProfNow() : 0;
+}
+
+void yuvProfRecord(int stage, long long ns)
+{
+    profSlot *s;
+    unsigned long long v = ns > 0 ? (unsigned long long)ns : 0;
+    unsigned long long m;
+
+    if (stage < 0 || stage >= YUV_STAGE_COUNT || !yuvProfEnabled())
+        return;
+    s = threadSlot();
+    __atomic_fetch_add(&s->counts[stage][bucketOf(v)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->sum[stage], v, __ATOMIC_RELAXED);
+    m = __atomic_load_n(&s->max[stage], __ATOMIC_RELAXED);
+    while (v > m && !__atomic_compare_exchange_n(&s->max[stage], &m, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void yuvProfLap(long long *t, int stage)
+{
+    long long now;
+
+    if (*t == 0)
+        return;
+    now = yuvProfNow();
+    yuvProfRecord(stage, now - *t);
+    *t = now;
+}
+
+void yuvProfBusy(int runtime, int worker, long long t0)
+{
+    profRuntime *r;
+
+    if (t0 == 0 || runtime < 0 || runtime >= YUV_PROF_RUNTIMES || worker < 0)
+        return;
+    r = &runtimes[runtime];
+    worker %= YUV_PROF_WORKERS;
+    __atomic_fetch_add(&r->busy[worker], (unsigned long long)(yuvProfNow() - t0), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&r->tasks[worker], 1, __ATOMIC_RELAXED);
+}
+
+void yuvProfJob(int runtime, long long t0)
+{
+    if (t0 == 0 || runtime < 0 || runtime >= YUV_PROF_RUNTIMES)
+        return;
+    __atomic_fetch_add(&runtimes[runtime].wall, (unsigned long long)(yuvProfNow() - t0), __ATOMIC_RELAXED);
+}
+
+void yuvProfStage(int stage, yuvStageStats *stats)
+{
+    unsigned long long counts[BUCKETS];
+    unsigned long long n = 0, sum = 0, max = 0, rank50, rank99, seen = 0;
+    int i, b;
+
+    memset(stats, 0, sizeof(*stats));
+    if (stage < 0 || stage >= YUV_STAGE_COUNT)
+        return;
+    memset(counts, 0, sizeof(counts));
+    for (i=0; i < YUV_PROF_THREADS; i++) {
+        unsigned long long m = __atomic_load_n(&slots[i].max[stage], __ATOMIC_RELAXED);
+
+        for (b=0; b < BUCKETS; b++)
+            counts[b] += __atomic_load_n(&slots[i].counts[stage][b], __ATOMIC_RELAXED);
+        sum += __atomic_load_n(&slots[i].sum[stage], __ATOMIC_RELAXED);
+        if (m > max)
+            max = m;
+    }
+    for (b=0; b < BUCKETS; b++)
+        n += counts[b];
+    if (n == 0)
+        return;
+    rank50 = (n*50 + 99)/100;          // nearest rank: the smallest sample with at least q% at or below it
+    rank99 = (n*99 + 99)/100;
+    stats->count = (long long)n;
+    stats->mean = (long long)(sum/n);
+    stats->max = (long long)max;
+    for (b=0; b < BUCKETS; b++) {
+        seen += counts[b];
+        if (stats->p50 == 0 && counts[b] && seen >= rank50)
+            stats->p50 = bucketValue(b);
+        if (counts[b] && seen >= rank99) {
+            stats->p99 = bucketValue(b);
+            break;
+        }
+    }
+    // the midpoint of the last bucket can be above the true maximum
+    if (stats->p50 > stats->max)
+        stats->p50 = stats->max;
+    if (stats->p99 > stats->max)
+        stats->p99 = stats->max;
+}
+
+int yuvProfWorkers(int runtime, yuvWorkerStats *stats, int max)
+{
+    profRuntime *r;
+    long long wall;
+    int i, n = 0;
+
+    if (runtime < 0 || runtime >= YUV_PROF_RUNTIMES)
+        return 0;
+    r = &runtimes[runtime];
+    wall = (long long)__atomic_load_n(&r->wall, __ATOMIC_RELAXED);
+    for (i=0; i < YUV_PROF_WORKERS; i++) {
+        long long busy = (long long)__atomic_load_n(&r->busy[i], __ATOMIC_RELAXED);
+        long long tasks = (long long)__atomic_load_n(&r->tasks[i], __ATOMIC_RELAXED);
+
+        if (tasks > 0)
+            n = i+1;
+        if (i < max) {
+            stats[i].busy = busy;
+            stats[i].idle = wall > busy ? wall - busy : 0;
+            stats[i].tasks = tasks;
+        }
+    }
+    return n;
+}
+
+const char *yuvProfStageName(int stage)
+{
+    return stage >= 0 && stage < YUV_STAGE_COUNT ? stageNames[stage] : "?";
+}
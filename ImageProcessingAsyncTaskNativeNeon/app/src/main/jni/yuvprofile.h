@@ -0,0 +1,78 @@
+//
+// Per-stage latency instrumentation of the native code. The JNI entry points time their stages with
+// CLOCK_MONOTONIC (copy/pin in, conversion, release/copy out) and Java reports the stages it runs itself
+// (downscale, draw, whole frame), so the p50/p99 of every stage come from the same histograms.
+//
+// Each thread records into its own slot of HDR-style histograms (8 linear sub-buckets per power of two:
+// 12.5% resolution from 1 ns to minutes) with relaxed atomic adds: no locks on the frame path, and a
+// snapshot can be taken at any time while the workers keep recording. The worker pool, the pthread and the
+// OpenMP kernels also add the busy time of each worker, so idle = wall time of the jobs - busy shows how
+// well the rows are balanced.
+//
+// Everything is off by default: a disabled profiler costs one relaxed load per stage.
+//
+
+#ifndef YUVPROFILE_H
+#define YUVPROFILE_H
+
+// Stages (same values as MainActivity.STAGE_*)
+#define YUV_STAGE_JNI_IN    0   // Get*ArrayElements / GetPrimitiveArrayCritical of the arrays
+#define YUV_STAGE_CONVERT   1   // the conversion kernel
+#define YUV_STAGE_JNI_OUT   2   // Release*: copy back (or unpin)
+#define YUV_STAGE_DOWNSCALE 3   // reported from Java (yuvProfRecord)
+#define YUV_STAGE_DRAW      4
+#define YUV_STAGE_FRAME     5   // whole frame, camera callback to display
+#define YUV_STAGE_COUNT     6
+
+// Parallel runtimes with per-worker accounting
+#define YUV_PROF_POOL       0   // worker pool (workerpool.h): worker 0 is the calling thread
+#define YUV_PROF_PTHREAD    1   // one pthread per chunk (convertYUV420_NV21toRGB8888Parallel)
+#define YUV_PROF_OMP        2   // OpenMP team (convertYUV420_NV21toRGB8888_OMP)
+#define YUV_PROF_RUNTIMES   3
+
+#define YUV_PROF_THREADS    16  // histogram slots: more threads than this share slots (still exact, just contended)
+#define YUV_PROF_WORKERS    16  // workers accounted per runtime (higher indices wrap around)
+
+typedef struct yuvStageStats {  // nanoseconds (bucket midpoints, exact max)
+    long long count;
+    long long mean;
+    long long p50;
+    long long p99;
+    long long max;
+} yuvStageStats;
+
+typedef struct yuvWorkerStats {
+    long long busy;             // ns running tasks
+    long long idle;             // ns of the jobs' wall time not spent in tasks
+    long long tasks;
+} yuvWorkerStats;
+
+void yuvProfEnable(int on);
+int yuvProfEnabled(void);
+
+// Clear every histogram and worker counter (samples recorded meanwhile may survive)
+void yuvProfReset(void);
+
+// CLOCK_MONOTONIC in ns
+long long yuvProfNow(void);
+
+// Start timing: now, or 0 if the profiler is off. yuvProfLap records the time since *t in stage and moves *t
+// to now, so consecutive laps time consecutive stages. Both do nothing when *t (t0) is 0
+long long yuvProfStart(void);
+void yuvProfLap(long long *t, int stage);
+
+// Record ns in stage (stages timed elsewhere, e.g. in Java)
+void yuvProfRecord(int stage, long long ns);
+
+// Worker accounting: worker ran one task since t0, and the runtime ran one job since t0 (the caller's wall time)
+void yuvProfBusy(int runtime, int worker, long long t0);
+void yuvProfJob(int runtime, long long t0);
+
+void yuvProfStage(int stage, yuvStageStats *stats);
+
+// Stats of the workers 0..max-1 of a runtime. Returns the number of workers that ran tasks (highest index + 1)
+int yuvProfWorkers(int runtime, yuvWorkerStats *stats, int max);
+
+const char *yuvProfStageName(int stage);
+
+#endif
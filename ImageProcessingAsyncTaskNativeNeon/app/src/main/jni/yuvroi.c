@@ -0,0 +1,310 @@
+//
+// Region of interest and incremental (dirty tiles only) conversion (see yuvroi.h)
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "workerpool.h"
+#include "yuv2rgb.h"
+#include "yuvroi.h"
+
+#define SCRATCH_WIDTH 256       // block converted at a time into the scratch buffer: 16 KB of RGBA, stays in L1/L2
+#define SCRATCH_ROWS 16
+#define MIN_CHUNK_PAIRS 8       // smallest chunk of the parallel ROI conversion
+
+struct yuvDirtyTracker {
+    int width, height;
+    int tileWidth, tileHeight;
+    int cols, rows;
+    unsigned char * prevY;      // samples of every tile when it was last converted: width x height,
+    unsigned char * prevU;      // then width/2 x height/2 of U and of V
+    unsigned char * prevV;
+    unsigned char * dirty;      // one flag per tile, written by the tasks of a frame
+    int valid;                  // 0: convert every tile on the next frame
+    const yuvCoefs * coefs;     // colour space, output format and chroma layout of the last frame
+    int format;
+    int layout;
+};
+
+// Convert the rectangle (x, y, w, h) of img (even, inside) into out (img->width pixels per row)
+static void convertRect(const yuvImage *img, unsigned char * out, int format, int x, int y, int w, int h)
+{
+    int const bpp = YUV_OUT_BYTES(format);
+    long const rowBytes = (long)img->width*bpp;
+    unsigned char scratch[SCRATCH_WIDTH*SCRATCH_ROWS*4];
+    yuvImage sub;
+    int bx, by, bw, bh, r;
+
+    if (x == 0 && w == img->width) {        // whole rows are contiguous in the output too
+        if (yuvImageCrop(&sub, img, 0, y, w, h))
+            convertYUV420toFormat_SIMD(&sub, out + y*rowBytes, format);
+        return;
+    }
+    for (by=y; by < y+h; by+=SCRATCH_ROWS) {
+        bh = y+h-by < SCRATCH_ROWS ? y+h-by : SCRATCH_ROWS;
+        for (bx=x; bx < x+w; bx+=SCRATCH_WIDTH) {
+            bw = x+w-bx < SCRATCH_WIDTH ? x+w-bx : SCRATCH_WIDTH;
+            if (!yuvImageCrop(&sub, img, bx, by, bw, bh))
+                continue;
+            convertYUV420toFormat_SIMD(&sub, scratch, format);
+            for (r=0; r < bh; r++)
+                memcpy(out + (by+r)*rowBytes + bx*bpp, scratch + r*bw*bpp, bw*bpp);
+        }
+    }
+}
+
+typedef struct roiJob {    // operands of the parallel ROI conversion, shared by all the chunks
+    const yuvImage * img;
+    unsigned char * out;
+    int format;
+    int x, y, width;
+} roiJob;
+
+// Worker pool task: the row pairs [pair0, pair1) of the ROI
+static void roiBand(void *args, int pair0, int pair1)
+{
+    const roiJob *j = (const roiJob *)args;
+
+    convertRect(j->img, j->out, j->format, j->x, j->y + 2*pair0, j->width, 2*(pair1-pair0));
+}
+
+int convertYUV420toFormatROI(const yuvImage *img, void * out, int format, const yuvRect *roi, int parallel)
+{
+    roiJob j;
+    int x1, y1;
+
+    if (!out || !roi || !YUV_OUT_VALID(format) || !yuvImageCheck(img, 0, img->height/2))
+        return 0;
+    j.x = roi->x > 0 ? roi->x & ~1 : 0;                 // clip, and widen to even coordinates
+    j.y = roi->y > 0 ? roi->y & ~1 : 0;
+    x1 = roi->x + roi->width < img->width ? (roi->x + roi->width + 1) & ~1 : img->width;
+    y1 = roi->y + roi->height < img->height ? (roi->y + roi->height + 1) & ~1 : img->height;
+    if (x1 <= j.x || y1 <= j.y)
+        return 0;
+    j.img = img;
+    j.out = out;
+    j.format = format;
+    j.width = x1 - j.x;
+    if (parallel)
+        workerPoolRunRange(roiBand, (void *)&j, (y1-j.y)/2, MIN_CHUNK_PAIRS);
+    else
+        roiBand((void *)&j, 0, (y1-j.y)/2);
+    return 1;
+}
+
+int convertYUV420_NV21toRGB8888ROI(const unsigned char * data, int * pixels, int width, int height, const yuvRect *roi, int parallel)
+{
+    yuvImage img;
+
+    if (!yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width))
+        return 0;
+    return convertYUV420toFormatROI(&img, pixels, YUV_OUT_INT8888, roi, parallel);
+}
+
+yuvDirtyTracker *yuvDirtyCreate(int width, int height, int tileWidth, int tileHeight)
+{
+    yuvDirtyTracker *t;
+    long planes;
+
+    if ((width&1) || width < 2 || (height&1) || height < 2)
+        return NULL;
+    t = calloc(1, sizeof(*t));
+    if (!t)
+        return NULL;
+    t->width = width;
+    t->height = height;
+    t->tileWidth = tileWidth > 0 ? (tileWidth+1) & ~1 : YUV_DIRTY_TILE_WIDTH;
+    t->tileHeight = tileHeight > 0 ? (tileHeight+1) & ~1 : YUV_DIRTY_TILE_HEIGHT;
+    t->cols = (width + t->tileWidth-1)/t->tileWidth;
+    t->rows = (height + t->tileHeight-1)/t->tileHeight;
+    planes = (long)width*height*3/2;
+    t->prevY = malloc(planes + t->cols*t->rows);        // one block: planes, then the flags
+    if (!t->prevY) {
+        free(t);
+        return NULL;
+    }
+    t->prevU = t->prevY + (long)width*height;
+    t->prevV = t->prevU + (long)(width/2)*(height/2);
+    t->dirty = t->prevY + planes;
+    return t;
+}
+
+void yuvDirtyDestroy(yuvDirtyTracker *t)
+{
+    if (!t)
+        return;
+    free(t->prevY);
+    free(t);
+}
+
+void yuvDirtyReset(yuvDirtyTracker *t)
+{
+    t->valid = 0;
+}
+
+int yuvDirtyTileCount(const yuvDirtyTracker *t, int *cols, int *rows)
+{
+    if (cols)
+        *cols = t->cols;
+    if (rows)
+        *rows = t->rows;
+    return t->cols*t->rows;
+}
+
+void yuvDirtyTileRect(const yuvDirtyTracker *t, int tile, yuvRect *rect)
+{
+    rect->x = (tile % t->cols)*t->tileWidth;
+    rect->y = (tile / t->cols)*t->tileHeight;
+    rect->width = t->width - rect->x < t->tileWidth ? t->width - rect->x : t->tileWidth;
+    rect->height = t->height - rect->y < t->tileHeight ? t->height - rect->y : t->tileHeight;
+}
+
+// Sum of absolute differences of n bytes (vectorized by the compiler)
+static int sadRow(const unsigned char * a, const unsigned char * b, int n)
+{
+    int i, d, sad = 0;
+
+    for (i=0; i < n; i++) {
+        d = a[i] - b[i];
+        sad += d < 0 ? -d : d;
+    }
+    return sad;
+}
+
+// Same for samples pixelStride bytes apart in a (packed in b)
+static int sadSamples(const unsigned char * a, int pixelStride, const unsigned char * b, int n)
+{
+    int i, d, sad = 0;
+
+    if (pixelStride == 1)
+        return sadRow(a, b, n);
+    for (i=0; i < n; i++) {
+        d = a[i*pixelStride] - b[i];
+        sad += d < 0 ? -d : d;
+    }
+    return sad;
+}
+
+// Interleaved chroma (NV21, NV12) is compared and kept as rows of width bytes in prevU and prevV (the same
+// memory as the two planes), so that every row of a tile is one run of contiguous bytes
+static const unsigned char *interleaved(const yuvImage *img)
+{
+    int const layout = yuvChromaLayout(img);
+
+    if (layout == YUV_CHROMA_VU)
+        return img->v.data;
+    return layout == YUV_CHROMA_UV ? img->u.data : NULL;
+}
+
+// 1 if the SAD of the samples of the tile rc against their last conversion is over threshold
+// (stops as soon as it is)
+static int tileChanged(const yuvDirtyTracker *t, const yuvImage *img, const yuvRect *rc, int threshold)
+{
+    const unsigned char *uv = interleaved(img);
+    int const cw = t->width/2;
+    long long sad = 0;
+    int r;
+
+    for (r=rc->y; r < rc->y + rc->height; r++) {
+        sad += sadRow(img->y.data + r*img->y.rowStride + rc->x, t->prevY + (long)r*t->width + rc->x, rc->width);
+        if (sad > threshold)
+            return 1;
+    }
+    for (r=rc->y/2; r < (rc->y + rc->height)/2; r++) {
+        if (uv)
+            sad += sadRow(uv + r*img->u.rowStride + rc->x, t->prevU + (long)r*t->width + rc->x, rc->width);
+        else {
+            sad += sadSamples(img->u.data + r*img->u.rowStride + (rc->x/2)*img->u.pixelStride, img->u.pixelStride,
+                              t->prevU + (long)r*cw + rc->x/2, rc->width/2);
+            sad += sadSamples(img->v.data + r*img->v.rowStride + (rc->x/2)*img->v.pixelStride, img->v.pixelStride,
+                              t->prevV + (long)r*cw + rc->x/2, rc->width/2);
+        }
+        if (sad > threshold)
+            return 1;
+    }
+    return 0;
+}
+
+// Keep the samples of the tile rc just converted
+static void tileStore(yuvDirtyTracker *t, const yuvImage *img, const yuvRect *rc)
+{
+    const unsigned char *uv = interleaved(img);
+    int const cw = t->width/2;
+    int r, i;
+
+    for (r=rc->y; r < rc->y + rc->height; r++)
+        memcpy(t->prevY + (long)r*t->width + rc->x, img->y.data + r*img->y.rowStride + rc->x, rc->width);
+    for (r=rc->y/2; r < (rc->y + rc->height)/2; r++) {
+        const unsigned char *u = img->u.data + r*img->u.rowStride + (rc->x/2)*img->u.pixelStride;
+        const unsigned char *v = img->v.data + r*img->v.rowStride + (rc->x/2)*img->v.pixelStride;
+        unsigned char *pu = t->prevU + (long)r*cw + rc->x/2;
+        unsigned char *pv = t->prevV + (long)r*cw + rc->x/2;
+
+        if (uv)
+            memcpy(t->prevU + (long)r*t->width + rc->x, uv + r*img->u.rowStride + rc->x, rc->width);
+        else
+            for (i=0; i < rc->width/2; i++) {
+                pu[i] = u[i*img->u.pixelStride];
+                pv[i] = v[i*img->v.pixelStride];
+            }
+    }
+}
+
+typedef struct dirtyJob {  // operands of an incremental conversion, shared by all the rows of tiles
+    yuvDirtyTracker * t;
+    const yuvImage * img;
+    unsigned char * out;
+    int format;
+    int threshold;
+    int all;                    // convert every tile (first frame, reset, other colour space, format or layout)
+} dirtyJob;
+
+// Worker pool task: the rows of tiles [row0, row1). Each tile is compared, converted and stored by one thread
+static void dirtyRows(void *args, int row0, int row1)
+{
+    const dirtyJob *j = (const dirtyJob *)args;
+    yuvDirtyTracker *t = j->t;
+    yuvRect rc;
+    int i;
+
+    for (i=row0*t->cols; i < row1*t->cols; i++) {
+        yuvDirtyTileRect(t, i, &rc);
+        t->dirty[i] = j->all || tileChanged(t, j->img, &rc, j->threshold);
+        if (t->dirty[i]) {
+            convertRect(j->img, j->out, j->format, rc.x, rc.y, rc.width, rc.height);
+            tileStore(t, j->img, &rc);
+        }
+    }
+}
+
+int convertYUV420toFormatIncremental(yuvDirtyTracker *t, const yuvImage *img, void * out, int format,
+                                     int threshold, int * dirty, int parallel)
+{
+    dirtyJob j;
+    int i, n = 0;
+
+    if (!t || !out || !YUV_OUT_VALID(format) || img->width != t->width || img->height != t->height ||
+        !yuvImageCheck(img, 0, img->height/2))
+        return -1;
+    j.t = t;
+    j.img = img;
+    j.out = out;
+    j.format = format;
+    j.threshold = threshold > 0 ? threshold : 0;
+    j.all = !t->valid || t->coefs != yuvGetCoefs() || t->format != format || t->layout != yuvChromaLayout(img);
+    if (parallel)
+        workerPoolRunRange(dirtyRows, (void *)&j, t->rows, 1);
+    else
+        dirtyRows((void *)&j, 0, t->rows);
+    t->valid = 1;
+    t->coefs = yuvGetCoefs();
+    t->format = format;
+    t->layout = yuvChromaLayout(img);
+    for (i=0; i < t->cols*t->rows; i++)
+        if (t->dirty[i]) {
+            if (dirty)
+                dirty[n] = i;
+            n++;
+        }
+    return n;
+}
@@ -0,0 +1,62 @@
+//
+// Partial conversion into a persistent output buffer, for mostly static scenes:
+//
+// - Region of interest: only a rectangle of the frame is converted, the rest of the output is left untouched.
+// - Incremental: the frame is split in tiles and a tracker keeps the Y, U and V samples each tile had when it
+//   was last converted. A tile is converted again only if the sum of absolute differences (SAD) of its samples
+//   against them goes over a threshold, and the tiles converted are returned as a dirty list, so the display
+//   can be updated partially too. With threshold 0 any change is a change and the output is always the image of
+//   the whole frame; above 0, sensor noise stops converting static tiles but small changes are kept back until
+//   they add up to the threshold.
+//
+// The rectangles are converted with the SIMD kernel of the layout (yuvplanes.h) through a small scratch buffer
+// (whole rows straight into the output), so the pixels are the same as the ones of a whole frame conversion.
+//
+
+#ifndef YUVROI_H
+#define YUVROI_H
+
+#include "yuvplanes.h"
+
+#define YUV_DIRTY_TILE_WIDTH  64    // default tile size of the trackers
+#define YUV_DIRTY_TILE_HEIGHT 32
+
+typedef struct yuvRect {
+    int x;
+    int y;
+    int width;
+    int height;
+} yuvRect;
+
+// Convert the rectangle roi of img into out (img->width x img->height pixels of format, persistent). The
+// rectangle is clipped to the image and widened to even coordinates. parallel: bands on the worker pool.
+// Return 0 (nothing converted) if the arguments are not valid or the rectangle is empty once clipped
+int convertYUV420toFormatROI(const yuvImage *img, void * out, int format, const yuvRect *roi, int parallel);
+
+// Same for an NV21 frame into width*height ints
+int convertYUV420_NV21toRGB8888ROI(const unsigned char * data, int * pixels, int width, int height, const yuvRect *roi, int parallel);
+
+typedef struct yuvDirtyTracker yuvDirtyTracker;
+
+// Tracker of the frames of width x height (tiles of tileWidth x tileHeight, rounded up to even, defaults
+// if <= 0; the last row and column of tiles may be smaller). NULL if the size is not valid or out of memory
+yuvDirtyTracker *yuvDirtyCreate(int width, int height, int tileWidth, int tileHeight);
+void yuvDirtyDestroy(yuvDirtyTracker *t);
+
+// Convert every tile on the next frame. Needed when the output buffer is replaced or written by something
+// else; a change of colour space (yuvSetColorSpace) or of output format is detected
+void yuvDirtyReset(yuvDirtyTracker *t);
+
+// Number of tiles (cols*rows) and their grid. Tile i is at column i%cols, row i/cols
+int yuvDirtyTileCount(const yuvDirtyTracker *t, int *cols, int *rows);
+
+// Rectangle of tile i (clipped to the frame)
+void yuvDirtyTileRect(const yuvDirtyTracker *t, int tile, yuvRect *rect);
+
+// Convert the tiles of img (the size of the tracker) whose SAD against their last conversion is over threshold
+// into out. dirty (may be NULL, room for yuvDirtyTileCount tiles) gets the indices of the tiles converted, in
+// increasing order. Returns how many, or -1 (nothing converted) if the arguments are not valid
+int convertYUV420toFormatIncremental(yuvDirtyTracker *t, const yuvImage *img, void * out, int format,
+                                     int threshold, int * dirty, int parallel);
+
+#endif
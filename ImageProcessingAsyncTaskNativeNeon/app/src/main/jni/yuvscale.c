@@ -0,0 +1,191 @@
+//
+// Fused YUV420 NV21 -> RGB conversion, scaling and rotation (see yuvscale.h).
+// Every output row is built in chunks: the Y, U and V samples of the chunk are gathered (or
+// interpolated) from the NV21 planes into small buffers and then converted with the YUV 4:4:4
+// row kernel (NEON or SSE4.1 when available) straight into the output format, so only the sampled
+// pixels are ever converted and nothing is swizzled afterwards.
+//
+
+#include "framearena.h"
+#include "workerpool.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+#include "yuvscale.h"
+
+#define CHUNK 256          // output pixels gathered before each call to the row kernel
+
+typedef struct scaleTap {  // source samples of one output coordinate along one source axis, as byte offsets
+    int o0, o1;            // luma samples (o1 is the next sample, or o0 at the border)
+    int f;                 // weight of o1, in 1/256 (0 for nearest)
+    int c0, c1;            // same for the interleaved chroma plane (half resolution)
+    int cf;
+} scaleTap;
+
+typedef struct scaleJob {  // operands shared by all the bands of a frame
+    const unsigned char * data;
+    int width;
+    int height;
+    unsigned char * out;
+    int format;                // YUV_OUT_*
+    int outWidth;
+    int outHeight;
+    int filter;
+    const scaleTap * colTaps;  // one per output column
+    const scaleTap * rowTaps;  // one per output row
+} scaleJob;
+
+// Taps of the output coordinate o (out of nOut) on a source axis of nIn samples, mirrored or not.
+// Along x the offsets are in bytes (chroma: 2 bytes per sample); along y (vertical) they are in rows of width bytes.
+// A source pixel is then at rowTap + colTap whatever the rotation.
+static void computeTap(scaleTap *t, int o, int nOut, int nIn, int mirror, int filter, int vertical, int width)
+{
+    int const last = nIn-1, clast = nIn/2-1;
+    int const lumaStep = vertical ? width : 1;
+    int const chromaStep = vertical ? width : 2;
+    int p, cp, i0;
+
+    if (filter == YUV_SCALE_NEAREST) {
+        p = (int)((long long)o*nIn/nOut);      // top-left sampling, as Support.downscaleAndRotateImage
+        i0 = mirror ? last-p : p;
+        t->o0 = t->o1 = i0*lumaStep;
+        t->c0 = t->c1 = (i0 >> 1)*chromaStep;  // chroma of the 2x2 block of the sample
+        t->f = t->cf = 0;
+        return;
+    }
+    // centre of the output sample in source coordinates, in 1/256 of a sample
+    p = (int)(((2LL*o + 1)*nIn*256)/(2LL*nOut)) - 128;
+    if (p < 0) p = 0;
+    if (p > last*256) p = last*256;
+    if (mirror) p = last*256 - p;
+    // chroma samples are centred between two luma samples
+    cp = (p - 128) >> 1;
+    if (cp < 0) cp = 0;
+    if (cp > clast*256) cp = clast*256;
+
+    i0 = p >> 8;
+    t->o0 = i0*lumaStep;
+    t->o1 = (i0 < last ? i0+1 : last)*lumaStep;
+    t->f = p & 255;
+    i0 = cp >> 8;
+    t->c0 = i0*chromaStep;
+    t->c1 = (i0 < clast ? i0+1 : clast)*chromaStep;
+    t->cf = cp & 255;
+}
+
+// Bilinear interpolation of the 4 samples p[a + b], a in {a0, a1}, b in {b0, b1} (weights fa, fb in 1/256)
+static inline unsigned char lerp2(const unsigned char *p, int a0, int a1, int fa, int b0, int b1, int fb)
+{
+    int const s0 = p[a0+b0]*(256-fb) + p[a0+b1]*fb;
+    int const s1 = p[a1+b0]*(256-fb) + p[a1+b1]*fb;
+
+    return (unsigned char)((s0*(256-fa) + s1*fa + 32768) >> 16);
+}
+
+// Convert the output rows [row0, row1)
+static void scaleRows(const scaleJob *job, int row0, int row1)
+{
+    unsigned char ybuf[CHUNK], ubuf[CHUNK], vbuf[CHUNK];
+    const unsigned char *uvPlane = job->data + job->width*job->height;
+    int const bpp = YUV_OUT_BYTES(job->format);
+    int oy, ox, k, n;
+
+    for (oy=row0; oy < row1; oy++) {
+        const scaleTap *rt = &job->rowTaps[oy];
+        unsigned char *out = job->out + (size_t)oy*job->outWidth*bpp;
+
+        for (ox=0; ox < job->outWidth; ox+=n) {
+            n = job->outWidth - ox < CHUNK ? job->outWidth - ox : CHUNK;
+            for (k=0; k < n; k++) {
+                const scaleTap *ct = &job->colTaps[ox+k];
+
+                if (job->filter == YUV_SCALE_NEAREST) {
+                    const unsigned char *uv = uvPlane + rt->c0 + ct->c0;
+                    ybuf[k] = job->data[rt->o0 + ct->o0];
+                    vbuf[k] = uv[0];            // V U pairs
+                    ubuf[k] = uv[1];
+                } else {
+                    ybuf[k] = lerp2(job->data, rt->o0, rt->o1, rt->f, ct->o0, ct->o1, ct->f);
+                    vbuf[k] = lerp2(uvPlane, rt->c0, rt->c1, rt->cf, ct->c0, ct->c1, ct->cf);
+                    ubuf[k] = lerp2(uvPlane+1, rt->c0, rt->c1, rt->cf, ct->c0, ct->c1, ct->cf);
+                }
+            }
+            convertYUV444toFormatRow_SIMD(ybuf, ubuf, vbuf, out + ox*bpp, job->format, n);
+        }
+    }
+}
+
+// Worker pool task: the output rows [row0, row1)
+static void scaleBand(void *args, int row0, int row1)
+{
+    scaleRows((const scaleJob *)args, row0, row1);
+}
+
+static int runScaled(const unsigned char * data, int width, int height, void * out, int format, int outWidth, int outHeight,
+                     int angle, int filter, int parallel)
+{
+    scaleJob job;
+    scaleTap *taps;
+    int i, swap;
+
+    if (!data || !out || !YUV_OUT_VALID(format) || width < 2 || (width&1) || height < 2 || (height&1) || outWidth < 1 || outHeight < 1 ||
+        (angle != 0 && angle != 90 && angle != 180 && angle != 270) ||
+        (filter != YUV_SCALE_NEAREST && filter != YUV_SCALE_BILINEAR))
+        return 0;
+    taps = yuvScratch(YUV_SCRATCH_SCALE, (outWidth + outHeight)*sizeof(scaleTap));     // kept for the next frame
+    if (!taps)
+        return 0;
+
+    // clockwise rotation: source x runs along the output columns (0, 180) or the output rows (90, 270),
+    // backwards for 180 and 270; source y runs along the other output axis, backwards for 90 and 180
+    swap = (angle == 90 || angle == 270);
+    for (i=0; i < outWidth; i++)
+        if (swap)
+            computeTap(&taps[i], i, outWidth, height, angle == 90, filter, 1, width);
+        else
+            computeTap(&taps[i], i, outWidth, width, angle == 180, filter, 0, width);
+    for (i=0; i < outHeight; i++)
+        if (swap)
+            computeTap(&taps[outWidth+i], i, outHeight, width, angle == 270, filter, 0, width);
+        else
+            computeTap(&taps[outWidth+i], i, outHeight, height, angle == 180, filter, 1, width);
+
+    job.data = data;
+    job.width = width;
+    job.height = height;
+    job.out = out;
+    job.format = format;
+    job.outWidth = outWidth;
+    job.outHeight = outHeight;
+    job.filter = filter;
+    job.colTaps = taps;
+    job.rowTaps = taps + outWidth;
+    if (parallel)
+        workerPoolRunRange(scaleBand, (void *)&job, outHeight, 4);
+    else
+        scaleRows(&job, 0, outHeight);
+    return 1;
+}
+
+int convertYUV420_NV21toRGB8888Scaled(const unsigned char * data, int width, int height,
+                                      int * out, int outWidth, int outHeight, int angle, int filter)
+{
+    return runScaled(data, width, height, out, YUV_OUT_INT8888, outWidth, outHeight, angle, filter, 0);
+}
+
+int convertYUV420_NV21toRGB8888ScaledPool(const unsigned char * data, int width, int height,
+                                          int * out, int outWidth, int outHeight, int angle, int filter)
+{
+    return runScaled(data, width, height, out, YUV_OUT_INT8888, outWidth, outHeight, angle, filter, 1);
+}
+
+int convertYUV420_NV21toFormatScaled(const unsigned char * data, int width, int height,
+                                     void * out, int format, int outWidth, int outHeight, int angle, int filter)
+{
+    return runScaled(data, width, height, out, format, outWidth, outHeight, angle, filter, 0);
+}
+
+int convertYUV420_NV21toFormatScaledPool(const unsigned char * data, int width, int height,
+                                         void * out, int format, int outWidth, int outHeight, int angle, int filter)
+{
+    return runScaled(data, width, height, out, format, outWidth, outHeight, angle, filter, 1);
+}
@@ -0,0 +1,32 @@
+//
+// Fused YUV420 NV21 -> RGB conversion, scaling and rotation.
+// Only the source pixels that are sampled are converted, and the output is written directly in
+// its final size and orientation (no full-size RGB intermediate image).
+//
+
+#ifndef YUVSCALE_H
+#define YUVSCALE_H
+
+#define YUV_SCALE_NEAREST  0
+#define YUV_SCALE_BILINEAR 1
+
+// Convert the width x height NV21 frame into out (outWidth x outHeight ints 0xAARRGGBB), rotated clockwise
+// "angle" degrees (0, 90, 180 or 270, as the camera display orientation). For 90 and 270 the
+// source width is scaled to outHeight and the source height to outWidth.
+// filter is YUV_SCALE_NEAREST (same sampling as Support.downscaleAndRotateImage) or YUV_SCALE_BILINEAR
+// (Y and UV interpolated before the conversion). Returns 0 (and does nothing) if the arguments are not valid.
+int convertYUV420_NV21toRGB8888Scaled(const unsigned char * data, int width, int height,
+                                      int * out, int outWidth, int outHeight, int angle, int filter);
+
+// Same, with the output rows split in bands on the persistent worker pool
+int convertYUV420_NV21toRGB8888ScaledPool(const unsigned char * data, int width, int height,
+                                          int * out, int outWidth, int outHeight, int angle, int filter);
+
+// Same, into outWidth x outHeight pixels of the output format (yuvplanes.h YUV_OUT_*), stored by the conversion
+// itself: e.g. YUV_OUT_RGBA8888 for the memory of a Bitmap ARGB_8888. The RGB8888 versions are YUV_OUT_INT8888
+int convertYUV420_NV21toFormatScaled(const unsigned char * data, int width, int height,
+                                     void * out, int format, int outWidth, int outHeight, int angle, int filter);
+int convertYUV420_NV21toFormatScaledPool(const unsigned char * data, int width, int height,
+                                         void * out, int format, int outWidth, int outHeight, int angle, int filter);
+
+#endif
@@ -0,0 +1,218 @@
+//
+// Conversion with fused frame statistics (see yuvstats.h)
+//
+
+#include <string.h>
+#include <pthread.h>
+#include <omp.h>
+#include "framearena.h"
+#include "workerpool.h"
+#include "yuvconvert.h"
+#include "yuvstats.h"
+
+#define CHUNK_PAIRS 4           // row pairs claimed at a time by the threads of the pthread version
+#define MIN_CHUNK_PAIRS 2       // smallest chunk of the worker pool version
+
+typedef struct statsJob {  // operands shared by all the threads of a conversion
+    const unsigned char * data;
+    int * pixels;
+    int width;
+    int height;
+    int simd;                   // cleared by a thread that had to use the scalar kernel
+    int nextPair;               // pthread version: first row pair not claimed yet (atomic)
+    yuvStats * parts;           // worker pool and OpenMP versions: one per thread (workerPoolWorkerId, omp_get_thread_num),
+                                // in the scratch of the caller (framearena.h)
+} statsJob;
+
+typedef struct statsThread {   // pthread version: operands of each thread
+    statsJob * job;
+    yuvStats stats;
+} statsThread;
+
+// Count n Y samples and the n pixels converted from them
+static void countRow(yuvStats *s, const unsigned char * y, const int * px, int n)
+{
+    unsigned int sum = 0, sumSq = 0;   // no overflow below 66000 samples per row
+    int i, v, p;
+
+    for (i=0; i < n; i++) {
+        v = y[i];
+        p = px[i];
+        s->histY[v]++;
+        sum += v;
+        sumSq += v*v;
+        s->histR[(p >> 16) & 0xff]++;
+        s->histG[(p >> 8) & 0xff]++;
+        s->histB[p & 0xff]++;
+    }
+    s->sumY += sum;
+    s->sumSqY += sumSq;
+}
+
+// Convert the row pairs [pair0, pair1) one by one, counting each pair while it is in the cache
+static void statsRows(statsJob *j, yuvStats *s, int pair0, int pair1)
+{
+    int const w = j->width;
+    int pair, row;
+
+    for (pair=pair0; pair < pair1; pair++) {
+        if (!convertYUV420_NV21toRGB8888_SIMDRows(j->data, j->pixels, w, j->height, pair, pair+1))
+            __atomic_store_n(&j->simd, 0, __ATOMIC_RELAXED);
+        for (row=2*pair; row < 2*pair+2; row++)
+            countRow(s, j->data + row*w, j->pixels + row*w, w);
+    }
+}
+
+void yuvStatsMerge(yuvStats *total, const yuvStats *part)
+{
+    int i;
+
+    for (i=0; i < 256; i++) {
+        total->histY[i] += part->histY[i];
+        total->histR[i] += part->histR[i];
+        total->histG[i] += part->histG[i];
+        total->histB[i] += part->histB[i];
+    }
+    total->count += part->count;
+    total->sumY += part->sumY;
+    total->sumSqY += part->sumSqY;
+}
+
+// Count and range of Y from the merged histogram
+static void statsFinish(const statsJob *j, yuvStats *s)
+{
+    int i;
+
+    s->count = (long long)j->width*j->height;
+    s->minY = 255;
+    s->maxY = 0;
+    for (i=0; i < 256; i++)
+        if (s->histY[i]) {
+            if (s->minY > i)
+                s->minY = i;
+            s->maxY = i;
+        }
+}
+
+static void statsStart(statsJob *j, const unsigned char * data, int * pixels, int width, int height, yuvStats *stats)
+{
+    memset(j, 0, sizeof(*j));
+    j->data = data;
+    j->pixels = pixels;
+    j->width = width;
+    j->height = height;
+    j->simd = 1;
+    memset(stats, 0, sizeof(*stats));
+}
+
+int convertYUV420_NV21toRGB8888Stats(const unsigned char * data, int * pixels, int width, int height, yuvStats *stats)
+{
+    statsJob j;
+
+    statsStart(&j, data, pixels, width, height, stats);
+    statsRows(&j, stats, 0, height/2);
+    statsFinish(&j, stats);
+    return j.simd;
+}
+
+// Worker pool task: the row pairs [pair0, pair1), counted in the bins of the thread
+static void statsRange(void *args, int pair0, int pair1)
+{
+    statsJob *j = (statsJob *)args;
+
+    statsRows(j, &j->parts[workerPoolWorkerId()], pair0, pair1);
+}
+
+int convertYUV420_NV21toRGB8888StatsPool(const unsigned char * data, int * pixels, int width, int height, yuvStats *stats)
+{
+    statsJob j;
+    int i;
+
+    statsStart(&j, data, pixels, width, height, stats);
+    j.parts = yuvScratch(YUV_SCRATCH_STATS, MAX_POOL_THREADS*sizeof(yuvStats));
+    if (!j.parts)
+        return convertYUV420_NV21toRGB8888Stats(data, pixels, width, height, stats);
+    memset(j.parts, 0, MAX_POOL_THREADS*sizeof(yuvStats));
+    workerPoolRunRange(statsRange, (void *)&j, height/2, MIN_CHUNK_PAIRS);
+    for (i=0; i < MAX_POOL_THREADS; i++)
+        yuvStatsMerge(stats, &j.parts[i]);
+    statsFinish(&j, stats);
+    return j.simd;
+}
+
+// Claim chunks of CHUNK_PAIRS row pairs until none is left
+static void statsDrain(statsThread *t)
+{
+    int const pairs = t->job->height/2;
+    int pair0;
+
+    while ((pair0 = __atomic_fetch_add(&t->job->nextPair, CHUNK_PAIRS, __ATOMIC_RELAXED)) < pairs)
+        statsRows(t->job, &t->stats, pair0, pair0+CHUNK_PAIRS < pairs ? pair0+CHUNK_PAIRS : pairs);
+}
+
+// pthread entry point
+static void *statsChunk(void *args)
+{
+    statsDrain((statsThread *)args);
+    pthread_exit(NULL);
+}
+
+int convertYUV420_NV21toRGB8888StatsParallel(const unsigned char * data, int * pixels, int width, int height, int nthr, yuvStats *stats)
+{
+    pthread_t th[MAX_NUM_THREADS];
+    statsThread *threads;
+    statsJob j;
+    int i, created;
+
+    if (nthr > MAX_NUM_THREADS)
+        nthr = MAX_NUM_THREADS;
+    if (nthr < 1)
+        nthr = 1;
+    statsStart(&j, data, pixels, width, height, stats);
+    threads = yuvScratch(YUV_SCRATCH_STATS, nthr*sizeof(statsThread));
+    if (!threads)
+        return convertYUV420_NV21toRGB8888Stats(data, pixels, width, height, stats);
+    memset(threads, 0, nthr*sizeof(statsThread));
+    for (created=0; created < nthr; created++) {
+        threads[created].job = &j;
+        if (pthread_create(&th[created], NULL, statsChunk, (void *)&threads[created]) != 0)
+            break;
+    }
+    if (created < nthr) {       // no more threads: the caller claims the remaining rows
+        statsDrain(&threads[created]);
+        yuvStatsMerge(stats, &threads[created].stats);
+    }
+    for (i=0; i < created; i++) {
+        pthread_join(th[i], NULL);
+        yuvStatsMerge(stats, &threads[i].stats);
+    }
+    statsFinish(&j, stats);
+    return j.simd;
+}
+
+int convertYUV420_NV21toRGB8888Stats_OMP(const unsigned char * data, int * pixels, int width, int height, yuvStats *stats)
+{
+    int const pairs = height/2;
+    int const nparts = omp_get_max_threads();
+    statsJob j;
+    int i;
+
+    statsStart(&j, data, pixels, width, height, stats);
+    j.parts = yuvScratch(YUV_SCRATCH_STATS, nparts*sizeof(yuvStats));
+    if (!j.parts)
+        return convertYUV420_NV21toRGB8888Stats(data, pixels, width, height, stats);
+    memset(j.parts, 0, nparts*sizeof(yuvStats));
+#pragma omp parallel
+    {
+        yuvStats *mine = &j.parts[omp_get_thread_num()];
+        int pair;
+
+#pragma omp for schedule(dynamic, CHUNK_PAIRS)
+        for (pair=0; pair < pairs; pair++)
+            statsRows(&j, mine, pair, pair+1);
+    }
+    for (i=0; i < nparts; i++)
+        yuvStatsMerge(stats, &j.parts[i]);
+    statsFinish(&j, stats);
+    return j.simd;
+}
@@ -0,0 +1,35 @@
+//
+// Frame statistics (exposure control, histograms) computed by the conversion itself. Each row pair is converted
+// with the selected SIMD kernel and its Y samples and RGB pixels are counted right after, while they are still
+// in the L1 cache: the frame is not read again from memory by a second pass over Y or over the output.
+// Every thread counts into its own private bins (no atomics, no shared cache lines), merged once at the end.
+//
+
+#ifndef YUVSTATS_H
+#define YUVSTATS_H
+
+typedef struct yuvStats {
+    unsigned int histY[256];    // Y samples as stored in the frame
+    unsigned int histR[256];    // channels of the converted pixels
+    unsigned int histG[256];
+    unsigned int histB[256];
+    long long count;            // pixels
+    long long sumY;             // mean = sumY/count, variance = sumSqY/count - mean^2
+    long long sumSqY;
+    int minY;                   // 255 and 0 if count is 0
+    int maxY;
+} yuvStats;
+
+// Convert the NV21 frame as convertYUV420_NV21toRGB8888_SIMD does and fill stats (1 if the SIMD kernel was used)
+int convertYUV420_NV21toRGB8888Stats(const unsigned char * data, int * pixels, int width, int height, yuvStats *stats);
+
+// Same in parallel: on the worker pool, with nthr pthreads created for the frame, and with OpenMP (the number
+// of threads set with omp_set_num_threads)
+int convertYUV420_NV21toRGB8888StatsPool(const unsigned char * data, int * pixels, int width, int height, yuvStats *stats);
+int convertYUV420_NV21toRGB8888StatsParallel(const unsigned char * data, int * pixels, int width, int height, int nthr, yuvStats *stats);
+int convertYUV420_NV21toRGB8888Stats_OMP(const unsigned char * data, int * pixels, int width, int height, yuvStats *stats);
+
+// Add the bins and sums of part to total (minY/maxY are set by the functions above once merged)
+void yuvStatsMerge(yuvStats *total, const yuvStats *part);
+
+#endif
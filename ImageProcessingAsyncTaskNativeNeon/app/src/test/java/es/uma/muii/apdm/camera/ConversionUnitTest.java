@@ -0,0 +1,136 @@
+package es.uma.muii.apdm.ImageProcessingNative;
+
+import org.junit.After;
+import org.junit.Test;
+
+import java.util.Random;
+
+import static org.junit.Assert.*;
+
+/**
+ * Java backends against the same golden reference as the native suite (host/yuvtest.c): the conversion computed
+ * in double precision from the definition of each colour space, with the conventions of jni/yuv2rgb.h.
+ * The sequential and parallel versions must give the same image, within GOLDEN_TOLERANCE of the reference.
+ */
+public class ConversionUnitTest {
+
+    private static final int GOLDEN_TOLERANCE = 1;      // max difference per channel, as in host/yuvtest.c
+
+    private static final int[][] SIZES = { {2, 2}, {6, 4}, {18, 14}, {66, 34}, {322, 242} };
+
+    @After
+    public void restoreColorSpace() {
+        YUVtoRGB.setColorSpace(YUVtoRGB.BT601, false);
+    }
+
+    // 0xAARRGGBB of Y, U, V (stored bytes; the first byte of an NV21 chroma pair is V, the second U)
+    private static int goldenPixel(int matrix, boolean fullRange, int y, int u, int v) {
+        double kr = matrix == YUVtoRGB.BT709 ? 0.2126 : 0.299;
+        double kb = matrix == YUVtoRGB.BT709 ? 0.0722 : 0.114;
+        double kg = 1.0 - kr - kb;
+        double ys = fullRange ? 1.0 : 255.0/219.0;
+        double cs = fullRange ? 1.0 : 255.0/224.0;
+        int yoff = fullRange ? 0 : 16;
+        double yy = ys*Math.max(y - yoff, 0);
+        double r = yy + cs*2*(1-kr)*(v-128);
+        double g = yy - cs*2*(1-kb)*kb/kg*(u-128) - cs*2*(1-kr)*kr/kg*(v-128);
+        double b = yy + cs*2*(1-kb)*(u-128);
+        return 0xff000000 | (roundClamp(r) << 16) | (roundClamp(g) << 8) | roundClamp(b);
+    }
+
+    private static int roundClamp(double x) {
+        return (int)Math.max(0, Math.min(255, Math.floor(x + 0.5)));
+    }
+
+    private static int channelDiff(int p, int q) {
+        int max = 0;
+        for (int s=0; s < 32; s+=8)
+            max = Math.max(max, Math.abs(((p >> s) & 0xff) - ((q >> s) & 0xff)));
+        return max;
+    }
+
+    // Random bytes, or only 0 and 255 (every channel saturated one way or the other)
+    private static byte[] frame(int width, int height, boolean extremes, long seed) {
+        byte[] data = new byte[width*height*3/2];
+        new Random(seed).nextBytes(data);
+        if (extremes)
+            for (int i=0; i < data.length; i++)
+                data[i] = (byte)((data[i] & 1) != 0 ? 255 : 0);
+        return data;
+    }
+
+    @Test
+    public void sequentialMatchesGolden() throws Exception {
+        for (int matrix=YUVtoRGB.BT601; matrix <= YUVtoRGB.BT709; matrix++)
+            for (boolean fullRange : new boolean[] { false, true }) {
+                YUVtoRGB.setColorSpace(matrix, fullRange);
+                for (int[] size : SIZES)
+                    for (boolean extremes : new boolean[] { false, true }) {
+                        int width = size[0], height = size[1], npix = width*height;
+                        byte[] data = frame(width, height, extremes, width*31 + height);
+                        int[] pixels = new int[npix];
+
+                        YUVtoRGB.convertYUV420_NV21toRGB8888(data, pixels, width, height);
+                        for (int j=0; j < height; j++)
+                            for (int i=0; i < width; i++) {
+                                int k = npix + (j/2)*width + (i & ~1);
+                                int golden = goldenPixel(matrix, fullRange, data[j*width+i] & 0xff, data[k+1] & 0xff, data[k] & 0xff);
+                                assertTrue("(" + i + "," + j + ") of " + width + "x" + height + " in matrix " + matrix +
+                                           (fullRange ? " full" : " limited") + " range",
+                                           channelDiff(pixels[j*width+i], golden) <= GOLDEN_TOLERANCE);
+                            }
+                    }
+            }
+    }
+
+    @Test
+    public void parallelMatchesSequential() throws Exception {
+        for (int nThreads : new int[] { 1, 3, 4, 7 }) {
+            YUVtoRGBParallel parallel = new YUVtoRGBParallel(nThreads);
+            try {
+                for (int[] size : SIZES) {
+                    int width = size[0], height = size[1];
+                    byte[] data = frame(width, height, false, nThreads*1000 + width);
+                    int[] expected = new int[width*height];
+                    int[] pixels = new int[width*height];
+
+                    YUVtoRGB.convertYUV420_NV21toRGB8888(data, expected, width, height);
+                    parallel.convertYUV420_NV21toRGB8888_parallel(data, pixels, width, height);
+                    assertArrayEquals(nThreads + " threads, " + width + "x" + height, expected, pixels);
+                }
+            } finally {
+                parallel.shutdown();
+            }
+        }
+    }
+
+    // Source pixel of output (r, c) for an integer stride s, as downscaleAndRotateImage samples it
+    private static int source(int[] in, int wIn, int hIn, int r, int c, int s, int angle) {
+        switch (angle) {
+            case 0:   return in[(r*s)*wIn + c*s];
+            case 90:  return in[(hIn-1 - c*s)*wIn + r*s];
+            case 180: return in[(hIn-1 - r*s)*wIn + (wIn-1 - c*s)];
+            default:  return in[(c*s)*wIn + (wIn-1 - r*s)];
+        }
+    }
+
+    @Test
+    public void downscaleAndRotate() throws Exception {
+        int wIn = 64, hIn = 48;
+        int[] in = new int[wIn*hIn];
+        for (int i=0; i < in.length; i++)
+            in[i] = i;
+        for (int s : new int[] { 1, 2 })
+            for (int angle=0; angle < 360; angle+=90) {
+                int wOut = (angle % 180 == 0 ? wIn : hIn)/s;
+                int hOut = (angle % 180 == 0 ? hIn : wIn)/s;
+                int[] out = new int[wOut*hOut];
+
+                Support.downscaleAndRotateImage(in, out, wIn, hIn, wOut, hOut, angle);
+                for (int r=0; r < hOut; r++)
+                    for (int c=0; c < wOut; c++)
+                        assertEquals("rotation " + angle + ", stride " + s + ", (" + c + "," + r + ")",
+                                     source(in, wIn, hIn, r, c, s, angle), out[r*wOut + c]);
+            }
+    }
+}
@@ -0,0 +1,18 @@
+//
+// Host stand-in for the NDK <android/log.h>: messages go to stderr
+//
+
+#ifndef HOST_ANDROID_LOG_H
+#define HOST_ANDROID_LOG_H
+
+#include <stdio.h>
+
+#define ANDROID_LOG_DEBUG 3
+#define ANDROID_LOG_INFO 4
+#define ANDROID_LOG_WARN 5
+#define ANDROID_LOG_ERROR 6
+
+#define __android_log_print(prio, tag, ...) \
+    (fprintf(stderr, "%s: ", (tag)), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+
+#endif
@@ -0,0 +1,643 @@
+//
+// Host benchmark of the YUV420 NV21 -> RGB8888 backends over synthetic frames.
+// For each backend and resolution it reports the median and p99 latency of a frame,
+// the throughput in Mpixels/s and the memory bandwidth in GB/s (NV21 read + output written, RGBA unless said otherwise).
+//
+// -j simulates the copies a copying VM does around the JNI call, to measure what the zero-copy
+// entry points save (the MB copied per frame are reported):
+//   copy     Get<Type>ArrayElements + release with mode 0 (input and output copied in and back out)
+//   abort    the same, but the input is released with JNI_ABORT (not copied back)
+//   direct   direct ByteBuffers or pinned critical arrays: no copies (default)
+//
+// -T sets the tiles of the OpenMP kernel (row pairs, and columns for 2D tiles; default 8 row pairs x whole rows).
+// -c adds the last level cache misses per frame of every backend, counted with perf_event_open over all the
+// threads of the process (not available if the kernel does not allow it, see /proc/sys/kernel/perf_event_paranoid).
+// -d sets the scheduling of the rows on the worker pool (workerpool.h): static (one equal range per thread),
+// chunks (fixed chunks claimed from an atomic counter) or adaptive (the default). -L runs that many threads that
+// keep a core busy during the measurements: some workers are then slower than the others, as on big.LITTLE cores
+// or with other work on the device, which is what the dynamic schedules are for (compare the p99).
+// The roi and incr rows convert part of the frame (their Mpix/s and GB/s count the whole frame): roi-1/16 the
+// centered 1/16 of it, incr-static the same frame every time (the tiles are only compared), incr-moving a small
+// block moving over a static frame.
+// -p adds the stage profiler (yuvprofile.h) of every backend: p50/p99 of the JNI copies and of the conversion,
+// and the busy time of each worker of the pool, pthread and OpenMP runtimes over the timed frames.
+//
+//   yuvbench [-n iterations] [-t threads] [-s WIDTHxHEIGHT] [-b backend] [-j copy|abort|direct] [-T PAIRS[xCOLS]] [-c] [-p]
+//            [-d static|chunks|adaptive] [-L load threads]
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <omp.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#include "workerpool.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+#include "yuvscale.h"
+#include "yuvfilter.h"
+#include "yuvprofile.h"
+#include "yuvroi.h"
+#include "yuvstats.h"
+
+typedef struct backend {
+    const char *name;
+    int (*run)(const unsigned char *data, int *pixels, int width, int height, int nthr);   // 0 if not supported
+    int outBytes;       // bytes written per pixel, for GB/s (0: 4, RGBA)
+} backend;
+
+static int runScalar(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toRGB8888(data, pixels, width, height);
+    return 1;
+}
+
+static int runLUT(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toRGB8888_LUT(data, pixels, width, height);
+    return 1;
+}
+
+static int runPthread(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toRGB8888Parallel(data, pixels, width, height, nthr);
+    return 1;
+}
+
+static int runPool(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toRGB8888Pool(data, pixels, width, height);
+    return 1;
+}
+
+static int runLUTPool(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toRGB8888LUTPool(data, pixels, width, height);
+    return 1;
+}
+
+static int runOMP(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toRGB8888_OMP(data, pixels, width, height);
+    return 1;
+}
+
+static int runNEON(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return (yuvCPUFeatures() & YUV_CPU_NEON) && convertYUV420_NV21toRGB8888_NEON(data, pixels, width, height);
+}
+
+static int runNEON64(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return (yuvCPUFeatures() & YUV_CPU_NEON) && convertYUV420_NV21toRGB8888_NEON64(data, pixels, width, height);
+}
+
+static int runSSE41(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return (yuvCPUFeatures() & YUV_CPU_SSE41) && convertYUV420_NV21toRGB8888_SSE41(data, pixels, width, height);
+}
+
+static int runAVX2(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return (yuvCPUFeatures() & YUV_CPU_AVX2) && convertYUV420_NV21toRGB8888_AVX2(data, pixels, width, height);
+}
+
+static int runSIMDPool(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return convertYUV420_NV21toRGB8888_SIMDParallel(data, pixels, width, height);
+}
+
+// Plane descriptor API: the NV21 frame read as another packed format (same bytes, another layout),
+// with the selected SIMD kernel on the worker pool. n/a if that format does not fit in the frame
+static int runFormat(int format, const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvImage img;
+
+    return yuvBufferSize(format, width, height, width) <= width*height*3/2 &&
+           yuvImageFromBuffer(&img, data, format, width, height, width) && convertYUV420toRGB8888_SIMDParallel(&img, pixels);
+}
+
+static int runPlanesNV21(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runFormat(YUV_FORMAT_NV21, data, pixels, width, height);
+}
+
+static int runPlanesNV12(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runFormat(YUV_FORMAT_NV12, data, pixels, width, height);
+}
+
+static int runPlanesI420(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runFormat(YUV_FORMAT_I420, data, pixels, width, height);
+}
+
+static int runPlanesYV12(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runFormat(YUV_FORMAT_YV12, data, pixels, width, height);
+}
+
+// NV21 into the other output formats (pixels holds the packed output), SIMD on the worker pool
+static int runOutput(int format, const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvImage img;
+
+    return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) &&
+           convertYUV420toFormat_SIMDParallel(&img, pixels, format);
+}
+
+static int runOutRGBA(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runOutput(YUV_OUT_RGBA8888, data, pixels, width, height);
+}
+
+static int runOut565(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runOutput(YUV_OUT_RGB565, data, pixels, width, height);
+}
+
+static int runOut888(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runOutput(YUV_OUT_RGB888, data, pixels, width, height);
+}
+
+// NV21 with rows padded to a multiple of 64 bytes plus 64, as some camera HALs deliver them
+// (the padded copy of the frame is made once per size)
+static int runPlanesPadded(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    static unsigned char *padded;
+    static int paddedW, paddedH;
+    int const stride = ((width + 63) & ~63) + 64;
+    yuvImage img;
+    int j;
+
+    if (paddedW != width || paddedH != height) {
+        free(padded);
+        padded = malloc((size_t)yuvBufferSize(YUV_FORMAT_NV21, width, height, stride));
+        if (!padded)
+            return 0;
+        for (j=0; j < height*3/2; j++)
+            memcpy(padded + (size_t)j*stride, data + (size_t)j*width, width);
+        paddedW = width;
+        paddedH = height;
+    }
+    return yuvImageFromBuffer(&img, padded, YUV_FORMAT_NV21, width, height, stride) && convertYUV420toRGB8888_SIMDParallel(&img, pixels);
+}
+
+// Conversion with the frame statistics counted in the same pass (yuvstats.h)
+static int runStats(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    yuvStats stats;
+
+    convertYUV420_NV21toRGB8888Stats(data, pixels, width, height, &stats);
+    return 1;
+}
+
+static int runStatsPool(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    yuvStats stats;
+
+    convertYUV420_NV21toRGB8888StatsPool(data, pixels, width, height, &stats);
+    return 1;
+}
+
+// Region of interest: the centered quarter of the width and of the height (1/16 of the frame) on the worker pool
+static int runROI(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    yuvRect roi = { width*3/8, height*3/8, width/4, height/4 };
+
+    return convertYUV420_NV21toRGB8888ROI(data, pixels, width, height, &roi, 1);
+}
+
+// Incremental conversion (tiles of the default size, threshold 0) on the worker pool
+static int runIncremental(const unsigned char *data, int *pixels, int width, int height)
+{
+    static yuvDirtyTracker *tracker;
+    static int trackerWidth, trackerHeight;
+    yuvImage img;
+
+    if (!tracker || trackerWidth != width || trackerHeight != height) {
+        yuvDirtyDestroy(tracker);
+        tracker = yuvDirtyCreate(width, height, 0, 0);
+        trackerWidth = width;
+        trackerHeight = height;
+    }
+    return tracker && yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) &&
+           convertYUV420toFormatIncremental(tracker, &img, pixels, YUV_OUT_INT8888, 0, NULL, 1) >= 0;
+}
+
+// Static scene: the same frame every time, only the tiles are compared
+static int runIncrStatic(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return runIncremental(data, pixels, width, height);
+}
+
+// A 64x64 block that moves 16 pixels to the right on every frame over a static scene (the input is changed in place)
+static int runIncrMoving(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    static int frame;
+    unsigned char *y = (unsigned char *)data;
+    int const x0 = (frame++ * 16) % (width - 64), y0 = height/2 - 32;
+    int r, i;
+
+    for (r=y0; r < y0+64; r++)
+        for (i=x0; i < x0+64; i++)
+            y[r*width+i] ^= 0x55;
+    return runIncremental(data, pixels, width, height);
+}
+
+// Fused convert + downscale + rotate, as the app shows a landscape preview frame on a portrait canvas:
+// rotated 90 degrees into an output of half the size (the output buffer is the start of pixels)
+static int runScaled(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return convertYUV420_NV21toRGB8888Scaled(data, width, height, pixels, height/2, width/2, 90, YUV_SCALE_NEAREST);
+}
+
+static int runScaledBilinear(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return convertYUV420_NV21toRGB8888Scaled(data, width, height, pixels, height/2, width/2, 90, YUV_SCALE_BILINEAR);
+}
+
+static int runScaledPool(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return convertYUV420_NV21toRGB8888ScaledPool(data, width, height, pixels, height/2, width/2, 90, YUV_SCALE_BILINEAR);
+}
+
+static int runGrey(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toGREY8888(data, pixels, width, height);
+    return 1;
+}
+
+static int runGreySIMD(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return convertYUV420_NV21toGREY8888_SIMD(data, pixels, width, height);
+}
+
+// single channel output (the start of pixels holds width*height bytes)
+static int runGrey8(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    convertYUV420_NV21toGREY8_SIMD(data, (unsigned char *)pixels, width, height);
+    return 1;
+}
+
+// Luma convolution engine, GREY8888 output as the app shows it
+static int runSobel(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return filterLuma(data, width, height, YUV_FILTER_SOBEL, NULL, 0, YUV_FILTER_NO_THRESHOLD, pixels, YUV_FILTER_GREY8888);
+}
+
+static int runSobelPool(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return filterLumaPool(data, width, height, YUV_FILTER_SOBEL, NULL, 0, YUV_FILTER_NO_THRESHOLD, pixels, YUV_FILTER_GREY8888);
+}
+
+static int runGauss5(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    return filterLuma(data, width, height, YUV_FILTER_GAUSS5, NULL, 0, YUV_FILTER_NO_THRESHOLD, pixels, YUV_FILTER_GREY8888);
+}
+
+static int runConv5(const unsigned char *data, int *pixels, int width, int height, int nthr)
+{
+    static const short sharpen[25] = {  0,  0, -1,  0,  0,
+                                        0, -1, -2, -1,  0,
+                                       -1, -2, 20, -2, -1,
+                                        0, -1, -2, -1,  0,
+                                        0,  0, -1,  0,  0 };
+    return filterLuma(data, width, height, YUV_FILTER_CONV5, sharpen, 2, YUV_FILTER_NO_THRESHOLD, pixels, YUV_FILTER_GREY8888);
+}
+
+static const backend backends[] = {
+    { "scalar",  runScalar },
+    { "lut",     runLUT },
+    { "pthread", runPthread },
+    { "pool",    runPool },
+    { "lut-pool", runLUTPool },
+    { "omp",     runOMP },
+    { "neon",    runNEON },
+    { "neon64",  runNEON64 },
+    { "sse4.1",  runSSE41 },
+    { "avx2",    runAVX2 },
+    { "simd-pool", runSIMDPool },
+    { "pl-nv21", runPlanesNV21 },
+    { "pl-nv12", runPlanesNV12 },
+    { "pl-i420", runPlanesI420 },
+    { "pl-yv12", runPlanesYV12 },
+    { "pl-padded", runPlanesPadded },
+    { "out-rgba", runOutRGBA, 4 },
+    { "out-565", runOut565, 2 },
+    { "out-888", runOut888, 3 },
+    { "stats",   runStats },
+    { "stats-pool", runStatsPool },
+    { "roi-1/16", runROI },
+    { "incr-static", runIncrStatic },
+    { "incr-moving", runIncrMoving },
+    { "scaled",  runScaled },
+    { "scaled-bl", runScaledBilinear },
+    { "scaled-pl", runScaledPool },
+    { "grey",    runGrey },
+    { "grey-simd", runGreySIMD },
+    { "grey8",   runGrey8 },
+    { "sobel",   runSobel },
+    { "sobel-pl", runSobelPool },
+    { "gauss5",  runGauss5 },
+    { "conv5",   runConv5 },
+};
+#define NBACKENDS (int)(sizeof(backends)/sizeof(backends[0]))
+
+#define JNI_COPY   0
+#define JNI_ABORT  1
+#define JNI_DIRECT 2
+
+static const char *jniModes[] = { "copy", "abort", "direct" };
+static const char *schedules[] = { "static", "chunks", "adaptive" };     // WORKER_SCHED_*
+
+static volatile int loadRunning;
+
+// Background load (-L): spins until loadRunning is cleared
+static void *busyLoop(void *args)
+{
+    volatile unsigned long spin = 0;
+
+    while (loadRunning)
+        spin++;
+    return NULL;
+}
+
+// Run one frame as the JNI glue would get it in the given mode. Returns the bytes copied (negative if not supported)
+static long long runFrame(const backend *be, int mode, unsigned char *data, int *pixels, unsigned char *vmData, int *vmPixels,
+                          int width, int height, int nthr)
+{
+    size_t const dataBytes = (size_t)width*height*3/2;
+    size_t const pixelBytes = (size_t)width*height*sizeof(int);
+    long long copied = 0;
+    long long t = yuvProfStart();       // the stages of the JNI glue (0 without -p)
+    int done;
+
+    if (mode == JNI_DIRECT) {
+        done = be->run(data, pixels, width, height, nthr);
+        yuvProfLap(&t, YUV_STAGE_CONVERT);
+        return done ? 0 : -1;
+    }
+    // the "Java" arrays are vmData/vmPixels; the kernel works on the copies data/pixels
+    memcpy(data, vmData, dataBytes);
+    memcpy(pixels, vmPixels, pixelBytes);
+    copied += dataBytes + pixelBytes;
+    yuvProfLap(&t, YUV_STAGE_JNI_IN);
+    if (!be->run(data, pixels, width, height, nthr))
+        return -1;
+    yuvProfLap(&t, YUV_STAGE_CONVERT);
+    memcpy(vmPixels, pixels, pixelBytes);
+    copied += pixelBytes;
+    if (mode == JNI_COPY) {
+        memcpy(vmData, data, dataBytes);
+        copied += dataBytes;
+    }
+    yuvProfLap(&t, YUV_STAGE_JNI_OUT);
+    return copied;
+}
+
+static const int sizes[][2] = { {640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160} };
+#define NSIZES (int)(sizeof(sizes)/sizeof(sizes[0]))
+
+static double nowMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000.0 + ts.tv_nsec/1000000.0;
+}
+
+static int cmpDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Synthetic NV21 frame: gradients plus noise, so that no backend sees constant data
+static void fillFrame(unsigned char *data, int width, int height)
+{
+    unsigned int seed = 12345;
+    int size = width*height;
+    int i, j;
+
+    for (j=0; j < height; j++)
+        for (i=0; i < width; i++) {
+            seed = seed*1103515245u + 12345u;
+            data[j*width+i] = (unsigned char)((i*255/width + j*64/height + (seed>>24)%32) & 0xff);
+        }
+    for (j=0; j < height/2; j++)
+        for (i=0; i < width; i+=2) {
+            data[size + j*width + i  ] = (unsigned char)(128 + (i*96/width) - 48);        // V
+            data[size + j*width + i+1] = (unsigned char)(128 + (j*192/height) - 48);      // U
+        }
+}
+
+// Counter of the last level cache misses of this process in user mode, inherited by the threads created
+// after it is opened (worker pool, OpenMP). -1 if not available
+static int openCacheMisses(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+// Current value of the counter (including the threads that inherited it), -1 if not available
+static long long readCounter(int fd)
+{
+    long long value;
+
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+        return -1;
+    return value;
+}
+
+// Stages and workers recorded by the profiler since the last reset, under the row of a backend
+static void printProfile(void)
+{
+    static const char *runtimeNames[YUV_PROF_RUNTIMES] = { "pool", "pthread", "omp" };
+    yuvStageStats st;
+    yuvWorkerStats workers[YUV_PROF_WORKERS];
+    int i, r, n;
+
+    for (i=0; i < YUV_STAGE_COUNT; i++) {
+        yuvProfStage(i, &st);
+        if (st.count > 0)
+            printf("  %-9s p50 %9.1f us  p99 %9.1f us  max %9.1f us\n", yuvProfStageName(i), st.p50/1000.0, st.p99/1000.0, st.max/1000.0);
+    }
+    for (r=0; r < YUV_PROF_RUNTIMES; r++) {
+        n = yuvProfWorkers(r, workers, YUV_PROF_WORKERS);
+        if (n == 0)
+            continue;
+        printf("  %-9s busy", runtimeNames[r]);
+        for (i=0; i < n; i++) {
+            long long const wall = workers[i].busy + workers[i].idle;
+
+            printf(" %5.1f%%", wall > 0 ? 100.0*workers[i].busy/wall : 0.0);
+        }
+        printf("\n");
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n iterations] [-t threads] [-s WIDTHxHEIGHT] [-b backend] [-j copy|abort|direct] "
+                    "[-T PAIRS[xCOLS]] [-c] [-p]\n"
+                    "       [-d static|chunks|adaptive] [-L load threads]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 30;
+    int nthr = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int onlyW = 0, onlyH = 0;
+    const char *onlyBackend = NULL;
+    int jniMode = JNI_DIRECT;
+    int tilePairs = 0, tileCols = 0;
+    int cacheMisses = 0, missFd = -1;
+    int profile = 0;
+    int sched = WORKER_SCHED_ADAPTIVE, nload = 0;
+    pthread_t load[MAX_NUM_THREADS];
+    int opt, s, b, it;
+
+    while ((opt = getopt(argc, argv, "n:t:s:b:j:T:cpd:L:")) != -1) {
+        switch (opt) {
+            case 'n': iterations = atoi(optarg); break;
+            case 't': nthr = atoi(optarg); break;
+            case 's': if (sscanf(optarg, "%dx%d", &onlyW, &onlyH) != 2) usage(argv[0]); break;
+            case 'b': onlyBackend = optarg; break;
+            case 'j':
+                for (jniMode=0; jniMode <= JNI_DIRECT && strcmp(optarg, jniModes[jniMode]) != 0; jniMode++)
+                    ;
+                if (jniMode > JNI_DIRECT)
+                    usage(argv[0]);
+                break;
+            case 'T': if (sscanf(optarg, "%dx%d", &tilePairs, &tileCols) < 1 || tilePairs < 1) usage(argv[0]); break;
+            case 'c': cacheMisses = 1; break;
+            case 'p': profile = 1; break;
+            case 'd':
+                for (sched=0; sched <= WORKER_SCHED_ADAPTIVE && strcmp(optarg, schedules[sched]) != 0; sched++)
+                    ;
+                if (sched > WORKER_SCHED_ADAPTIVE)
+                    usage(argv[0]);
+                break;
+            case 'L': nload = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (iterations < 1 || nthr < 1 || nload < 0)
+        usage(argv[0]);
+    if (nload > MAX_NUM_THREADS)
+        nload = MAX_NUM_THREADS;
+    if (nthr > MAX_NUM_THREADS)
+        nthr = MAX_NUM_THREADS;
+
+    if (cacheMisses) {
+        missFd = openCacheMisses();         // before any thread is created, so that they all inherit it
+        if (missFd < 0)
+            fprintf(stderr, "cache misses not available (perf_event_open)\n");
+    }
+    workerPoolInit(nthr);
+    workerPoolSetSchedule(sched);
+    omp_set_num_threads(nthr);
+    loadRunning = 1;
+    for (it=0; it < nload; it++)
+        if (pthread_create(&load[it], NULL, busyLoop, NULL) != 0)
+            nload = it;
+    yuvSetTileSize(tilePairs, tileCols);
+    yuvGetTileSize(&tilePairs, &tileCols);
+    printf("threads: %d, iterations: %d, SIMD: %s, JNI: %s, schedule: %s, load threads: %d, OMP tiles: %d row pairs x ",
+           nthr, iterations, yuvSIMDName(), jniModes[jniMode], schedules[sched], nload, tilePairs);
+    if (tileCols > 0)
+        printf("%d columns\n", tileCols);
+    else
+        printf("whole rows\n");
+    printf("%-10s %-11s %12s %12s %10s %8s %10s", "backend", "size", "median(ms)", "p99(ms)", "Mpix/s", "GB/s", "copyMB");
+    if (cacheMisses)
+        printf(" %12s", "LLCmiss/f(K)");
+    printf("\n");
+
+    for (s=0; s < NSIZES || (onlyW && s == 0); s++) {
+        int width = onlyW ? onlyW : sizes[s][0];
+        int height = onlyW ? onlyH : sizes[s][1];
+        size_t npix = (size_t)width*height;
+        unsigned char *data = malloc(npix*3/2);
+        int *pixels = malloc(npix*sizeof(int));
+        unsigned char *vmData = malloc(npix*3/2);        // the Java arrays when the VM copies them
+        int *vmPixels = malloc(npix*sizeof(int));
+        double *times = malloc(iterations*sizeof(double));
+
+        if (!data || !pixels || !vmData || !vmPixels || !times) {
+            fprintf(stderr, "out of memory for %dx%d\n", width, height);
+            return 1;
+        }
+        fillFrame(data, width, height);
+        memcpy(vmData, data, npix*3/2);
+        memset(vmPixels, 0, npix*sizeof(int));
+        for (b=0; b < NBACKENDS; b++) {
+            double median, p99;
+            long long copied, misses;
+
+            if (onlyBackend && strcmp(onlyBackend, backends[b].name) != 0)
+                continue;
+            copied = runFrame(&backends[b], jniMode, data, pixels, vmData, vmPixels, width, height, nthr);
+            if (copied < 0) {       // warm-up (and support check)
+                printf("%-10s %4dx%-6d %12s\n", backends[b].name, width, height, "n/a");
+                continue;
+            }
+            misses = readCounter(missFd);
+            yuvProfReset();
+            yuvProfEnable(profile);         // the timed frames only, not the warm-up
+            for (it=0; it < iterations; it++) {
+                double t0 = nowMs();
+                runFrame(&backends[b], jniMode, data, pixels, vmData, vmPixels, width, height, nthr);
+                times[it] = nowMs() - t0;
+            }
+            yuvProfEnable(0);
+            if (misses >= 0)
+                misses = readCounter(missFd) - misses;
+            qsort(times, iterations, sizeof(double), cmpDouble);
+            median = times[iterations/2];
+            p99 = times[(iterations*99 + 99)/100 - 1];
+            printf("%-10s %4dx%-6d %12.3f %12.3f %10.1f %8.2f %10.2f", backends[b].name, width, height, median, p99,
+                   npix/(median*1000.0), npix*(1.5+(backends[b].outBytes ? backends[b].outBytes : 4))/(median*1000000.0), copied/1000000.0);
+            if (cacheMisses && misses >= 0)
+                printf(" %12.1f", misses/1000.0/iterations);
+            else if (cacheMisses)
+                printf(" %12s", "n/a");
+            printf("\n");
+            if (profile)
+                printProfile();
+        }
+        free(times);
+        free(vmPixels);
+        free(vmData);
+        free(pixels);
+        free(data);
+        if (onlyW)
+            break;
+    }
+    loadRunning = 0;
+    for (it=0; it < nload; it++)
+        pthread_join(load[it], NULL);
+    workerPoolShutdown();
+    return 0;
+}
@@ -0,0 +1,382 @@
+//
+// Offline converter of recorded camera streams: the input file is mapped in memory (mmap) and converted in
+// batches of frames (yuvbatch.h), every pool thread converting whole frames. The output of a batch is written
+// by a writer thread while the next batch is converted into a second buffer (double buffering), so the disk
+// and the conversion overlap. The frames/s of the whole run are written to stderr.
+//
+// The input is a raw stream of back-to-back frames (.nv21, .yuv) of the size given with -s and the layout given
+// with -f (and -S for a padded Y row stride), or a YUV4MPEG2 stream (.y4m: 4:2:0 frames, I420, size from the header).
+// The output is raw frames of RGBA8888, BGRA8888, RGB565, RGB888 or 8-bit grey; without -o nothing is written.
+//
+//   yuvconv [-s WIDTHxHEIGHT] [-f nv21|nv12|i420|yv12] [-S stride] [-O rgba|bgra|rgb565|rgb888|grey]
+//           [-t threads] [-B frames per batch] [-n max frames] [-o output|-] input
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "workerpool.h"
+#include "yuvconvert.h"
+#include "yuvbatch.h"
+
+static const char *formatNames[] = { "nv21", "nv12", "i420", "yv12" };
+static const char *outNames[] = { "rgba", "bgra", "rgb565", "rgb888", "grey" };     // YUV_OUT_*, YUV_BATCH_GREY8
+
+typedef struct stream {         // the frames of the input file
+    const unsigned char *map;
+    size_t size;
+    int format, width, height, stride;
+    int frameBytes;
+    long nframes;
+    const unsigned char **frames;      // start of every frame in map
+} stream;
+
+// Writer thread: writes one buffer while the caller fills the other one
+typedef struct writer {
+    int fd;                     // -1: discard the output
+    pthread_t th;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    const unsigned char *buf;   // buffer being written (NULL when idle)
+    size_t len;
+    int quit;
+    int error;                  // errno of the first failed write (under lock)
+    double stallMs;             // time the converter waited for the previous write
+} writer;
+
+static double nowMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000.0 + ts.tv_nsec/1000000.0;
+}
+
+static void *writerLoop(void *args)
+{
+    writer *w = (writer *)args;
+    int error;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->buf && !w->quit)
+            pthread_cond_wait(&w->cond, &w->lock);
+        if (!w->buf)
+            break;
+        error = w->error;
+        pthread_mutex_unlock(&w->lock);
+        {
+            const unsigned char *p = w->buf;
+            size_t left = w->len;
+
+            while (left > 0 && !error) {
+                ssize_t n = write(w->fd, p, left);
+
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    error = n < 0 ? errno : EIO;
+                else {
+                    p += n;
+                    left -= n;
+                }
+            }
+        }
+        pthread_mutex_lock(&w->lock);
+        w->error = error;
+        w->buf = NULL;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// Wait for the write in progress (if any)
+static void writerWait(writer *w)
+{
+    double t0 = nowMs();
+
+    pthread_mutex_lock(&w->lock);
+    while (w->buf)
+        pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+    w->stallMs += nowMs() - t0;
+}
+
+// errno of the first failed write, 0 if none
+static int writerError(writer *w)
+{
+    int error;
+
+    if (w->fd < 0)
+        return 0;
+    pthread_mutex_lock(&w->lock);
+    error = w->error;
+    pthread_mutex_unlock(&w->lock);
+    return error;
+}
+
+// Queue buf for writing once the previous buffer is written; buf must not be touched until the next call
+static void writerSubmit(writer *w, const unsigned char *buf, size_t len)
+{
+    if (w->fd < 0)
+        return;
+    writerWait(w);
+    pthread_mutex_lock(&w->lock);
+    w->buf = buf;
+    w->len = len;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static int writerStart(writer *w, int fd)
+{
+    memset(w, 0, sizeof(*w));
+    w->fd = fd;
+    if (fd < 0)
+        return 1;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    return pthread_create(&w->th, NULL, writerLoop, w) == 0;
+}
+
+static void writerStop(writer *w)
+{
+    if (w->fd < 0)
+        return;
+    pthread_mutex_lock(&w->lock);
+    w->quit = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->th, NULL);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+}
+
+// Value of the YUV4MPEG2 header token that starts with tag ("W", "H", "C"), NULL if there is none
+static const char *y4mToken(const char *header, const char *end, char tag)
+{
+    const char *p;
+
+    for (p=header; p < end; p++)
+        if (p[0] == ' ' && p+1 < end && p[1] == tag)
+            return p+2;
+    return NULL;
+}
+
+// 1 if the C parameter of a header is an 8-bit 4:2:0 chroma (420p10, 420p12 have 16-bit samples)
+static int y4mChroma420(const char *tok, const char *end)
+{
+    static const char *const names[] = { "420", "420jpeg", "420paldv", "420mpeg2" };
+    size_t const len = strcspn(tok, " \n");
+    size_t i;
+
+    if (tok + len > end)
+        return 0;
+    for (i=0; i < sizeof(names)/sizeof(names[0]); i++)
+        if (strlen(names[i]) == len && memcmp(tok, names[i], len) == 0)
+            return 1;
+    return 0;
+}
+
+// Frames of a YUV4MPEG2 stream: a header line, then "FRAME[ params]\n" + I420 data for every frame
+static int parseY4M(stream *st)
+{
+    const char *text = (const char *)st->map;
+    const char *eol = memchr(text, '\n', st->size < 512 ? st->size : 512);
+    const char *tok;
+    size_t pos;
+    long cap = 0;
+
+    if (!eol)
+        return 0;
+    tok = y4mToken(text, eol, 'W');
+    st->width = tok ? atoi(tok) : 0;
+    tok = y4mToken(text, eol, 'H');
+    st->height = tok ? atoi(tok) : 0;
+    tok = y4mToken(text, eol, 'C');
+    if (tok && !y4mChroma420(tok, eol)) {
+        fprintf(stderr, "y4m: only 8-bit 4:2:0 chroma is supported (C%.*s)\n", (int)strcspn(tok, " \n"), tok);
+        return 0;
+    }
+    st->format = YUV_FORMAT_I420;
+    st->stride = st->width;
+    st->frameBytes = yuvBufferSize(st->format, st->width, st->height, st->stride);
+    if (!st->frameBytes) {
+        fprintf(stderr, "y4m: bad frame size %dx%d\n", st->width, st->height);
+        return 0;
+    }
+    st->nframes = 0;
+    pos = eol - text + 1;
+    while (pos + 5 < st->size && memcmp(text+pos, "FRAME", 5) == 0) {
+        const char *fe = memchr(text+pos, '\n', st->size - pos);
+
+        if (!fe || (size_t)(fe - text) + 1 + st->frameBytes > st->size)
+            break;                  // truncated last frame
+        if (st->nframes == cap) {
+            cap = cap ? 2*cap : 256;
+            st->frames = realloc(st->frames, cap*sizeof(*st->frames));
+            if (!st->frames)
+                return 0;
+        }
+        pos = fe - text + 1;
+        st->frames[st->nframes++] = st->map + pos;
+        pos += st->frameBytes;
+    }
+    return 1;
+}
+
+// Frames of a raw stream of back-to-back frames
+static int parseRaw(stream *st)
+{
+    long i;
+
+    st->frameBytes = yuvBufferSize(st->format, st->width, st->height, st->stride);
+    if (!st->frameBytes) {
+        fprintf(stderr, "raw: -s WIDTHxHEIGHT (even) and a stride >= width are needed\n");
+        return 0;
+    }
+    st->nframes = st->size / st->frameBytes;
+    if (st->size % st->frameBytes)
+        fprintf(stderr, "raw: %zu trailing bytes ignored (not a whole frame)\n", st->size % st->frameBytes);
+    st->frames = malloc((st->nframes > 0 ? st->nframes : 1)*sizeof(*st->frames));
+    if (!st->frames)
+        return 0;
+    for (i=0; i < st->nframes; i++)
+        st->frames[i] = st->map + i*st->frameBytes;
+    return 1;
+}
+
+static int lookup(const char *name, const char **names, int n)
+{
+    int i;
+
+    for (i=0; i < n && strcmp(name, names[i]) != 0; i++)
+        ;
+    return i < n ? i : -1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-s WIDTHxHEIGHT] [-f nv21|nv12|i420|yv12] [-S stride] [-O rgba|bgra|rgb565|rgb888|grey]\n"
+                    "       [-t threads] [-B frames per batch] [-n max frames] [-o output|-] input\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    stream st;
+    writer w;
+    int nthr = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int batch = 0, outFormat = YUV_OUT_RGBA8888;
+    long maxFrames = -1, done = 0;
+    const char *output = NULL;
+    unsigned char *outBuf[2];
+    void **outs;
+    size_t outFrameBytes;
+    struct stat sb;
+    double t0, ms;
+    int opt, fd, outFd = -1, cur = 0, i;
+
+    memset(&st, 0, sizeof(st));
+    st.format = YUV_FORMAT_NV21;
+    while ((opt = getopt(argc, argv, "s:f:S:O:t:B:n:o:")) != -1) {
+        switch (opt) {
+            case 's': if (sscanf(optarg, "%dx%d", &st.width, &st.height) != 2) usage(argv[0]); break;
+            case 'f': if ((st.format = lookup(optarg, formatNames, 4)) < 0) usage(argv[0]); break;
+            case 'S': st.stride = atoi(optarg); break;
+            case 'O': if ((outFormat = lookup(optarg, outNames, 5)) < 0) usage(argv[0]); break;
+            case 't': nthr = atoi(optarg); break;
+            case 'B': batch = atoi(optarg); break;
+            case 'n': maxFrames = atol(optarg); break;
+            case 'o': output = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc-1 || nthr < 1)
+        usage(argv[0]);
+    if (nthr > MAX_POOL_THREADS)
+        nthr = MAX_POOL_THREADS;
+    if (batch <= 0)
+        batch = 4*nthr;             // a few frames per thread: the pool balances them
+
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &sb) != 0 || sb.st_size == 0) {
+        fprintf(stderr, "can't read %s\n", argv[optind]);
+        return 1;
+    }
+    st.size = (size_t)sb.st_size;
+    st.map = mmap(NULL, st.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (st.map == MAP_FAILED) {
+        fprintf(stderr, "can't map %s\n", argv[optind]);
+        return 1;
+    }
+    madvise((void *)st.map, st.size, MADV_SEQUENTIAL);     // read ahead: the frames are read once, in order
+    if (!(st.size >= 10 && memcmp(st.map, "YUV4MPEG2 ", 10) == 0 ? parseY4M(&st) : parseRaw(&st)))
+        return 1;
+    if (maxFrames >= 0 && maxFrames < st.nframes)
+        st.nframes = maxFrames;
+
+    if (output)
+        outFd = strcmp(output, "-") == 0 ? 1 : open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output && outFd < 0) {
+        fprintf(stderr, "can't create %s\n", output);
+        return 1;
+    }
+    outFrameBytes = (size_t)st.width*st.height*YUV_BATCH_BYTES(outFormat);
+    outBuf[0] = malloc(outFrameBytes*batch);
+    outBuf[1] = malloc(outFrameBytes*batch);
+    outs = malloc(batch*sizeof(*outs));
+    if (!outBuf[0] || !outBuf[1] || !outs || !writerStart(&w, outFd)) {
+        fprintf(stderr, "out of memory for batches of %d frames\n", batch);
+        return 1;
+    }
+    workerPoolInit(nthr);
+    fprintf(stderr, "%s: %ld frames %dx%d %s -> %s, %d threads (%s), %d frames per batch\n", argv[optind], st.nframes,
+            st.width, st.height, formatNames[st.format], outNames[outFormat], workerPoolSize(), yuvSIMDName(), batch);
+
+    t0 = nowMs();
+    while (done < st.nframes && !writerError(&w)) {
+        int const n = st.nframes - done < batch ? (int)(st.nframes - done) : batch;
+
+        for (i=0; i < n; i++)
+            outs[i] = outBuf[cur] + i*outFrameBytes;
+        // the other buffer may still be on its way to disk
+        if (!convertYUV420Batch(st.frames + done, outs, n, st.format, st.width, st.height, st.stride, outFormat)) {
+            fprintf(stderr, "can't convert the frames\n");
+            return 1;
+        }
+        writerSubmit(&w, outBuf[cur], n*outFrameBytes);
+        cur ^= 1;
+        done += n;
+    }
+    if (outFd >= 0)
+        writerWait(&w);
+    ms = nowMs() - t0;
+    writerStop(&w);
+    if (w.error) {
+        fprintf(stderr, "write error: %s\n", strerror(w.error));
+        return 1;
+    }
+    fprintf(stderr, "%ld frames in %.1f ms: %.1f frames/s, %.1f Mpix/s, %.1f MB written, %.1f ms waiting for the disk\n",
+            done, ms, done*1000.0/(ms > 0 ? ms : 1), done*(double)st.width*st.height/(ms > 0 ? ms : 1)/1000.0,
+            outFd >= 0 ? done*(double)outFrameBytes/1000000.0 : 0.0, w.stallMs);
+
+    workerPoolShutdown();
+    if (outFd > 1)
+        close(outFd);
+    munmap((void *)st.map, st.size);
+    close(fd);
+    free(outs);
+    free(outBuf[0]);
+    free(outBuf[1]);
+    free(st.frames);
+    return 0;
+}
@@ -0,0 +1,1407 @@
+//
+// Regression tests of the native conversion kernels, run by ctest (see CMakeLists.txt).
+//
+// Correctness (default): randomized and edge-case NV21 frames (sizes down to 2x2, widths that do not fill a SIMD
+// block, only 0 and 255, the limits of the limited range) go through every backend in the four colour spaces.
+// - The golden reference is the conversion computed in double precision from the definition of each colour space,
+//   with the conventions of yuv2rgb.h (Y' = max(Y - yoff, 0); the first byte of an NV21 chroma pair is V, the
+//   second U). Every pixel must be within GOLDEN_TOLERANCE of it in each channel.
+// - The backends must also give exactly the image of the scalar kernel: yuv2rgb.h promises bit-identical images,
+//   so any difference is a bug even inside the tolerance.
+// - The plane layouts, output formats, grey, statistics, ROI, incremental, batch and nearest scaled kernels are
+//   checked against the scalar image too (the scaled output formats against the scaled ints), and every output
+//   buffer is followed by a guard that must stay untouched.
+// - Fixtures: flat frames of known colours (red, green, blue...) must give those colours through every kernel,
+//   plane layout and output format. They do not rely on the scalar kernel or on the golden reference being right.
+// NV21 needs an even width and height (4:2:0 chroma of 2x2 blocks): odd sizes are only checked to be rejected.
+//
+// Performance (-P file): the median Mpixels/s of each kernel at each resolution must not be under the threshold
+// recorded for it in the file ("kernel WIDTHxHEIGHT Mpix/s" lines; kernels and sizes not in the file are not
+// checked, kernels the CPU does not run are skipped). A kernel under its threshold is measured once more before
+// it fails, so that a single noisy run does not fail the suite. -R file records the thresholds of this host:
+// margin (-m, 0.5 by default) times the throughput measured now.
+//
+//   yuvtest [-t threads] [-v] [-P thresholds | -R thresholds [-m margin]] [-n iterations]
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <omp.h>
+#include "workerpool.h"
+#include "yuv2rgb.h"
+#include "yuvconvert.h"
+#include "yuvplanes.h"
+#include "yuvbatch.h"
+#include "yuvroi.h"
+#include "yuvscale.h"
+#include "yuvstats.h"
+
+#define GOLDEN_TOLERANCE 1      // max difference per channel against the double precision reference
+#define GUARD 16                // ints after every output buffer
+#define GUARD_VALUE 0x5a5a5a5a
+
+static int nthr = 4;
+static int verbose;
+static int failures;
+
+// ------------------------------------------------------------------------------------------------------------
+// Kernels under test: NV21 into width*height ints 0xAARRGGBB. run returns 0 if the kernel is not available here
+
+typedef struct kernel {
+    const char *name;
+    int (*run)(const unsigned char *data, int *pixels, int width, int height);
+    int perf;                   // also measured by the performance test
+} kernel;
+
+static int runScalar(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888(data, pixels, width, height);
+    return 1;
+}
+
+static int runLUT(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888_LUT(data, pixels, width, height);
+    return 1;
+}
+
+static int runPthread(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888Parallel(data, pixels, width, height, nthr);
+    return 1;
+}
+
+static int runPool(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888Pool(data, pixels, width, height);
+    return 1;
+}
+
+static int runLUTPool(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888LUTPool(data, pixels, width, height);
+    return 1;
+}
+
+static int runOMP(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888_OMP(data, pixels, width, height);
+    return 1;
+}
+
+// OpenMP kernel with 2D tiles of 2 row pairs x 16 columns (the default tiles are whole rows)
+static int runOMPTiles(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvSetTileSize(2, 16);
+    convertYUV420_NV21toRGB8888_OMP(data, pixels, width, height);
+    yuvSetTileSize(0, 0);
+    return 1;
+}
+
+static int runNEON(const unsigned char *data, int *pixels, int width, int height)
+{
+    return (yuvCPUFeatures() & YUV_CPU_NEON) && convertYUV420_NV21toRGB8888_NEON(data, pixels, width, height);
+}
+
+static int runNEON64(const unsigned char *data, int *pixels, int width, int height)
+{
+    return (yuvCPUFeatures() & YUV_CPU_NEON) && convertYUV420_NV21toRGB8888_NEON64(data, pixels, width, height);
+}
+
+static int runSSE41(const unsigned char *data, int *pixels, int width, int height)
+{
+    return (yuvCPUFeatures() & YUV_CPU_SSE41) && convertYUV420_NV21toRGB8888_SSE41(data, pixels, width, height);
+}
+
+static int runAVX2(const unsigned char *data, int *pixels, int width, int height)
+{
+    return (yuvCPUFeatures() & YUV_CPU_AVX2) && convertYUV420_NV21toRGB8888_AVX2(data, pixels, width, height);
+}
+
+// The dispatched kernels convert in every case (table-driven without SIMD)
+static int runSIMD(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888_SIMD(data, pixels, width, height);
+    return 1;
+}
+
+static int runSIMDPool(const unsigned char *data, int *pixels, int width, int height)
+{
+    convertYUV420_NV21toRGB8888_SIMDParallel(data, pixels, width, height);
+    return 1;
+}
+
+// Band version, in three uneven bands
+static int runSIMDRows(const unsigned char *data, int *pixels, int width, int height)
+{
+    int const pairs = height/2;
+
+    convertYUV420_NV21toRGB8888_SIMDRows(data, pixels, width, height, 0, pairs/3);
+    convertYUV420_NV21toRGB8888_SIMDRows(data, pixels, width, height, pairs/3, pairs/2);
+    convertYUV420_NV21toRGB8888_SIMDRows(data, pixels, width, height, pairs/2, pairs);
+    return 1;
+}
+
+static int runPlanes(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvImage img;
+
+    return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) && convertYUV420toRGB8888(&img, pixels);
+}
+
+static int runPlanesSIMD(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvImage img;
+
+    return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) && convertYUV420toRGB8888_SIMD(&img, pixels);
+}
+
+static int runPlanesPool(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvImage img;
+
+    return yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) && convertYUV420toRGB8888_SIMDParallel(&img, pixels);
+}
+
+static int runStats(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvStats s;
+
+    convertYUV420_NV21toRGB8888Stats(data, pixels, width, height, &s);
+    return 1;
+}
+
+static int runStatsPool(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvStats s;
+
+    convertYUV420_NV21toRGB8888StatsPool(data, pixels, width, height, &s);
+    return 1;
+}
+
+static int runStatsPthread(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvStats s;
+
+    convertYUV420_NV21toRGB8888StatsParallel(data, pixels, width, height, nthr, &s);
+    return 1;
+}
+
+static int runStatsOMP(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvStats s;
+
+    convertYUV420_NV21toRGB8888Stats_OMP(data, pixels, width, height, &s);
+    return 1;
+}
+
+// The whole frame as a region of interest
+static int runROI(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvRect roi = { 0, 0, width, height };
+
+    return convertYUV420_NV21toRGB8888ROI(data, pixels, width, height, &roi, 1);
+}
+
+// First frame of a new tracker: every tile is converted
+static int runIncremental(const unsigned char *data, int *pixels, int width, int height)
+{
+    yuvDirtyTracker *t = yuvDirtyCreate(width, height, 0, 0);
+    yuvImage img;
+    int done;
+
+    done = t && yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width) &&
+           convertYUV420toFormatIncremental(t, &img, pixels, YUV_OUT_INT8888, 0, NULL, 1) >= 0;
+    yuvDirtyDestroy(t);
+    return done;
+}
+
+static int runBatch(const unsigned char *data, int *pixels, int width, int height)
+{
+    return convertYUV420BatchPacked(data, pixels, 1, YUV_FORMAT_NV21, width, height, width, YUV_OUT_INT8888) == 1;
+}
+
+static const kernel kernels[] = {
+    { "scalar",       runScalar, 1 },
+    { "lut",          runLUT, 1 },
+    { "pthread",      runPthread, 1 },
+    { "pool",         runPool, 1 },
+    { "lut-pool",     runLUTPool, 1 },
+    { "omp",          runOMP, 1 },
+    { "omp-tiles",    runOMPTiles },
+    { "neon",         runNEON, 1 },
+    { "neon64",       runNEON64, 1 },
+    { "sse4.1",       runSSE41, 1 },
+    { "avx2",         runAVX2, 1 },
+    { "simd",         runSIMD },
+    { "simd-pool",    runSIMDPool, 1 },
+    { "simd-rows",    runSIMDRows },
+    { "pl-scalar",    runPlanes },
+    { "pl-simd",      runPlanesSIMD },
+    { "pl-pool",      runPlanesPool, 1 },
+    { "stats",        runStats, 1 },
+    { "stats-pool",   runStatsPool, 1 },
+    { "stats-pthread", runStatsPthread },
+    { "stats-omp",    runStatsOMP },
+    { "roi",          runROI },
+    { "incremental",  runIncremental },
+    { "batch",        runBatch },
+};
+#define NKERNELS (int)(sizeof(kernels)/sizeof(kernels[0]))
+
+// ------------------------------------------------------------------------------------------------------------
+// Frames
+
+static const int sizes[][2] = {
+    {2, 2}, {4, 2}, {2, 6}, {6, 4}, {10, 6}, {18, 14}, {34, 10}, {62, 6}, {64, 32}, {66, 34}, {130, 98}, {322, 242}, {640, 480}
+};
+#define NSIZES (int)(sizeof(sizes)/sizeof(sizes[0]))
+
+static const char *patternNames[] = { "random", "zero", "255", "extremes", "range-limits", "gradient" };
+#define NPATTERNS (int)(sizeof(patternNames)/sizeof(patternNames[0]))
+
+static const char *spaceNames[2][2] = { { "bt601-limited", "bt601-full" }, { "bt709-limited", "bt709-full" } };
+
+static unsigned int seed = 12345;
+
+static unsigned int nextRandom(void)
+{
+    seed = seed*1103515245u + 12345u;
+    return seed >> 8;
+}
+
+static void fillFrame(unsigned char *data, int width, int height, int pattern)
+{
+    static const unsigned char limits[] = { 0, 15, 16, 17, 127, 128, 129, 234, 235, 236, 239, 240, 241, 255 };
+    int const n = width*height*3/2;
+    int i;
+
+    for (i=0; i < n; i++)
+        switch (pattern) {
+            case 0: data[i] = (unsigned char)nextRandom(); break;
+            case 1: data[i] = 0; break;
+            case 2: data[i] = 255; break;
+            case 3: data[i] = nextRandom() & 1 ? 255 : 0; break;
+            case 4: data[i] = limits[nextRandom() % sizeof(limits)]; break;
+            default: data[i] = (unsigned char)(i < width*height ? (i % width)*255/(width > 1 ? width-1 : 1)
+                                                                : 255 - ((i - width*height)/width)*255/(height/2)); break;
+        }
+}
+
+// Room for width*height ints and the guard after them
+static int *allocPixels(int width, int height)
+{
+    return malloc(((size_t)width*height + GUARD)*sizeof(int));
+}
+
+static void setGuard(int *pixels, int npix)
+{
+    int i;
+
+    for (i=0; i < GUARD; i++)
+        pixels[npix+i] = GUARD_VALUE;
+}
+
+static int guardIntact(const int *pixels, int npix)
+{
+    int i;
+
+    for (i=0; i < GUARD; i++)
+        if (pixels[npix+i] != GUARD_VALUE)
+            return 0;
+    return 1;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// Golden reference
+
+static int roundClamp(double x)
+{
+    x = floor(x + 0.5);
+    return x < 0 ? 0 : x > 255 ? 255 : (int)x;
+}
+
+// 0xAARRGGBB of Y, U, V (stored bytes) in the colour space [matrix][range], from its definition
+static int goldenPixel(int matrix, int range, int y, int u, int v)
+{
+    double const kr = matrix == YUV_BT709 ? 0.2126 : 0.299;
+    double const kb = matrix == YUV_BT709 ? 0.0722 : 0.114;
+    double const kg = 1.0 - kr - kb;
+    double const ys = range == YUV_FULL_RANGE ? 1.0 : 255.0/219.0;
+    double const cs = range == YUV_FULL_RANGE ? 1.0 : 255.0/224.0;
+    int const yoff = range == YUV_FULL_RANGE ? 0 : 16;
+    double const yy = ys*(y > yoff ? y - yoff : 0);
+    double const r = yy + cs*2*(1-kr)*(v-128);
+    double const g = yy - cs*2*(1-kb)*kb/kg*(u-128) - cs*2*(1-kr)*kr/kg*(v-128);
+    double const b = yy + cs*2*(1-kb)*(u-128);
+
+    return (int)(0xff000000u | roundClamp(r) << 16 | roundClamp(g) << 8 | roundClamp(b));
+}
+
+// Largest difference between the channels of two pixels
+static int channelDiff(int p, int q)
+{
+    int d, max = 0, s;
+
+    for (s=0; s < 32; s+=8) {
+        d = ((p >> s) & 0xff) - ((q >> s) & 0xff);
+        if (d < 0)
+            d = -d;
+        if (d > max)
+            max = d;
+    }
+    return max;
+}
+
+static void fail(const char *what, const char *kernelName, int width, int height, const char *detail)
+{
+    printf("FAIL %-14s %-13s %4dx%-4d %s\n", what, kernelName, width, height, detail);
+    failures++;
+}
+
+// Every Y, U and V through the scalar pixel math, the table-driven one and the 4:4:4 row kernels
+static void testPixelMath(int matrix, int range)
+{
+    static unsigned char y[256], u[256], v[256];
+    static int scalar[256], simd[256];
+    const yuvCoefs *c = yuvGetCoefs();
+    const yuvLUT *t = yuvGetLUT();
+    int maxDiff = 0, mismatches = 0;
+    int iu, iv, i, golden, d;
+    char msg[128];
+
+    for (i=0; i < 256; i++)
+        y[i] = (unsigned char)i;
+    for (iu=0; iu < 256; iu++)
+        for (iv=0; iv < 256; iv++) {
+            yuvChroma ch = yuvChromaOf(c, iu-128, iv-128);
+            yuvChroma chl = yuvChromaLUT(t, iu, iv);
+
+            memset(u, iu, sizeof(u));
+            memset(v, iv, sizeof(v));
+            convertYUV444toRGB8888Row(y, u, v, scalar, 256);
+            convertYUV444toRGB8888Row_SIMD(y, u, v, simd, 256);
+            for (i=0; i < 256; i++) {
+                golden = goldenPixel(matrix, range, i, iu, iv);
+                d = channelDiff(yuvPixel(c, i, &ch), golden);
+                if (d > maxDiff)
+                    maxDiff = d;
+                if (yuvPixelLUT(t, i, &chl) != yuvPixel(c, i, &ch) || scalar[i] != yuvPixel(c, i, &ch) || simd[i] != scalar[i])
+                    mismatches++;
+            }
+        }
+    if (maxDiff > GOLDEN_TOLERANCE) {
+        snprintf(msg, sizeof(msg), "%s: max difference %d against the golden reference", spaceNames[matrix][range], maxDiff);
+        fail("pixel-math", "scalar", 256, 65536, msg);
+    }
+    if (mismatches) {
+        snprintf(msg, sizeof(msg), "%s: %d pixels of the LUT or 4:4:4 kernels differ from yuvPixel", spaceNames[matrix][range], mismatches);
+        fail("pixel-math", "lut/444", 256, 65536, msg);
+    }
+    if (verbose)
+        printf("pixel math %-13s max difference %d\n", spaceNames[matrix][range], maxDiff);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// Per frame checks. ref is the scalar image of the frame
+
+// First pixel of a that differs from b (-1 if none)
+static int firstDiff(const int *a, const int *b, int n)
+{
+    int i;
+
+    for (i=0; i < n; i++)
+        if (a[i] != b[i])
+            return i;
+    return -1;
+}
+
+static void checkImage(const char *what, const char *kernelName, int width, int height, const char *ctx,
+                       const int *pixels, const int *ref)
+{
+    int const npix = width*height;
+    int i = firstDiff(pixels, ref, npix);
+    char msg[160];
+
+    if (i >= 0) {
+        snprintf(msg, sizeof(msg), "%s: (%d,%d) is %08x, scalar %08x", ctx, i % width, i / width, pixels[i], ref[i]);
+        fail(what, kernelName, width, height, msg);
+    }
+    else if (!guardIntact(pixels, npix)) {
+        snprintf(msg, sizeof(msg), "%s: wrote after the end of the output", ctx);
+        fail(what, kernelName, width, height, msg);
+    }
+}
+
+// The scalar image against the golden reference
+static void checkGolden(const unsigned char *data, const int *ref, int width, int height, int matrix, int range, const char *ctx)
+{
+    const unsigned char *uv = data + width*height;
+    int i, j, k, d;
+    char msg[160];
+
+    for (j=0; j < height; j++)
+        for (i=0; i < width; i++) {
+            k = (j/2)*width + (i & ~1);
+            d = channelDiff(ref[j*width+i], goldenPixel(matrix, range, data[j*width+i], uv[k+1], uv[k]));     // V U pairs
+            if (d > GOLDEN_TOLERANCE) {
+                snprintf(msg, sizeof(msg), "%s: (%d,%d) differs by %d from the golden reference", ctx, i, j, d);
+                fail("golden", "scalar", width, height, msg);
+                return;
+            }
+        }
+}
+
+static void checkKernels(const unsigned char *data, const int *ref, int *pixels, int width, int height, const char *ctx)
+{
+    int const npix = width*height;
+    int k;
+
+    for (k=0; k < NKERNELS; k++) {
+        memset(pixels, 0, npix*sizeof(int));
+        setGuard(pixels, npix);
+        if (kernels[k].run(data, pixels, width, height))
+            checkImage("rgb", kernels[k].name, width, height, ctx, pixels, ref);
+    }
+}
+
+// The other packed layouts (same samples as the NV21 frame) and an NV21 frame with padded rows
+static void checkLayouts(const unsigned char *data, const int *ref, int *pixels, int width, int height, const char *ctx)
+{
+    static const char *names[] = { "nv21", "nv12", "i420", "yv12", "nv21-padded" };
+    int const npix = width*height;
+    int const padded = width + 24;
+    const unsigned char *vu = data + npix;
+    unsigned char *buf = malloc(yuvBufferSize(YUV_FORMAT_NV21, width, height, padded) + yuvBufferSize(YUV_FORMAT_YV12, width, height, width));
+    yuvImage img;
+    int f, i, j, stride;
+
+    if (!buf)
+        return;
+    for (f=YUV_FORMAT_NV21; f <= YUV_FORMAT_YV12+1; f++) {
+        int const format = f > YUV_FORMAT_YV12 ? YUV_FORMAT_NV21 : f;
+
+        stride = f > YUV_FORMAT_YV12 ? padded : width;
+        if (!yuvImageFromBuffer(&img, buf, format, width, height, stride)) {
+            fail("layout", names[f], width, height, "descriptor rejected");
+            continue;
+        }
+        for (j=0; j < height; j++)
+            memcpy(buf + j*stride, data + j*width, width);
+        for (j=0; j < height/2; j++)
+            for (i=0; i < width/2; i++) {
+                // the first byte of the NV21 pair goes where each layout keeps V
+                ((unsigned char *)img.v.data)[j*img.v.rowStride + i*img.v.pixelStride] = vu[j*width + 2*i];
+                ((unsigned char *)img.u.data)[j*img.u.rowStride + i*img.u.pixelStride] = vu[j*width + 2*i + 1];
+            }
+        memset(pixels, 0, npix*sizeof(int));
+        setGuard(pixels, npix);
+        convertYUV420toRGB8888(&img, pixels);
+        checkImage("layout", names[f], width, height, ctx, pixels, ref);
+        memset(pixels, 0, npix*sizeof(int));
+        convertYUV420toRGB8888_SIMDParallel(&img, pixels);
+        checkImage("layout-simd", names[f], width, height, ctx, pixels, ref);
+    }
+    free(buf);
+}
+
+// Every output format against the scalar image (ints 0xAARRGGBB), through the scalar, SIMD and pool kernels
+static void checkOutputs(const unsigned char *data, const int *ref, int width, int height, const char *ctx)
+{
+    static const char *names[] = { "rgba", "bgra", "rgb565", "rgb888" };
+    int const npix = width*height;
+    unsigned char *out = malloc((size_t)npix*4 + GUARD);
+    unsigned char *expected = malloc((size_t)npix*4);
+    yuvImage img;
+    int format, pass, i, px, bytes;
+    char msg[160];
+
+    if (!out || !expected || !yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width)) {
+        free(out);
+        free(expected);
+        return;
+    }
+    for (format=YUV_OUT_RGBA8888; format <= YUV_OUT_RGB888; format++) {
+        bytes = YUV_OUT_BYTES(format);
+        for (i=0; i < npix; i++) {
+            px = ref[i];
+            switch (format) {
+                case YUV_OUT_RGBA8888:
+                    expected[4*i] = (unsigned char)(px >> 16);
+                    expected[4*i+1] = (unsigned char)(px >> 8);
+                    expected[4*i+2] = (unsigned char)px;
+                    expected[4*i+3] = (unsigned char)(px >> 24);
+                    break;
+                case YUV_OUT_BGRA8888:
+                    expected[4*i] = (unsigned char)px;
+                    expected[4*i+1] = (unsigned char)(px >> 8);
+                    expected[4*i+2] = (unsigned char)(px >> 16);
+                    expected[4*i+3] = (unsigned char)(px >> 24);
+                    break;
+                case YUV_OUT_RGB565:
+                    ((unsigned short *)expected)[i] = (unsigned short)((((px >> 19) & 0x1f) << 11) | (((px >> 10) & 0x3f) << 5) | ((px >> 3) & 0x1f));
+                    break;
+                default:
+                    expected[3*i] = (unsigned char)(px >> 16);
+                    expected[3*i+1] = (unsigned char)(px >> 8);
+                    expected[3*i+2] = (unsigned char)px;
+                    break;
+            }
+        }
+        for (pass=0; pass < 3; pass++) {
+            memset(out, 0, (size_t)npix*bytes);
+            memset(out + (size_t)npix*bytes, 0x5a, GUARD);
+            if (pass == 0)
+                convertYUV420toFormat(&img, out, format);
+            else if (pass == 1)
+                convertYUV420toFormat_SIMD(&img, out, format);
+            else
+                convertYUV420toFormat_SIMDParallel(&img, out, format);
+            for (i=0; i < npix*bytes && out[i] == expected[i]; i++)
+                ;
+            if (i < npix*bytes) {
+                snprintf(msg, sizeof(msg), "%s, %s kernel: pixel (%d,%d) differs", ctx,
+                         pass == 0 ? "scalar" : pass == 1 ? "simd" : "pool", (i/bytes) % width, (i/bytes) / width);
+                fail("output", names[format], width, height, msg);
+            }
+            for (i=0; i < GUARD && out[(size_t)npix*bytes + i] == 0x5a; i++)
+                ;
+            if (i < GUARD) {
+                snprintf(msg, sizeof(msg), "%s: wrote after the end of the output", ctx);
+                fail("output", names[format], width, height, msg);
+            }
+        }
+    }
+    free(expected);
+    free(out);
+}
+
+// GREY8888 and GREY8 kernels against the golden grey level (U = V = 128) and against each other
+static void checkGrey(const unsigned char *data, int *pixels, int width, int height, int matrix, int range, const char *ctx)
+{
+    int const npix = width*height;
+    int *ref = allocPixels(width, height);
+    unsigned char *grey8 = malloc(npix + GUARD);
+    int k, i, d;
+    char msg[160];
+
+    if (!ref || !grey8) {
+        free(ref);
+        free(grey8);
+        return;
+    }
+    convertYUV420_NV21toGREY8888(data, ref, width, height);
+    for (i=0; i < npix; i++) {
+        d = channelDiff(ref[i], goldenPixel(matrix, range, data[i], 128, 128));
+        if (d > GOLDEN_TOLERANCE) {
+            snprintf(msg, sizeof(msg), "%s: (%d,%d) differs by %d from the golden reference", ctx, i % width, i / width, d);
+            fail("grey-golden", "grey", width, height, msg);
+            break;
+        }
+    }
+    for (k=0; k < 4; k++) {
+        memset(pixels, 0, npix*sizeof(int));
+        setGuard(pixels, npix);
+        switch (k) {
+            case 0: convertYUV420_NV21toGREY8888Parallel(data, pixels, width, height, nthr); break;
+            case 1: convertYUV420_NV21toGREY8888Pool(data, pixels, width, height); break;
+            case 2: convertYUV420_NV21toGREY8888_OMP(data, pixels, width, height); break;
+            default: convertYUV420_NV21toGREY8888_SIMD(data, pixels, width, height); break;
+        }
+        checkImage("grey", k == 0 ? "pthread" : k == 1 ? "pool" : k == 2 ? "omp" : "simd", width, height, ctx, pixels, ref);
+    }
+    memset(grey8, 0x5a, npix + GUARD);
+    convertYUV420_NV21toGREY8_SIMD(data, grey8, width, height);
+    for (i=0; i < npix && grey8[i] == (ref[i] & 0xff); i++)
+        ;
+    for (d=0; d < GUARD && grey8[npix+d] == 0x5a; d++)
+        ;
+    if (i < npix || d < GUARD) {
+        snprintf(msg, sizeof(msg), "%s: differs from GREY8888 or wrote after the output", ctx);
+        fail("grey8", "simd", width, height, msg);
+    }
+    free(grey8);
+    free(ref);
+}
+
+// Statistics of every runtime against the ones counted from the scalar image
+static void checkStats(const unsigned char *data, const int *ref, int *pixels, int width, int height, const char *ctx)
+{
+    int const npix = width*height;
+    yuvStats expected, s;
+    int k, i;
+    char msg[160];
+
+    memset(&expected, 0, sizeof(expected));
+    expected.count = npix;
+    expected.minY = 255;
+    for (i=0; i < npix; i++) {
+        expected.histY[data[i]]++;
+        expected.histR[(ref[i] >> 16) & 0xff]++;
+        expected.histG[(ref[i] >> 8) & 0xff]++;
+        expected.histB[ref[i] & 0xff]++;
+        expected.sumY += data[i];
+        expected.sumSqY += data[i]*data[i];
+        if (data[i] < expected.minY)
+            expected.minY = data[i];
+        if (data[i] > expected.maxY)
+            expected.maxY = data[i];
+    }
+    for (k=0; k < 4; k++) {
+        memset(&s, 0xff, sizeof(s));
+        switch (k) {
+            case 0: convertYUV420_NV21toRGB8888Stats(data, pixels, width, height, &s); break;
+            case 1: convertYUV420_NV21toRGB8888StatsPool(data, pixels, width, height, &s); break;
+            case 2: convertYUV420_NV21toRGB8888StatsParallel(data, pixels, width, height, nthr, &s); break;
+            default: convertYUV420_NV21toRGB8888Stats_OMP(data, pixels, width, height, &s); break;
+        }
+        if (memcmp(s.histY, expected.histY, sizeof(s.histY)) || memcmp(s.histR, expected.histR, sizeof(s.histR)) ||
+            memcmp(s.histG, expected.histG, sizeof(s.histG)) || memcmp(s.histB, expected.histB, sizeof(s.histB)) ||
+            s.count != expected.count || s.sumY != expected.sumY || s.sumSqY != expected.sumSqY ||
+            s.minY != expected.minY || s.maxY != expected.maxY) {
+            snprintf(msg, sizeof(msg), "%s: statistics differ from the ones of the scalar image", ctx);
+            fail("stats", k == 0 ? "stats" : k == 1 ? "stats-pool" : k == 2 ? "stats-pthread" : "stats-omp", width, height, msg);
+        }
+    }
+}
+
+// A rectangle with odd coordinates: its even cover is converted, the rest of the output is left as it was
+static void checkROI(const unsigned char *data, const int *ref, int *pixels, int width, int height, const char *ctx)
+{
+    int const npix = width*height;
+    yuvRect roi = { width/3 | 1, height/4 | 1, width/3 | 1, height/3 | 1 };
+    int x0, y0, x1, y1, i, j, bad = 0;
+    char msg[160];
+
+    if (roi.x + roi.width > width || roi.y + roi.height > height)
+        return;
+    x0 = roi.x & ~1;
+    y0 = roi.y & ~1;
+    x1 = (roi.x + roi.width + 1) & ~1;
+    y1 = (roi.y + roi.height + 1) & ~1;
+    for (i=0; i < npix; i++)
+        pixels[i] = GUARD_VALUE;
+    setGuard(pixels, npix);
+    convertYUV420_NV21toRGB8888ROI(data, pixels, width, height, &roi, 1);
+    for (j=0; j < height; j++)
+        for (i=0; i < width; i++)
+            if (pixels[j*width+i] != (i >= x0 && i < x1 && j >= y0 && j < y1 ? ref[j*width+i] : GUARD_VALUE))
+                bad++;
+    if (bad || !guardIntact(pixels, npix)) {
+        snprintf(msg, sizeof(msg), "%s: %d pixels wrong for the rectangle (%d,%d) %dx%d", ctx, bad, roi.x, roi.y, roi.width, roi.height);
+        fail("roi", "roi", width, height, msg);
+    }
+}
+
+// Incremental conversion at threshold 0: after a change in part of the frame the output is the scalar image
+// of the new frame, and only tiles were converted
+static void checkIncremental(const unsigned char *data, int *pixels, int width, int height, const char *ctx)
+{
+    int const npix = width*height;
+    yuvDirtyTracker *t = yuvDirtyCreate(width, height, 16, 8);
+    unsigned char *frame = malloc(npix*3/2);
+    int *ref = allocPixels(width, height);
+    int *dirty;
+    yuvImage img;
+    int i, ntiles, n;
+    char msg[160];
+
+    if (!t || !frame || !ref || !(dirty = malloc(yuvDirtyTileCount(t, NULL, NULL)*sizeof(int)))) {
+        yuvDirtyDestroy(t);
+        free(frame);
+        free(ref);
+        return;
+    }
+    ntiles = yuvDirtyTileCount(t, NULL, NULL);
+    memcpy(frame, data, npix*3/2);
+    yuvImageFromBuffer(&img, frame, YUV_FORMAT_NV21, width, height, width);
+    setGuard(pixels, npix);
+    n = convertYUV420toFormatIncremental(t, &img, pixels, YUV_OUT_INT8888, 0, dirty, 1);
+    if (n != ntiles) {
+        snprintf(msg, sizeof(msg), "%s: first frame converted %d of %d tiles", ctx, n, ntiles);
+        fail("incremental", "incremental", width, height, msg);
+    }
+    // change a few Y and chroma samples around the middle of the frame
+    for (i=0; i < 5; i++) {
+        frame[(height/2)*width + (width/2 + i) % width] ^= 0x81;
+        frame[npix + (height/4)*width + i % width] ^= 0x42;
+    }
+    convertYUV420_NV21toRGB8888(frame, ref, width, height);
+    n = convertYUV420toFormatIncremental(t, &img, pixels, YUV_OUT_INT8888, 0, dirty, 1);
+    if (n < 1 || n > ntiles) {
+        snprintf(msg, sizeof(msg), "%s: changed frame converted %d of %d tiles", ctx, n, ntiles);
+        fail("incremental", "incremental", width, height, msg);
+    }
+    checkImage("incremental", "incremental", width, height, ctx, pixels, ref);
+    n = convertYUV420toFormatIncremental(t, &img, pixels, YUV_OUT_INT8888, 0, dirty, 1);
+    if (n != 0) {
+        snprintf(msg, sizeof(msg), "%s: unchanged frame converted %d tiles", ctx, n);
+        fail("incremental", "incremental", width, height, msg);
+    }
+    free(dirty);
+    free(ref);
+    free(frame);
+    yuvDirtyDestroy(t);
+}
+
+// Nearest neighbour scaling to half size in the four rotations, against the same sampling of the scalar image
+// (Support.downscaleAndRotateImage with integer strides)
+static void checkScaled(const unsigned char *data, const int *ref, int *out, int width, int height, const char *ctx)
+{
+    int const ow0 = width/2, oh0 = height/2;
+    int angle, pool, r, c, ow, oh, sx, sy, bad;
+    char msg[160];
+
+    if (ow0 < 1 || oh0 < 1)
+        return;
+    for (angle=0; angle < 360; angle+=90)
+        for (pool=0; pool < 2; pool++) {
+            ow = angle % 180 ? oh0 : ow0;
+            oh = angle % 180 ? ow0 : oh0;
+            setGuard(out, ow*oh);
+            if (!(pool ? convertYUV420_NV21toRGB8888ScaledPool : convertYUV420_NV21toRGB8888Scaled)
+                    (data, width, height, out, ow, oh, angle, YUV_SCALE_NEAREST)) {
+                fail("scaled", pool ? "scaled-pool" : "scaled", width, height, "rejected");
+                continue;
+            }
+            bad = 0;
+            for (r=0; r < oh; r++)
+                for (c=0; c < ow; c++) {
+                    switch (angle) {
+                        case 0:   sx = c*width/ow;            sy = r*height/oh; break;
+                        case 90:  sx = r*width/oh;            sy = height-1 - c*height/ow; break;
+                        case 180: sx = width-1 - c*width/ow;  sy = height-1 - r*height/oh; break;
+                        default:  sx = width-1 - r*width/oh;  sy = c*height/ow; break;
+                    }
+                    if (out[r*ow+c] != ref[sy*width+sx])
+                        bad++;
+                }
+            if (bad || !guardIntact(out, ow*oh)) {
+                snprintf(msg, sizeof(msg), "%s: rotation %d, %d pixels differ from the sampled scalar image", ctx, angle, bad);
+                fail("scaled", pool ? "scaled-pool" : "scaled", width, height, msg);
+            }
+        }
+}
+
+// Pixel i of an output of that format back to 0xAARRGGBB (RGB565 expanded to 8 bits, opaque if no alpha)
+static int outputPixel(const unsigned char *out, int format, int i)
+{
+    const unsigned char *p = out + (size_t)i*YUV_OUT_BYTES(format);
+    int r, g, b, a = 0xff;
+
+    switch (format) {
+        case YUV_OUT_RGBA8888:
+            r = p[0], g = p[1], b = p[2], a = p[3];
+            break;
+        case YUV_OUT_BGRA8888:
+            b = p[0], g = p[1], r = p[2], a = p[3];
+            break;
+        case YUV_OUT_RGB565: {
+            int const px = ((const unsigned short *)out)[i];
+
+            r = (px >> 11) & 0x1f, g = (px >> 5) & 0x3f, b = px & 0x1f;
+            r = (r << 3) | (r >> 2), g = (g << 2) | (g >> 4), b = (b << 3) | (b >> 2);
+            break;
+        }
+        default:
+            r = p[0], g = p[1], b = p[2];
+            break;
+    }
+    return (int)((unsigned)a << 24 | r << 16 | g << 8 | b);
+}
+
+// px (0xAARRGGBB) as outputPixel reads it back from that format
+static int quantizePixel(int px, int format)
+{
+    int r, g, b;
+
+    if (format == YUV_OUT_RGB888)
+        return px | (int)0xff000000u;
+    if (format != YUV_OUT_RGB565)
+        return px;
+    r = (px >> 19) & 0x1f, g = (px >> 10) & 0x3f, b = (px >> 3) & 0x1f;
+    return (int)(0xff000000u | ((r << 3) | (r >> 2)) << 16 | ((g << 2) | (g >> 4)) << 8 | ((b << 3) | (b >> 2)));
+}
+
+// The scaled kernels into every output format against their int image, both filters
+static void checkScaledFormats(const unsigned char *data, int width, int height, const char *ctx)
+{
+    static const char *names[] = { "scaled-rgba", "scaled-bgra", "scaled-rgb565", "scaled-rgb888" };
+    int const ow = height/2, oh = width/2, npix = ow*oh;       // rotated 90 degrees
+    int *ref = allocPixels(ow, oh);
+    unsigned char *out = malloc((size_t)npix*4 + GUARD);
+    int format, filter, pool, i, bytes;
+    char msg[160];
+
+    if (npix < 1 || !ref || !out) {
+        free(out);
+        free(ref);
+        return;
+    }
+    for (filter=YUV_SCALE_NEAREST; filter <= YUV_SCALE_BILINEAR; filter++) {
+        convertYUV420_NV21toRGB8888Scaled(data, width, height, ref, ow, oh, 90, filter);
+        for (format=YUV_OUT_RGBA8888; format <= YUV_OUT_RGB888; format++)
+            for (pool=0; pool < 2; pool++) {
+                bytes = YUV_OUT_BYTES(format);
+                memset(out, 0, (size_t)npix*bytes);
+                memset(out + (size_t)npix*bytes, 0x5a, GUARD);
+                if (!(pool ? convertYUV420_NV21toFormatScaledPool : convertYUV420_NV21toFormatScaled)
+                        (data, width, height, out, format, ow, oh, 90, filter)) {
+                    fail("scaled-format", names[format], width, height, "rejected");
+                    continue;
+                }
+                for (i=0; i < npix && outputPixel(out, format, i) == quantizePixel(ref[i], format); i++)
+                    ;
+                if (i < npix) {
+                    snprintf(msg, sizeof(msg), "%s, %s%s: (%d,%d) differs from the int image", ctx,
+                             filter == YUV_SCALE_NEAREST ? "nearest" : "bilinear", pool ? ", pool" : "", i % ow, i / ow);
+                    fail("scaled-format", names[format], width, height, msg);
+                }
+                for (i=0; i < GUARD && out[(size_t)npix*bytes + i] == 0x5a; i++)
+                    ;
+                if (i < GUARD) {
+                    snprintf(msg, sizeof(msg), "%s: wrote after the end of the output", ctx);
+                    fail("scaled-format", names[format], width, height, msg);
+                }
+            }
+    }
+    free(out);
+    free(ref);
+}
+
+// Several frames in one batch (more than the pool threads), ints 0xAARRGGBB and GREY8
+static void checkBatch(int width, int height)
+{
+    int const nframes = 2*nthr + 1, npix = width*height, frameBytes = npix*3/2;
+    unsigned char *frames = malloc((size_t)nframes*frameBytes);
+    int *out = malloc((size_t)nframes*npix*sizeof(int));
+    int *ref = allocPixels(width, height);
+    unsigned char *grey = malloc(npix);
+    int f, i;
+    char msg[160];
+
+    if (frames && out && ref && grey) {
+        for (f=0; f < nframes; f++)
+            fillFrame(frames + (size_t)f*frameBytes, width, height, f % NPATTERNS);
+        if (convertYUV420BatchPacked(frames, out, nframes, YUV_FORMAT_NV21, width, height, width, YUV_OUT_INT8888) != nframes)
+            fail("batch", "batch", width, height, "not converted");
+        else
+            for (f=0; f < nframes; f++) {
+                convertYUV420_NV21toRGB8888(frames + (size_t)f*frameBytes, ref, width, height);
+                if (firstDiff(out + (size_t)f*npix, ref, npix) >= 0) {
+                    snprintf(msg, sizeof(msg), "frame %d of %d differs from the scalar image", f, nframes);
+                    fail("batch", "batch", width, height, msg);
+                }
+            }
+        if (convertYUV420BatchPacked(frames, out, nframes, YUV_FORMAT_NV21, width, height, width, YUV_BATCH_GREY8) != nframes)
+            fail("batch", "batch-grey8", width, height, "not converted");
+        else
+            for (f=0; f < nframes; f++) {
+                convertYUV420_NV21toGREY8(frames + (size_t)f*frameBytes, grey, width, height);
+                for (i=0; i < npix && grey[i] == ((unsigned char *)out)[(size_t)f*npix + i]; i++)
+                    ;
+                if (i < npix) {
+                    snprintf(msg, sizeof(msg), "frame %d of %d differs from convertYUV420_NV21toGREY8", f, nframes);
+                    fail("batch", "batch-grey8", width, height, msg);
+                }
+            }
+    }
+    free(grey);
+    free(ref);
+    free(out);
+    free(frames);
+}
+
+// Sizes NV21 cannot have: the descriptors must reject them
+static void checkOddSizes(void)
+{
+    static const int odd[][2] = { {3, 2}, {2, 3}, {17, 10}, {640, 481}, {1, 1}, {0, 2} };
+    static unsigned char frame[1024*1024];
+    yuvImage img;
+    char msg[64];
+    int i;
+
+    for (i=0; i < (int)(sizeof(odd)/sizeof(odd[0])); i++)
+        if (yuvImageFromBuffer(&img, frame, YUV_FORMAT_NV21, odd[i][0], odd[i][1], 0) ||
+            yuvBufferSize(YUV_FORMAT_I420, odd[i][0], odd[i][1], 0) != 0) {
+            snprintf(msg, sizeof(msg), "accepted as a YUV420 frame");
+            fail("odd-size", "planes", odd[i][0], odd[i][1], msg);
+        }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// Fixtures: flat frames of the primaries and secondaries (their BT.601 limited range codes), whose colour does not
+// depend on any other kernel being right
+
+typedef struct fixture {
+    const char *name;
+    unsigned char y, u, v;
+    unsigned char r, g, b;
+} fixture;
+
+static const fixture fixtures[] = {
+    { "red",     81,  90, 240, 255,   0,   0 },
+    { "green",  145,  54,  34,   0, 255,   0 },
+    { "blue",    41, 240, 110,   0,   0, 255 },
+    { "yellow", 210,  16, 146, 255, 255,   0 },
+    { "cyan",   170, 166,  16,   0, 255, 255 },
+    { "magenta",106, 202, 222, 255,   0, 255 },
+    { "white",  235, 128, 128, 255, 255, 255 },
+    { "black",   16, 128, 128,   0,   0,   0 },
+};
+#define NFIXTURES (int)(sizeof(fixtures)/sizeof(fixtures[0]))
+#define FIXTURE_TOLERANCE 2     // the codes are rounded to 8 bits
+#define FIXTURE_WIDTH 66        // whole SIMD blocks and a scalar tail
+#define FIXTURE_HEIGHT 4
+
+static const char *layoutNames[] = { "nv21", "nv12", "i420", "yv12", "nv21-padded", "pixel-stride-3" };
+#define NLAYOUTS (int)(sizeof(layoutNames)/sizeof(layoutNames[0]))
+
+// Descriptor of the layout l over buf: the YUV_FORMAT_*, NV21 with padded rows, or U and V samples 3 bytes apart
+// in one chroma plane (YUV_CHROMA_OTHER)
+static int fixtureImage(yuvImage *img, unsigned char *buf, int l, int width, int height)
+{
+    if (l <= YUV_FORMAT_YV12)
+        return yuvImageFromBuffer(img, buf, l, width, height, width);
+    if (l == YUV_FORMAT_YV12+1)
+        return yuvImageFromBuffer(img, buf, YUV_FORMAT_NV21, width, height, width + 24);
+    img->width = width;
+    img->height = height;
+    img->y.data = buf;
+    img->y.rowStride = width;
+    img->y.pixelStride = 1;
+    img->u.data = buf + width*height;
+    img->u.rowStride = 3*width/2;
+    img->u.pixelStride = 3;
+    img->v.data = img->u.data + 1;
+    img->v.rowStride = img->u.rowStride;
+    img->v.pixelStride = 3;
+    return 1;
+}
+
+// The flat frame of f in the layout img describes
+static void fillFixture(const yuvImage *img, const fixture *f)
+{
+    int i, j;
+
+    for (j=0; j < img->height; j++)
+        memset((unsigned char *)img->y.data + j*img->y.rowStride, f->y, img->width);
+    for (j=0; j < img->height/2; j++)
+        for (i=0; i < img->width/2; i++) {
+            ((unsigned char *)img->u.data)[j*img->u.rowStride + i*img->u.pixelStride] = f->u;
+            ((unsigned char *)img->v.data)[j*img->v.rowStride + i*img->v.pixelStride] = f->v;
+        }
+}
+
+// First of the npix ints 0xAARRGGBB that is not the colour of f (-1 if none)
+static int fixtureMismatch(const int *pixels, int npix, const fixture *f)
+{
+    int i, d;
+
+    for (i=0; i < npix; i++) {
+        d = abs(((pixels[i] >> 16) & 0xff) - f->r);
+        d |= abs(((pixels[i] >> 8) & 0xff) - f->g) | abs((pixels[i] & 0xff) - f->b);
+        if (d > FIXTURE_TOLERANCE || ((pixels[i] >> 24) & 0xff) != 0xff)
+            return i;
+    }
+    return -1;
+}
+
+// Every fixture in every layout, through the scalar, SIMD and pool plane kernels
+static void checkFixtureLayouts(void)
+{
+    int const width = FIXTURE_WIDTH, height = FIXTURE_HEIGHT, npix = width*height;
+    unsigned char *buf = malloc(yuvBufferSize(YUV_FORMAT_NV21, width, height, width + 24) + 3*width*height);
+    int *pixels = allocPixels(width, height);
+    yuvImage img;
+    int f, l, pass, i;
+    char msg[160];
+
+    if (!buf || !pixels) {
+        free(pixels);
+        free(buf);
+        return;
+    }
+    yuvSetColorSpace(YUV_BT601, YUV_LIMITED_RANGE);
+    for (f=0; f < NFIXTURES; f++)
+        for (l=0; l < NLAYOUTS; l++) {
+            if (!fixtureImage(&img, buf, l, width, height)) {
+                fail("fixture", layoutNames[l], width, height, "descriptor rejected");
+                continue;
+            }
+            fillFixture(&img, &fixtures[f]);
+            for (pass=0; pass < 3; pass++) {
+                memset(pixels, 0, npix*sizeof(int));
+                setGuard(pixels, npix);
+                if (pass == 0)
+                    convertYUV420toRGB8888(&img, pixels);
+                else if (pass == 1)
+                    convertYUV420toRGB8888_SIMD(&img, pixels);
+                else
+                    convertYUV420toRGB8888_SIMDParallel(&img, pixels);
+                i = fixtureMismatch(pixels, npix, &fixtures[f]);
+                if (i >= 0 || !guardIntact(pixels, npix)) {
+                    snprintf(msg, sizeof(msg), "%s, %s kernel: (%d,%d) is %08x", fixtures[f].name,
+                             pass == 0 ? "scalar" : pass == 1 ? "simd" : "pool", i % width, i / width, i >= 0 ? pixels[i] : 0);
+                    fail("fixture", layoutNames[l], width, height, i >= 0 ? msg : "wrote after the end of the output");
+                }
+            }
+        }
+    free(pixels);
+    free(buf);
+}
+
+// Plane kernels of the fixtures: the whole frame into a YUV_OUT_* format. run returns 0 if the kernel is not
+// available here (or does not take the layout)
+typedef struct planeKernel {
+    const char *name;
+    int (*run)(const yuvImage *img, void *out, int format);
+} planeKernel;
+
+static int runFormatNEON(const yuvImage *img, void *out, int format)
+{
+    return (yuvCPUFeatures() & YUV_CPU_NEON) && convertYUV420toFormat_NEON_Rows(img, out, format, 0, img->height/2);
+}
+
+static int runFormatNEON64(const yuvImage *img, void *out, int format)
+{
+    return (yuvCPUFeatures() & YUV_CPU_NEON) && convertYUV420toFormat_NEON64_Rows(img, out, format, 0, img->height/2);
+}
+
+static int runFormatSSE41(const yuvImage *img, void *out, int format)
+{
+    return (yuvCPUFeatures() & YUV_CPU_SSE41) && convertYUV420toFormat_SSE41_Rows(img, out, format, 0, img->height/2);
+}
+
+static int runFormatAVX2(const yuvImage *img, void *out, int format)
+{
+    return (yuvCPUFeatures() & YUV_CPU_AVX2) && convertYUV420toFormat_AVX2_Rows(img, out, format, 0, img->height/2);
+}
+
+static const planeKernel planeKernels[] = {
+    { "scalar", convertYUV420toFormat },
+    { "simd", convertYUV420toFormat_SIMD },
+    { "pool", convertYUV420toFormat_SIMDParallel },
+    { "neon", runFormatNEON },
+    { "neon64", runFormatNEON64 },
+    { "sse4.1", runFormatSSE41 },
+    { "avx2", runFormatAVX2 },
+};
+#define NPLANEKERNELS (int)(sizeof(planeKernels)/sizeof(planeKernels[0]))
+
+// Every fixture in every layout into every output format, through every plane kernel
+static void checkFixtureOutputs(void)
+{
+    static const char *formatNames[] = { "rgba", "bgra", "rgb565", "rgb888" };
+    int const width = FIXTURE_WIDTH, height = FIXTURE_HEIGHT, npix = width*height;
+    unsigned char *buf = malloc(yuvBufferSize(YUV_FORMAT_NV21, width, height, width + 24) + 3*width*height);
+    unsigned char *out = malloc((size_t)npix*4 + GUARD);
+    int *pixels = allocPixels(width, height);
+    yuvImage img;
+    int f, l, format, k, bytes, i;
+    char msg[160];
+
+    if (!buf || !out || !pixels) {
+        free(pixels);
+        free(out);
+        free(buf);
+        return;
+    }
+    yuvSetColorSpace(YUV_BT601, YUV_LIMITED_RANGE);
+    for (f=0; f < NFIXTURES; f++)
+        for (l=0; l < NLAYOUTS; l++) {
+            if (!fixtureImage(&img, buf, l, width, height))
+                continue;       // reported by checkFixtureLayouts
+            fillFixture(&img, &fixtures[f]);
+            for (format=YUV_OUT_RGBA8888; format <= YUV_OUT_RGB888; format++)
+                for (k=0; k < NPLANEKERNELS; k++) {
+                    bytes = YUV_OUT_BYTES(format);
+                    memset(out, 0, (size_t)npix*bytes);
+                    memset(out + (size_t)npix*bytes, 0x5a, GUARD);
+                    if (!planeKernels[k].run(&img, out, format))
+                        continue;
+                    for (i=0; i < npix; i++)
+                        pixels[i] = outputPixel(out, format, i);
+                    i = fixtureMismatch(pixels, npix, &fixtures[f]);
+                    if (i >= 0) {
+                        snprintf(msg, sizeof(msg), "%s in %s, %s kernel: (%d,%d) is %08x", fixtures[f].name, layoutNames[l],
+                                 planeKernels[k].name, i % width, i / width, pixels[i]);
+                        fail("fixture-output", formatNames[format], width, height, msg);
+                    }
+                    for (i=0; i < GUARD && out[(size_t)npix*bytes + i] == 0x5a; i++)
+                        ;
+                    if (i < GUARD) {
+                        snprintf(msg, sizeof(msg), "%s in %s: wrote after the end of the output", fixtures[f].name, layoutNames[l]);
+                        fail("fixture-output", formatNames[format], width, height, msg);
+                    }
+                }
+        }
+    free(pixels);
+    free(out);
+    free(buf);
+}
+
+// The fixtures as NV21 frames through every kernel of the table
+static void checkFixtureKernels(void)
+{
+    int const width = FIXTURE_WIDTH, height = FIXTURE_HEIGHT, npix = width*height;
+    unsigned char *data = malloc((size_t)npix*3/2);
+    int *pixels = allocPixels(width, height);
+    yuvImage img;
+    int f, k, i;
+    char msg[160];
+
+    if (!data || !pixels || !yuvImageFromBuffer(&img, data, YUV_FORMAT_NV21, width, height, width)) {
+        free(pixels);
+        free(data);
+        return;
+    }
+    yuvSetColorSpace(YUV_BT601, YUV_LIMITED_RANGE);
+    for (f=0; f < NFIXTURES; f++) {
+        fillFixture(&img, &fixtures[f]);
+        for (k=0; k < NKERNELS; k++) {
+            memset(pixels, 0, npix*sizeof(int));
+            setGuard(pixels, npix);
+            if (!kernels[k].run(data, pixels, width, height))
+                continue;
+            i = fixtureMismatch(pixels, npix, &fixtures[f]);
+            if (i >= 0) {
+                snprintf(msg, sizeof(msg), "%s: (%d,%d) is %08x", fixtures[f].name, i % width, i / width, pixels[i]);
+                fail("fixture-rgb", kernels[k].name, width, height, msg);
+            }
+            else if (!guardIntact(pixels, npix))
+                fail("fixture-rgb", kernels[k].name, width, height, "wrote after the end of the output");
+        }
+    }
+    free(pixels);
+    free(data);
+}
+
+static void testCorrectness(void)
+{
+    int matrix, range, s, p;
+    char ctx[64];
+
+    for (matrix=YUV_BT601; matrix <= YUV_BT709; matrix++)
+        for (range=YUV_LIMITED_RANGE; range <= YUV_FULL_RANGE; range++) {
+            yuvSetColorSpace(matrix, range);
+            testPixelMath(matrix, range);
+            for (s=0; s < NSIZES; s++) {
+                int const width = sizes[s][0], height = sizes[s][1];
+                unsigned char *data = malloc((size_t)width*height*3/2);     // exact size: an overread goes past the block
+                int *ref = allocPixels(width, height);
+                int *pixels = allocPixels(width, height);
+
+                if (!data || !ref || !pixels) {
+                    fprintf(stderr, "out of memory for %dx%d\n", width, height);
+                    exit(1);
+                }
+                for (p=0; p < NPATTERNS; p++) {
+                    snprintf(ctx, sizeof(ctx), "%s %s", spaceNames[matrix][range], patternNames[p]);
+                    fillFrame(data, width, height, p);
+                    setGuard(ref, width*height);
+                    convertYUV420_NV21toRGB8888(data, ref, width, height);
+                    checkGolden(data, ref, width, height, matrix, range, ctx);
+                    checkKernels(data, ref, pixels, width, height, ctx);
+                    checkLayouts(data, ref, pixels, width, height, ctx);
+                    checkOutputs(data, ref, width, height, ctx);
+                    checkGrey(data, pixels, width, height, matrix, range, ctx);
+                    checkStats(data, ref, pixels, width, height, ctx);
+                    checkROI(data, ref, pixels, width, height, ctx);
+                    checkIncremental(data, pixels, width, height, ctx);
+                    checkScaled(data, ref, pixels, width, height, ctx);
+                    checkScaledFormats(data, width, height, ctx);
+                }
+                if (matrix == YUV_BT601 && range == YUV_LIMITED_RANGE)
+                    checkBatch(width, height);
+                free(pixels);
+                free(ref);
+                free(data);
+            }
+            if (verbose)
+                printf("%s done, %d failures so far\n", spaceNames[matrix][range], failures);
+        }
+    checkFixtureKernels();
+    checkFixtureLayouts();
+    checkFixtureOutputs();
+    yuvSetColorSpace(YUV_BT601, YUV_LIMITED_RANGE);
+    checkOddSizes();
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// Performance
+
+static const int perfSizes[][2] = { {640, 480}, {1280, 720}, {1920, 1080} };
+#define NPERFSIZES (int)(sizeof(perfSizes)/sizeof(perfSizes[0]))
+
+#define MAX_THRESHOLDS 256
+
+typedef struct threshold {
+    char kernel[32];
+    int width;
+    int height;
+    double mpix;                // minimum Mpixels/s
+} threshold;
+
+static double nowMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000.0 + ts.tv_nsec/1000000.0;
+}
+
+static int cmpDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Median Mpixels/s of a kernel over iterations frames (after a warm-up one), 0 if it does not run here
+static double measure(const kernel *k, const unsigned char *data, int *pixels, int width, int height, int iterations)
+{
+    double times[64];
+    int it;
+
+    if (iterations > 64)
+        iterations = 64;
+    if (!k->run(data, pixels, width, height))
+        return 0;
+    for (it=0; it < iterations; it++) {
+        double const t0 = nowMs();
+
+        k->run(data, pixels, width, height);
+        times[it] = nowMs() - t0;
+    }
+    qsort(times, iterations, sizeof(double), cmpDouble);
+    return (double)width*height/(times[iterations/2]*1000.0);
+}
+
+static int readThresholds(const char *path, threshold *th)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int n = 0;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    while (n < MAX_THRESHOLDS && fgets(line, sizeof(line), f))
+        if (line[0] != '#' && sscanf(line, "%31s %dx%d %lf", th[n].kernel, &th[n].width, &th[n].height, &th[n].mpix) == 4)
+            n++;
+    fclose(f);
+    return n;
+}
+
+// Check the thresholds of path, or record them (record: margin times the throughput of this host)
+static void testPerformance(const char *path, int record, double margin, int iterations)
+{
+    static threshold th[MAX_THRESHOLDS];
+    FILE *out = NULL;
+    int nth = 0, s, k, i;
+
+    if (record) {
+        out = fopen(path, "w");
+        if (!out) {
+            perror(path);
+            exit(1);
+        }
+        fprintf(out, "# Minimum throughput of each kernel (Mpixels/s, median frame), checked by yuvtest -P (ctest).\n"
+                     "# Recorded with yuvtest -R -m %.2f on a host with %ld CPUs, SIMD %s, %d threads\n",
+                margin, sysconf(_SC_NPROCESSORS_ONLN), yuvSIMDName(), nthr);
+    }
+    else
+        nth = readThresholds(path, th);
+    for (s=0; s < NPERFSIZES; s++) {
+        int const width = perfSizes[s][0], height = perfSizes[s][1];
+        unsigned char *data = malloc((size_t)width*height*3/2);
+        int *pixels = malloc((size_t)width*height*sizeof(int));
+
+        if (!data || !pixels) {
+            fprintf(stderr, "out of memory for %dx%d\n", width, height);
+            exit(1);
+        }
+        fillFrame(data, width, height, 0);
+        for (k=0; k < NKERNELS; k++) {
+            double mpix, min = 0;
+
+            if (!kernels[k].perf)
+                continue;
+            for (i=0; i < nth; i++)
+                if (strcmp(th[i].kernel, kernels[k].name) == 0 && th[i].width == width && th[i].height == height)
+                    min = th[i].mpix;
+            if (!record && min <= 0)
+                continue;
+            mpix = measure(&kernels[k], data, pixels, width, height, iterations);
+            if (mpix == 0) {
+                if (verbose)
+                    printf("%-13s %4dx%-4d n/a\n", kernels[k].name, width, height);
+                continue;
+            }
+            if (record) {
+                fprintf(out, "%-13s %dx%d %.1f\n", kernels[k].name, width, height, mpix*margin);
+                printf("%-13s %4dx%-4d %8.1f Mpix/s, threshold %.1f\n", kernels[k].name, width, height, mpix, mpix*margin);
+                continue;
+            }
+            if (mpix < min)         // once more before failing: a noisy run is not a regression
+                mpix = measure(&kernels[k], data, pixels, width, height, iterations);
+            if (mpix < min) {
+                char msg[96];
+
+                snprintf(msg, sizeof(msg), "%.1f Mpix/s, threshold %.1f", mpix, min);
+                fail("performance", kernels[k].name, width, height, msg);
+            }
+            else if (verbose)
+                printf("%-13s %4dx%-4d %8.1f Mpix/s, threshold %.1f\n", kernels[k].name, width, height, mpix, min);
+        }
+        free(pixels);
+        free(data);
+    }
+    if (out)
+        fclose(out);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-t threads] [-v] [-P thresholds | -R thresholds [-m margin]] [-n iterations]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *perfPath = NULL;
+    int record = 0, iterations = 15;
+    double margin = 0.5;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:vP:R:m:n:")) != -1) {
+        switch (opt) {
+            case 't': nthr = atoi(optarg); break;
+            case 'v': verbose = 1; break;
+            case 'P': perfPath = optarg; record = 0; break;
+            case 'R': perfPath = optarg; record = 1; break;
+            case 'm': margin = atof(optarg); break;
+            case 'n': iterations = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (nthr < 1 || iterations < 1 || margin <= 0)
+        usage(argv[0]);
+    if (nthr > MAX_NUM_THREADS)
+        nthr = MAX_NUM_THREADS;
+    workerPoolInit(nthr);
+    omp_set_num_threads(nthr);
+    printf("threads: %d, SIMD: %s\n", nthr, yuvSIMDName());
+    if (perfPath)
+        testPerformance(perfPath, record, margin, iterations);
+    else
+        testCorrectness();
+    workerPoolShutdown();
+    printf("%s: %d failures\n", failures ? "FAILED" : "passed", failures);
+    return failures ? 1 : 0;
+}